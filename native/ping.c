@@ -1,8 +1,23 @@
+// needed for "struct ucred" (peer credentials) on Linux
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif // ifdef __linux__
+
 // standard lib imports
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
 #include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif // ifdef __linux__
 
 // node/libuv imports
 #include <node_api.h>
@@ -199,6 +214,8 @@ struct _open_data {
   int __errno;
   /** The file descriptor of the open socket or `-1` on error */
   int __fd;
+  /** The ICMP identifier the socket is bound to, or `-1` if unknown */
+  int __identifier;
 };
 
 /* ========================================================================== */
@@ -213,10 +230,10 @@ static void _open_execute_fail(
   int __socket = _data->__fd;
 
   _data->__syscall = _syscall;
-  _data->__errno = errno;
+  _data->__errno = _errno;
   _data->__fd = -1;
 
-  if (__socket > 1) return;
+  if (__socket < 0) return;
 
   close(__socket);
 }
@@ -248,6 +265,19 @@ static void _open_execute(
   __data->__fd = socket(__data->__sockaddr.sa_family, SOCK_DGRAM, __protocol);
   if (__data->__fd < 0) return _open_execute_fail(_env, __data, "socket", errno);
 
+  #ifdef __linux__
+    // On Linux, the first `SIOCGSTAMPNS` enables timestamping on the socket
+    // (and fails with ENOENT as no packet was received yet). We do it here,
+    // so that the timestamp of the first packet received is available to
+    // `stamp` later. Note that we can't use SO_TIMESTAMPNS as timestamps
+    // would then go to control messages, and `SIOCGSTAMPNS` wouldn't work.
+    struct timespec __timestamp;
+    int __timestamp_result = ioctl(__data->__fd, SIOCGSTAMPNS, &__timestamp);
+    if ((__timestamp_result < 0) && (errno != ENOENT)) {
+      return _open_execute_fail(_env, __data, "ioctl", errno);
+    }
+  #endif // ifdef __linux__
+
   // Optionally bind to an interface
   if (__data->__interface_length > 0) {
     #ifdef __linux__
@@ -285,11 +315,35 @@ static void _open_execute(
     #endif // ifdef __APPLE__
   }
 
+  #ifdef __linux__
+    // On Linux, the "port" of ICMP sockets is the identifier of ECHO Requests
+    // (overwritten by the kernel) and replies are demultiplexed by it, so we
+    // always bind (to the wildcard address if no from address was specified)
+    // to our explicit identifier, or to `0` for the kernel to assign one
+    if (__data->__sockaddr_size == 0) {
+      __data->__sockaddr_size = __data->__sockaddr.sa_family == AF_INET ?
+        sizeof(struct sockaddr_in) :
+        sizeof(struct sockaddr_in6);
+    }
+  #endif // ifdef __linux__
+
   // Optionally specify the from address
   if (__data->__sockaddr_size > 0) {
     int __result = bind(__data->__fd, &__data->__sockaddr, __data->__sockaddr_size);
-    if (__result != 0) _open_execute_fail(_env, __data, "bind", errno);
+    if (__result != 0) return _open_execute_fail(_env, __data, "bind", errno);
   }
+
+  #ifdef __linux__
+    // Read back the identifier we were bound to (possibly assigned by the kernel)
+    struct sockaddr_storage __bound;
+    socklen_t __bound_size = sizeof(__bound);
+    int __result = getsockname(__data->__fd, (struct sockaddr *) &__bound, &__bound_size);
+    if (__result != 0) return _open_execute_fail(_env, __data, "getsockname", errno);
+
+    __data->__identifier = __bound.ss_family == AF_INET ?
+      ntohs(((struct sockaddr_in *) &__bound)->sin_port) :
+      ntohs(((struct sockaddr_in6 *) &__bound)->sin6_port);
+  #endif // ifdef __linux__
 }
 
 /* ========================================================================== */
@@ -306,13 +360,14 @@ static void _open_complete(
   free(data);
 
   // Get JS's `null` and `undefined`, then prep the arguments for the callback
-  napi_value __args[2];
+  napi_value __args[3];
   NAPI_CALL_VOID(napi_get_null, _env, &__args[0]);
   NAPI_CALL_VOID(napi_get_undefined, _env, &__args[1]);
+  NAPI_CALL_VOID(napi_get_undefined, _env, &__args[2]);
 
   // If we have a negative file descriptor, we have an error and pass it to our
   // callback as the _first_ argument, otherwise we pass the file descriptor as
-  // the second argument to the callback.
+  // the second argument to the callback (and the identifier, if known, third).
   if (_status != napi_ok) {
     char __message_chars[128];
     snprintf(__message_chars, sizeof(__message_chars), "NAPI error opening (status=%d)", _status);
@@ -325,6 +380,9 @@ static void _open_complete(
     __args[0] = _system_error(_env, __data.__syscall, __data.__errno);
   } else {
     NAPI_CALL_VOID(napi_create_uint32, _env, __data.__fd, &__args[1]);
+    if (__data.__identifier >= 0) {
+      NAPI_CALL_VOID(napi_create_uint32, _env, __data.__identifier, &__args[2]);
+    }
   }
 
   // Get our callback function
@@ -334,7 +392,7 @@ static void _open_complete(
   // Call our callback with our arguments, scoped in `global`
   napi_value __global = NULL;
   NAPI_CALL_VOID(napi_get_global, _env, &__global);
-  NAPI_CALL_VOID(napi_call_function, _env, __global, __callback, 2, __args, NULL);
+  NAPI_CALL_VOID(napi_call_function, _env, __global, __callback, 3, __args, NULL);
 
   // Cleanup: delete reference to our callback and our async work
   NAPI_CALL_VOID(napi_delete_reference, _env, __data.__callback_ref);
@@ -353,21 +411,24 @@ static napi_value _open(
   // Allocate _open_data here, it'll be malloc'ed later
   struct _open_data __data;
   bzero(&__data, sizeof(struct _open_data));
+  __data.__identifier = -1;
 
-  // Get our `open` call arguments
-  size_t __argc = 4;
-  napi_value __args[4];
+  // Get our `open` call arguments, the identifier can be omitted (as in the
+  // original 4 arguments form, which older callers still use)
+  size_t __argc = 5;
+  napi_value __args[5];
   NAPI_CALL_VALUE(napi_get_cb_info, _env, _info, &__argc, __args, NULL, NULL);
 
-  if (__argc != 4) {
-    _throw_type_error(_env, "Expected 4 arguments: socket family, from address, source interface, callback");
+  if ((__argc != 4) && (__argc != 5)) {
+    _throw_type_error(_env, "Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback");
     return NULL;
   }
 
   napi_value __socket_family = __args[0];
   napi_value __from_address = __args[1];
   napi_value __source_interface = __args[2];
-  napi_value __callback = __args[3];
+  napi_value __identifier = __argc == 5 ? __args[3] : NULL;
+  napi_value __callback = __args[__argc - 1];
 
   // Get the socket's family (should be AF_INET or AF_INET6)
   NAPI_CALL_VALUE(napi_typeof, _env, __socket_family, &__type);
@@ -461,6 +522,22 @@ static napi_value _open(
     __data.__interface_length = __size;
   }
 
+  // Get the identifier to bind to (if any, `0` lets the kernel assign one)
+  __type = napi_undefined;
+  if (__identifier != NULL) NAPI_CALL_VALUE(napi_typeof, _env, __identifier, &__type);
+  if ((__type != napi_null) && (__type != napi_undefined)) {
+    int32_t __value = -1;
+    if (__type == napi_number) NAPI_CALL_VALUE(napi_get_value_int32, _env, __identifier, &__value);
+
+    if ((__value < 0) || (__value > 0xffff)) {
+      _throw_type_error(_env, "Identifier must be a number between 0 and 65535, null or undefined");
+      return NULL;
+    }
+
+    // Both "sin_port" and "sin6_port" live at the same offset in our union
+    __data.__sockaddr_in4_addr.sin_port = htons((uint16_t) __value);
+  }
+
   // Get the type of our last argument, which must be a function
   NAPI_CALL_VALUE(napi_typeof, _env, __callback, &__type);
 
@@ -501,6 +578,881 @@ static napi_value _open(
   return NULL;
 }
 
+/* ========================================================================== *
+ * STAMP: synchronously get the delay since the last packet was received      *
+ * ========================================================================== */
+
+/**
+ * Return the delay (in nanoseconds, as a `bigint`) between the time the kernel
+ * received the last packet on a socket and _now_, or `undefined` if unknown.
+ */
+static napi_value _stamp(
+  napi_env _env,
+  napi_callback_info _info
+) {
+  napi_valuetype __type = napi_undefined;
+
+  // Get our `stamp` call arguments
+  size_t __argc = 1;
+  napi_value __args[1];
+  NAPI_CALL_VALUE(napi_get_cb_info, _env, _info, &__argc, __args, NULL, NULL);
+
+  if (__argc != 1) {
+    _throw_type_error(_env, "Expected 1 argument: file descriptor");
+    return NULL;
+  }
+
+  NAPI_CALL_VALUE(napi_typeof, _env, __args[0], &__type);
+  if (__type != napi_number) {
+    _throw_type_error(_env, "Specified file descriptor is not a number");
+    return NULL;
+  }
+
+  int __fd = -1;
+  NAPI_CALL_VALUE(napi_get_value_int32, _env, __args[0], &__fd);
+
+  #ifdef __linux__
+    // Get the kernel timestamp (CLOCK_REALTIME) of the last packet received
+    struct timespec __received;
+    if (ioctl(__fd, SIOCGSTAMPNS, &__received) < 0) {
+      // ENOENT: no packet was received (yet) with timestamping enabled
+      if (errno == ENOENT) return NULL;
+      _throw_system_error(_env, "ioctl", errno);
+      return NULL;
+    }
+
+    // Compare with _now_ from the same clock
+    struct timespec __now;
+    if (clock_gettime(CLOCK_REALTIME, &__now) < 0) {
+      _throw_system_error(_env, "clock_gettime", errno);
+      return NULL;
+    }
+
+    int64_t __delay =
+      ((int64_t) (__now.tv_sec - __received.tv_sec)) * 1000000000LL +
+      ((int64_t) (__now.tv_nsec - __received.tv_nsec));
+
+    napi_value __result = NULL;
+    NAPI_CALL_VALUE(napi_create_bigint_int64, _env, __delay, &__result);
+    return __result;
+  #else
+    // Other platforms don't expose the timestamp of the last packet received
+    return NULL;
+  #endif // ifdef __linux__
+}
+
+/* ========================================================================== *
+ * CHECKSUM: compute the Internet checksum of ICMP and ICMPv6 packets         *
+ * ========================================================================== *
+ *                                                                            *
+ * The one's complement sum (RFC 1071) doesn't depend on byte order, so we    *
+ * add 32 bits words (in host order) in a 64 bits accumulator, which can't    *
+ * overflow for any packet shorter than 16 GB, and which the compiler can     *
+ * vectorize, folding it down to 16 bits only at the very end.                *
+ *                                                                            *
+ * ICMPv6 checksums also cover a "pseudo header" made of the source and the   *
+ * destination addresses, the length of the packet and its next header (58)   *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Add all bytes in the specified data to our (host order) accumulator */
+static uint64_t _checksum_add(
+  uint64_t _sum,
+  const uint8_t *_data,
+  size_t _length
+) {
+  size_t __words = _length / 4;
+  for (size_t __i = 0; __i < __words; __i ++) {
+    uint32_t __word;
+    memcpy(&__word, _data + __i * 4, 4);
+    _sum += __word;
+  }
+
+  // Trailing bytes, padded with zeroes
+  size_t __trailing = _length & 3;
+  if (__trailing > 0) {
+    uint32_t __word = 0;
+    memcpy(&__word, _data + __words * 4, __trailing);
+    _sum += __word;
+  }
+
+  return _sum;
+}
+
+/** Fold our accumulator into a 16 bits checksum (in network byte order) */
+static uint16_t _checksum_fold(uint64_t _sum) {
+  while (_sum >> 16) _sum = (_sum & 0xffff) + (_sum >> 16);
+  return ntohs((uint16_t) ~_sum);
+}
+
+/**
+ * Return the Internet checksum of a buffer, optionally prepended by the IPv6
+ * pseudo header for the specified source and destination addresses.
+ */
+static napi_value _checksum(
+  napi_env _env,
+  napi_callback_info _info
+) {
+  // Get our `checksum` call arguments
+  size_t __argc = 3;
+  napi_value __args[3];
+  NAPI_CALL_VALUE(napi_get_cb_info, _env, _info, &__argc, __args, NULL, NULL);
+
+  if ((__argc != 1) && (__argc != 3)) {
+    _throw_type_error(_env, "Expected 1 or 3 arguments: data, source address, destination address");
+    return NULL;
+  }
+
+  // Get all our buffers (data, and optional source and destination addresses)
+  void *__buffers[3] = { NULL, NULL, NULL };
+  size_t __lengths[3] = { 0, 0, 0 };
+  for (size_t __i = 0; __i < __argc; __i ++) {
+    bool __is_buffer = false;
+    NAPI_CALL_VALUE(napi_is_buffer, _env, __args[__i], &__is_buffer);
+    if (! __is_buffer) {
+      _throw_type_error(_env, __i == 0 ? "Specified data is not a buffer" : "Specified address is not a buffer");
+      return NULL;
+    }
+
+    NAPI_CALL_VALUE(napi_get_buffer_info, _env, __args[__i], &__buffers[__i], &__lengths[__i]);
+    if ((__i > 0) && (__lengths[__i] != 16)) {
+      _throw_type_error(_env, "Specified address is not 16 bytes long");
+      return NULL;
+    }
+  }
+
+  uint64_t __sum = 0;
+
+  // The IPv6 pseudo header: addresses, upper layer length and next header
+  if (__argc == 3) {
+    uint32_t __trailer[2] = { htonl((uint32_t) __lengths[0]), htonl(IPPROTO_ICMPV6) };
+    __sum = _checksum_add(__sum, __buffers[1], 16);
+    __sum = _checksum_add(__sum, __buffers[2], 16);
+    __sum = _checksum_add(__sum, (uint8_t *) __trailer, sizeof(__trailer));
+  }
+
+  __sum = _checksum_add(__sum, __buffers[0], __lengths[0]);
+
+  napi_value __result = NULL;
+  NAPI_CALL_VALUE(napi_create_uint32, _env, _checksum_fold(__sum), &__result);
+  return __result;
+}
+
+/* ========================================================================== *
+ * HANDOFF: pass sockets and state to another process over a UNIX socket      *
+ * ========================================================================== *
+ *                                                                            *
+ * The sender connects to a UNIX socket the receiver is listening on, then:   *
+ *                                                                            *
+ * - writes a header with the number of file descriptors and the length of    *
+ *   the state data (two 32 bits integers, network byte order)                *
+ * - sends the file descriptors with SCM_RIGHTS, in chunks of at most         *
+ *   __HANDOFF_MAX_FDS, each chunk carrying its own count as data             *
+ * - writes the state data                                                    *
+ * - waits for the receiver to acknowledge with a single byte                 *
+ *                                                                            *
+ * The receiver's socket file is only accessible by its own user (mode 0600), *
+ * and both sides check that their peer runs as the same (effective) user:    *
+ * the receiver turns away anybody else, the sender refuses to send.          *
+ *                                                                            *
+ * ========================================================================== */
+
+/** The maximum number of file descriptors in a message (Linux' SCM_MAX_FD) */
+#define __HANDOFF_MAX_FDS 253
+/** Sanity limits for what we're willing to receive */
+#define __HANDOFF_LIMIT_FDS (1 << 20)
+#define __HANDOFF_LIMIT_DATA (1 << 30)
+
+/** Data to pass around in `handoff_send` and `handoff_receive` async work */
+struct _handoff_data {
+  /** The `napi_async_work` structure associated with this operation */
+  napi_async_work __async_work;
+  /** A reference to the JavaScript callback function to invoke when done */
+  napi_ref __callback_ref;
+  /** Whether we are receiving (or sending) file descriptors */
+  bool __receiving;
+  /** The connected (sender) or listening (receiver) socket */
+  int __socket;
+  /** The timeout in milliseconds for accepting, sending and receiving */
+  int __timeout;
+  /** The path of the UNIX socket, unlinked by the receiver when accepting */
+  char __path[sizeof(((struct sockaddr_un *) NULL)->sun_path)];
+  /** The file descriptors to send (duplicated) or received */
+  int * __fds;
+  /** The number of file descriptors in `__fds` */
+  size_t __fds_count;
+  /** The state data to send or received */
+  uint8_t * __buffer;
+  /** The length of the state data in `__buffer` */
+  size_t __buffer_length;
+  /** Either NULL or the name of the sytem call that failed */
+  const char * __syscall;
+  /** Either `0` or the `errno` from the sytem call that failed */
+  int __errno;
+};
+
+/* ========================================================================== */
+
+/** Write the whole buffer, returning `0` on success or `-1` and `errno` */
+static int _write_fully(
+  int _fd,
+  const void * _buffer,
+  size_t _length
+) {
+  const uint8_t * __buffer = (const uint8_t *) _buffer;
+  while (_length > 0) {
+    ssize_t __result = write(_fd, __buffer, _length);
+    if ((__result < 0) && (errno == EINTR)) continue;
+    if (__result < 0) return -1;
+    __buffer += __result;
+    _length -= __result;
+  }
+  return 0;
+}
+
+/** Read the whole buffer, returning `0` on success or `-1` and `errno` */
+static int _read_fully(
+  int _fd,
+  void * _buffer,
+  size_t _length
+) {
+  uint8_t * __buffer = (uint8_t *) _buffer;
+  while (_length > 0) {
+    ssize_t __result = read(_fd, __buffer, _length);
+    if ((__result < 0) && (errno == EINTR)) continue;
+    if (__result < 0) return -1;
+    if (__result == 0) {
+      errno = ECONNRESET; // the other side went away
+      return -1;
+    }
+    __buffer += __result;
+    _length -= __result;
+  }
+  return 0;
+}
+
+/** Set both send and receive timeouts (in milliseconds) on a socket */
+static int _set_timeouts(
+  int _fd,
+  int _timeout
+) {
+  struct timeval __timeval;
+  __timeval.tv_sec = _timeout / 1000;
+  __timeval.tv_usec = (_timeout % 1000) * 1000;
+
+  if (setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &__timeval, sizeof(__timeval)) < 0) return -1;
+  return setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &__timeval, sizeof(__timeval));
+}
+
+/** Send a chunk of file descriptors, with their count as data */
+static int _send_fds(
+  int _socket,
+  const int * _fds,
+  size_t _count
+) {
+  uint32_t __count = htonl((uint32_t) _count);
+  struct iovec __iov;
+  __iov.iov_base = &__count;
+  __iov.iov_len = sizeof(__count);
+
+  char __control[CMSG_SPACE(sizeof(int) * __HANDOFF_MAX_FDS)];
+  bzero(__control, sizeof(__control));
+
+  struct msghdr __message;
+  bzero(&__message, sizeof(__message));
+  __message.msg_iov = &__iov;
+  __message.msg_iovlen = 1;
+  __message.msg_control = __control;
+  __message.msg_controllen = CMSG_SPACE(sizeof(int) * _count);
+
+  struct cmsghdr * __cmsg = CMSG_FIRSTHDR(&__message);
+  __cmsg->cmsg_level = SOL_SOCKET;
+  __cmsg->cmsg_type = SCM_RIGHTS;
+  __cmsg->cmsg_len = CMSG_LEN(sizeof(int) * _count);
+  memcpy(CMSG_DATA(__cmsg), _fds, sizeof(int) * _count);
+
+  ssize_t __result;
+  do {
+    __result = sendmsg(_socket, &__message, 0);
+  } while ((__result < 0) && (errno == EINTR));
+  if (__result < 0) return -1;
+
+  // File descriptors go with the first byte, write whatever is left
+  return _write_fully(_socket, ((uint8_t *) &__count) + __result, sizeof(__count) - __result);
+}
+
+/** Receive a chunk of file descriptors, appending them to `_data->__fds` */
+static int _receive_fds(
+  int _socket,
+  struct _handoff_data * _data,
+  size_t _expected
+) {
+  uint32_t __count = 0;
+  struct iovec __iov;
+  __iov.iov_base = &__count;
+  __iov.iov_len = sizeof(__count);
+
+  char __control[CMSG_SPACE(sizeof(int) * __HANDOFF_MAX_FDS)];
+  bzero(__control, sizeof(__control));
+
+  struct msghdr __message;
+  bzero(&__message, sizeof(__message));
+  __message.msg_iov = &__iov;
+  __message.msg_iovlen = 1;
+  __message.msg_control = __control;
+  __message.msg_controllen = sizeof(__control);
+
+  int __flags = 0;
+  #ifdef MSG_CMSG_CLOEXEC
+    __flags |= MSG_CMSG_CLOEXEC;
+  #endif // ifdef MSG_CMSG_CLOEXEC
+
+  ssize_t __result;
+  do {
+    __result = recvmsg(_socket, &__message, __flags);
+  } while ((__result < 0) && (errno == EINTR));
+  if (__result < 0) return -1;
+  if (__result == 0) {
+    errno = ECONNRESET;
+    return -1;
+  }
+
+  // Collect all file descriptors, closing any we didn't expect
+  size_t __received = 0;
+  for (struct cmsghdr * __cmsg = CMSG_FIRSTHDR(&__message); __cmsg != NULL; __cmsg = CMSG_NXTHDR(&__message, __cmsg)) {
+    if ((__cmsg->cmsg_level != SOL_SOCKET) || (__cmsg->cmsg_type != SCM_RIGHTS)) continue;
+
+    size_t __count_fds = (__cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int * __fds = (int *) CMSG_DATA(__cmsg);
+    for (size_t __i = 0; __i < __count_fds; __i ++) {
+      if (__received < _expected) {
+        _data->__fds[_data->__fds_count ++] = __fds[__i];
+        __received ++;
+      } else {
+        close(__fds[__i]);
+      }
+    }
+  }
+
+  // File descriptors come with the first byte, read whatever is left
+  if (_read_fully(_socket, ((uint8_t *) &__count) + __result, sizeof(__count) - __result) < 0) return -1;
+
+  // Truncated control messages or mismatched counts are protocol errors
+  if ((__message.msg_flags & MSG_CTRUNC) || (ntohl(__count) != __received) || (__received < 1)) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  return 0;
+}
+
+/** Check that the peer of a connected UNIX socket runs as our own user */
+static int _check_peer(
+  int _socket
+) {
+  uid_t __uid;
+
+  #ifdef __linux__
+    struct ucred __credentials;
+    socklen_t __length = sizeof(__credentials);
+    if (getsockopt(_socket, SOL_SOCKET, SO_PEERCRED, &__credentials, &__length) < 0) return -1;
+    __uid = __credentials.uid;
+  #else // ifdef __linux__
+    gid_t __gid;
+    if (getpeereid(_socket, &__uid, &__gid) < 0) return -1;
+  #endif // ifdef __linux__
+
+  if (__uid != geteuid()) {
+    errno = EPERM;
+    return -1;
+  }
+  return 0;
+}
+
+/** The milliseconds elapsed since `_start` on the monotonic clock */
+static int64_t _elapsed(
+  const struct timespec * _start
+) {
+  struct timespec __now;
+  clock_gettime(CLOCK_MONOTONIC, &__now);
+  return ((int64_t) (__now.tv_sec - _start->tv_sec)) * 1000 + (__now.tv_nsec - _start->tv_nsec) / 1000000;
+}
+
+/** Remember the system call that failed and its `errno` */
+static void _handoff_execute_fail(
+  struct _handoff_data * _data,
+  const char * _syscall,
+  int _errno
+) {
+  _data->__syscall = _syscall;
+  _data->__errno = _errno;
+}
+
+/** Asynchronously send our file descriptors and data */
+static void _handoff_send_execute(
+  napi_env _env,
+  void * _data
+) {
+  struct _handoff_data * __data = (struct _handoff_data *) _data;
+  int __socket = __data->__socket;
+
+  uint32_t __header[2] = { htonl((uint32_t) __data->__fds_count), htonl((uint32_t) __data->__buffer_length) };
+  if (_write_fully(__socket, __header, sizeof(__header)) < 0) return _handoff_execute_fail(__data, "write", errno);
+
+  for (size_t __offset = 0; __offset < __data->__fds_count; __offset += __HANDOFF_MAX_FDS) {
+    size_t __chunk = __data->__fds_count - __offset;
+    if (__chunk > __HANDOFF_MAX_FDS) __chunk = __HANDOFF_MAX_FDS;
+    if (_send_fds(__socket, __data->__fds + __offset, __chunk) < 0) return _handoff_execute_fail(__data, "sendmsg", errno);
+  }
+
+  if (_write_fully(__socket, __data->__buffer, __data->__buffer_length) < 0) return _handoff_execute_fail(__data, "write", errno);
+
+  uint8_t __ack = 0;
+  if (_read_fully(__socket, &__ack, 1) < 0) return _handoff_execute_fail(__data, "read", errno);
+}
+
+/** Asynchronously accept a connection and receive file descriptors and data */
+static void _handoff_receive_execute(
+  napi_env _env,
+  void * _data
+) {
+  struct _handoff_data * __data = (struct _handoff_data *) _data;
+
+  // Wait for a connection (with a timeout) from a process running as our own
+  // user and accept it, turning away anyone else connecting in the meantime
+  struct timespec __start;
+  clock_gettime(CLOCK_MONOTONIC, &__start);
+
+  int __socket = -1;
+  while (__socket < 0) {
+    int64_t __elapsed = _elapsed(&__start);
+    if (__elapsed >= __data->__timeout) return _handoff_execute_fail(__data, "accept", ETIMEDOUT);
+
+    struct pollfd __poll;
+    __poll.fd = __data->__socket;
+    __poll.events = POLLIN;
+    __poll.revents = 0;
+
+    int __result = poll(&__poll, 1, (int) (__data->__timeout - __elapsed));
+    if ((__result < 0) && (errno == EINTR)) continue;
+    if (__result < 0) return _handoff_execute_fail(__data, "poll", errno);
+    if (__result == 0) return _handoff_execute_fail(__data, "accept", ETIMEDOUT);
+
+    __socket = accept(__data->__socket, NULL, NULL);
+    if ((__socket < 0) && ((errno == EINTR) || (errno == ECONNABORTED))) continue;
+    if (__socket < 0) return _handoff_execute_fail(__data, "accept", errno);
+
+    if (_check_peer(__socket) < 0) {
+      close(__socket);
+      __socket = -1;
+    }
+  }
+
+  // We only accept one connection, so close our listening socket now
+  close(__data->__socket);
+  unlink(__data->__path);
+  __data->__socket = __socket;
+
+  if (_set_timeouts(__socket, __data->__timeout) < 0) return _handoff_execute_fail(__data, "setsockopt", errno);
+
+  // Read our header, and check it's sane
+  uint32_t __header[2];
+  if (_read_fully(__socket, __header, sizeof(__header)) < 0) return _handoff_execute_fail(__data, "read", errno);
+
+  size_t __fds_count = ntohl(__header[0]);
+  size_t __buffer_length = ntohl(__header[1]);
+  if ((__fds_count > __HANDOFF_LIMIT_FDS) || (__buffer_length > __HANDOFF_LIMIT_DATA)) {
+    return _handoff_execute_fail(__data, "read", EPROTO);
+  }
+
+  // Allocate space for file descriptors and data, then receive them
+  __data->__fds = malloc(sizeof(int) * (__fds_count + 1));
+  __data->__buffer = malloc(__buffer_length + 1);
+  if ((__data->__fds == NULL) || (__data->__buffer == NULL)) return _handoff_execute_fail(__data, "malloc", ENOMEM);
+
+  while (__data->__fds_count < __fds_count) {
+    size_t __expected = __fds_count - __data->__fds_count;
+    if (__expected > __HANDOFF_MAX_FDS) __expected = __HANDOFF_MAX_FDS;
+    if (_receive_fds(__socket, __data, __expected) < 0) return _handoff_execute_fail(__data, "recvmsg", errno);
+  }
+
+  if (_read_fully(__socket, __data->__buffer, __buffer_length) < 0) return _handoff_execute_fail(__data, "read", errno);
+  __data->__buffer_length = __buffer_length;
+
+  // Acknowledge that we received everything
+  uint8_t __ack = 1;
+  if (_write_fully(__socket, &__ack, 1) < 0) return _handoff_execute_fail(__data, "write", errno);
+}
+
+/* ========================================================================== */
+
+/** Complete a handoff operation, invoke the JavaScript callback and clean up */
+static void _handoff_complete(
+  napi_env _env,
+  napi_status _status,
+  void * data
+) {
+  // Copy the data allocated when starting, and free its pointer
+  struct _handoff_data __data;
+  memcpy(&__data, data, sizeof(struct _handoff_data));
+  free(data);
+
+  // Close our socket (and for the receiver, the path if never accepted)
+  if (__data.__socket >= 0) close(__data.__socket);
+  if (__data.__receiving) unlink(__data.__path);
+
+  // The sender always closes its duplicates, the receiver only on errors
+  bool __failed = (_status != napi_ok) || (__data.__errno != 0);
+  if ((! __data.__receiving) || __failed) {
+    for (size_t __i = 0; __i < __data.__fds_count; __i ++) close(__data.__fds[__i]);
+  }
+
+  // Prepare the arguments for our callback: error, file descriptors and data
+  napi_value __args[3];
+  NAPI_CALL_VOID(napi_get_null, _env, &__args[0]);
+  NAPI_CALL_VOID(napi_get_undefined, _env, &__args[1]);
+  NAPI_CALL_VOID(napi_get_undefined, _env, &__args[2]);
+
+  if (_status != napi_ok) {
+    char __message_chars[128];
+    snprintf(__message_chars, sizeof(__message_chars), "NAPI error in handoff (status=%d)", _status);
+
+    napi_value __message = NULL;
+    NAPI_CALL_VOID(napi_create_string_latin1, _env, __message_chars, NAPI_AUTO_LENGTH, &__message);
+    NAPI_CALL_VOID(napi_create_error, _env, NULL, __message, &__args[0]);
+  } else if (__data.__errno != 0) {
+    __args[0] = _system_error(_env, __data.__syscall, __data.__errno);
+  } else if (__data.__receiving) {
+    NAPI_CALL_VOID(napi_create_array_with_length, _env, __data.__fds_count, &__args[1]);
+    for (size_t __i = 0; __i < __data.__fds_count; __i ++) {
+      napi_value __fd = NULL;
+      NAPI_CALL_VOID(napi_create_uint32, _env, __data.__fds[__i], &__fd);
+      NAPI_CALL_VOID(napi_set_element, _env, __args[1], __i, __fd);
+    }
+    NAPI_CALL_VOID(napi_create_buffer_copy, _env, __data.__buffer_length, __data.__buffer, NULL, &__args[2]);
+  }
+
+  free(__data.__fds);
+  free(__data.__buffer);
+
+  // Get our callback function and call it, scoped in `global`
+  napi_value __callback = NULL;
+  NAPI_CALL_VOID(napi_get_reference_value, _env, __data.__callback_ref, &__callback);
+
+  napi_value __global = NULL;
+  NAPI_CALL_VOID(napi_get_global, _env, &__global);
+  NAPI_CALL_VOID(napi_call_function, _env, __global, __callback, 3, __args, NULL);
+
+  // Cleanup: delete reference to our callback and our async work
+  NAPI_CALL_VOID(napi_delete_reference, _env, __data.__callback_ref);
+  NAPI_CALL_VOID(napi_delete_async_work, _env, __data.__async_work);
+}
+
+/** Queue our handoff async work */
+static napi_value _handoff_queue(
+  napi_env _env,
+  napi_value _callback,
+  struct _handoff_data * _data,
+  napi_async_execute_callback _execute,
+  const char * _name
+) {
+  // Create a resource and resource name for our async work
+  napi_value __resource = NULL;
+  napi_value __resource_name = NULL;
+
+  NAPI_CALL_VALUE(napi_create_object, _env, &__resource);
+  NAPI_CALL_VALUE(napi_create_string_latin1, _env, _name, NAPI_AUTO_LENGTH, &__resource_name);
+
+  // Create a reference to our callback function
+  NAPI_CALL_VALUE(napi_create_reference, _env, _callback, 1, &_data->__callback_ref);
+
+  // Create our async work to be queued, and queue it up
+  NAPI_CALL_VALUE(napi_create_async_work,
+                  _env,
+                  __resource,
+                  __resource_name,
+                  _execute,
+                  &_handoff_complete,
+                  _data,
+                  &_data->__async_work);
+
+  NAPI_CALL_VALUE(napi_queue_async_work, _env, _data->__async_work);
+
+  // Return JS `undefined`
+  return NULL;
+}
+
+/** Validate a UNIX socket path and timeout, filling `sockaddr_un` and `_data` */
+static bool _handoff_arguments(
+  napi_env _env,
+  napi_value _path,
+  napi_value _timeout,
+  napi_value _callback,
+  struct sockaddr_un * _address,
+  struct _handoff_data * _data
+) {
+  napi_valuetype __type = napi_undefined;
+  napi_status __status;
+
+  __status = napi_typeof(_env, _path, &__type);
+  if ((__status != napi_ok) || (__type != napi_string)) {
+    _throw_type_error(_env, "Specified path is not a string");
+    return false;
+  }
+
+  size_t __size = 0;
+  __status = napi_get_value_string_utf8(_env, _path, _data->__path, sizeof(_data->__path), &__size);
+  if ((__status != napi_ok) || (__size < 1) || (__size >= sizeof(_data->__path) - 1)) {
+    _throw_type_error(_env, "Specified path is empty or too long for a UNIX socket");
+    return false;
+  }
+
+  bzero(_address, sizeof(struct sockaddr_un));
+  _address->sun_family = AF_UNIX;
+  memcpy(_address->sun_path, _data->__path, __size + 1);
+
+  __status = napi_typeof(_env, _timeout, &__type);
+  if ((__status != napi_ok) || (__type != napi_number)) {
+    _throw_type_error(_env, "Specified timeout is not a number");
+    return false;
+  }
+
+  __status = napi_get_value_int32(_env, _timeout, &_data->__timeout);
+  if ((__status != napi_ok) || (_data->__timeout < 1)) {
+    _throw_type_error(_env, "Specified timeout must be a positive number");
+    return false;
+  }
+
+  __status = napi_typeof(_env, _callback, &__type);
+  if ((__status != napi_ok) || (__type != napi_function)) {
+    _throw_type_error(_env, "Specified callback is not a function");
+    return false;
+  }
+
+  return true;
+}
+
+/* ========================================================================== */
+
+/**
+ * Send file descriptors and data to the process listening on a UNIX socket.
+ *
+ * Connecting and duplicating file descriptors happens synchronously (errors
+ * are thrown), so the caller can close its own sockets right after calling.
+ */
+static napi_value _handoff_send(
+  napi_env _env,
+  napi_callback_info _info
+) {
+  struct _handoff_data __data;
+  bzero(&__data, sizeof(struct _handoff_data));
+  __data.__socket = -1;
+
+  // Get our `handoff_send` call arguments
+  size_t __argc = 5;
+  napi_value __args[5];
+  NAPI_CALL_VALUE(napi_get_cb_info, _env, _info, &__argc, __args, NULL, NULL);
+
+  if (__argc != 5) {
+    _throw_type_error(_env, "Expected 5 arguments: path, file descriptors, data, timeout, callback");
+    return NULL;
+  }
+
+  struct sockaddr_un __address;
+  if (! _handoff_arguments(_env, __args[0], __args[3], __args[4], &__address, &__data)) return NULL;
+
+  // Check our file descriptors
+  bool __is_array = false;
+  NAPI_CALL_VALUE(napi_is_array, _env, __args[1], &__is_array);
+  if (! __is_array) {
+    _throw_type_error(_env, "Specified file descriptors are not an array");
+    return NULL;
+  }
+
+  uint32_t __fds_count = 0;
+  NAPI_CALL_VALUE(napi_get_array_length, _env, __args[1], &__fds_count);
+  if (__fds_count > __HANDOFF_LIMIT_FDS) {
+    _throw_type_error(_env, "Too many file descriptors specified");
+    return NULL;
+  }
+
+  int * __fds = malloc(sizeof(int) * (__fds_count + 1));
+  if (__fds == NULL) {
+    _throw_system_error(_env, "malloc", ENOMEM);
+    return NULL;
+  }
+
+  for (uint32_t __i = 0; __i < __fds_count; __i ++) {
+    napi_value __element = NULL;
+    napi_valuetype __type = napi_undefined;
+    napi_status __status = napi_get_element(_env, __args[1], __i, &__element);
+    if (__status == napi_ok) __status = napi_typeof(_env, __element, &__type);
+    if (__status == napi_ok) __status = __type == napi_number ? napi_get_value_int32(_env, __element, &__fds[__i]) : napi_number_expected;
+    if (__status != napi_ok) {
+      free(__fds);
+      _throw_type_error(_env, "Specified file descriptor is not a number");
+      return NULL;
+    }
+  }
+
+  // Check our data
+  bool __is_buffer = false;
+  NAPI_CALL_VALUE(napi_is_buffer, _env, __args[2], &__is_buffer);
+  if (! __is_buffer) {
+    free(__fds);
+    _throw_type_error(_env, "Specified data is not a buffer");
+    return NULL;
+  }
+
+  void * __buffer = NULL;
+  size_t __buffer_length = 0;
+  NAPI_CALL_VALUE(napi_get_buffer_info, _env, __args[2], &__buffer, &__buffer_length);
+  if (__buffer_length > __HANDOFF_LIMIT_DATA) {
+    free(__fds);
+    _throw_type_error(_env, "Specified data is too big");
+    return NULL;
+  }
+
+  // Connect synchronously: if nobody's listening we fail before anything else
+  int __socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (__socket < 0) {
+    free(__fds);
+    _throw_system_error(_env, "socket", errno);
+    return NULL;
+  }
+
+  if ((connect(__socket, (struct sockaddr *) &__address, sizeof(__address)) < 0) ||
+      (_set_timeouts(__socket, __data.__timeout) < 0)) {
+    int __errno = errno;
+    close(__socket);
+    free(__fds);
+    _throw_system_error(_env, "connect", __errno);
+    return NULL;
+  }
+
+  // Never hand off our sockets to a process running as another user
+  if (_check_peer(__socket) < 0) {
+    int __errno = errno;
+    close(__socket);
+    free(__fds);
+    _throw_system_error(_env, "connect", __errno);
+    return NULL;
+  }
+
+  // Duplicate our file descriptors, so that the caller can close its own
+  for (uint32_t __i = 0; __i < __fds_count; __i ++) {
+    int __fd = dup(__fds[__i]);
+    if (__fd < 0) {
+      int __errno = errno;
+      for (uint32_t __j = 0; __j < __i; __j ++) close(__fds[__j]);
+      close(__socket);
+      free(__fds);
+      _throw_system_error(_env, "dup", __errno);
+      return NULL;
+    }
+    __fds[__i] = __fd;
+  }
+
+  // Copy our data, as the buffer might be gone by the time we send it, and
+  // allocate _now_ the real `_handoff_data` structure
+  uint8_t * __copy = malloc(__buffer_length + 1);
+  struct _handoff_data * __data_ptr = malloc(sizeof(struct _handoff_data));
+  if ((__copy == NULL) || (__data_ptr == NULL)) {
+    for (uint32_t __i = 0; __i < __fds_count; __i ++) close(__fds[__i]);
+    close(__socket);
+    free(__fds);
+    free(__copy);
+    free(__data_ptr);
+    _throw_system_error(_env, "malloc", ENOMEM);
+    return NULL;
+  }
+
+  memcpy(__copy, __buffer, __buffer_length);
+  __data.__socket = __socket;
+  __data.__fds = __fds;
+  __data.__fds_count = __fds_count;
+  __data.__buffer = __copy;
+  __data.__buffer_length = __buffer_length;
+  memcpy(__data_ptr, &__data, sizeof(struct _handoff_data));
+
+  // Queue our work
+  return _handoff_queue(_env, __args[4], __data_ptr, &_handoff_send_execute, "ping_handoff_send");
+}
+
+/**
+ * Listen on a UNIX socket, and receive file descriptors and data from the
+ * first process connecting to it.
+ *
+ * Binding and listening happen synchronously (errors are thrown), so that a
+ * sender can connect as soon as this returns.
+ */
+static napi_value _handoff_receive(
+  napi_env _env,
+  napi_callback_info _info
+) {
+  struct _handoff_data __data;
+  bzero(&__data, sizeof(struct _handoff_data));
+  __data.__receiving = true;
+  __data.__socket = -1;
+
+  // Get our `handoff_receive` call arguments
+  size_t __argc = 3;
+  napi_value __args[3];
+  NAPI_CALL_VALUE(napi_get_cb_info, _env, _info, &__argc, __args, NULL, NULL);
+
+  if (__argc != 3) {
+    _throw_type_error(_env, "Expected 3 arguments: path, timeout, callback");
+    return NULL;
+  }
+
+  struct sockaddr_un __address;
+  if (! _handoff_arguments(_env, __args[0], __args[1], __args[2], &__address, &__data)) return NULL;
+
+  // Bind and listen synchronously
+  int __socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (__socket < 0) {
+    _throw_system_error(_env, "socket", errno);
+    return NULL;
+  }
+
+  if (bind(__socket, (struct sockaddr *) &__address, sizeof(__address)) < 0) {
+    int __errno = errno;
+    close(__socket);
+    _throw_system_error(_env, "bind", __errno);
+    return NULL;
+  }
+
+  // Only our own user can connect: nobody can before we listen, so no races
+  if (chmod(__data.__path, S_IRUSR | S_IWUSR) < 0) {
+    int __errno = errno;
+    close(__socket);
+    unlink(__data.__path);
+    _throw_system_error(_env, "chmod", __errno);
+    return NULL;
+  }
+
+  if (listen(__socket, 1) < 0) {
+    int __errno = errno;
+    close(__socket);
+    unlink(__data.__path);
+    _throw_system_error(_env, "listen", __errno);
+    return NULL;
+  }
+
+  // Allocate _now_ the real `_handoff_data` structure and queue our work
+  __data.__socket = __socket;
+  struct _handoff_data * __data_ptr = malloc(sizeof(struct _handoff_data));
+  if (__data_ptr == NULL) {
+    close(__socket);
+    unlink(__data.__path);
+    _throw_system_error(_env, "malloc", ENOMEM);
+    return NULL;
+  }
+  memcpy(__data_ptr, &__data, sizeof(struct _handoff_data));
+
+  return _handoff_queue(_env, __args[2], __data_ptr, &_handoff_receive_execute, "ping_handoff_receive");
+}
+
 /* ========================================================================== *
  * init: initialize the addon, injecting our properties in the `exports`      *
  * ========================================================================== */
@@ -517,10 +1469,31 @@ static napi_value init(napi_env _env, napi_value _exports) {
   NAPI_CALL_VALUE(napi_create_uint32, _env, AF_INET6, &__af_inet6);
   NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "AF_INET6", __af_inet6);
 
+  // Binaries built before `open` accepted an identifier don't export this
+  napi_value __identifiers = NULL;
+  NAPI_CALL_VALUE(napi_get_boolean, _env, true, &__identifiers);
+  NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "identifiers", __identifiers);
+
   napi_value __open_fn = NULL;
   NAPI_CALL_VALUE(napi_create_function, _env, "open", NAPI_AUTO_LENGTH, _open, NULL, &__open_fn);
   NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "open", __open_fn);
 
+  napi_value __stamp_fn = NULL;
+  NAPI_CALL_VALUE(napi_create_function, _env, "stamp", NAPI_AUTO_LENGTH, _stamp, NULL, &__stamp_fn);
+  NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "stamp", __stamp_fn);
+
+  napi_value __checksum_fn = NULL;
+  NAPI_CALL_VALUE(napi_create_function, _env, "checksum", NAPI_AUTO_LENGTH, _checksum, NULL, &__checksum_fn);
+  NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "checksum", __checksum_fn);
+
+  napi_value __handoff_send_fn = NULL;
+  NAPI_CALL_VALUE(napi_create_function, _env, "handoff_send", NAPI_AUTO_LENGTH, _handoff_send, NULL, &__handoff_send_fn);
+  NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "handoff_send", __handoff_send_fn);
+
+  napi_value __handoff_receive_fn = NULL;
+  NAPI_CALL_VALUE(napi_create_function, _env, "handoff_receive", NAPI_AUTO_LENGTH, _handoff_receive, NULL, &__handoff_receive_fn);
+  NAPI_CALL_VALUE(napi_set_named_property, _env, _exports, "handoff_receive", __handoff_receive_fn);
+
   NAPI_CALL_VALUE(napi_object_freeze, _env, _exports);
   return _exports;
 }
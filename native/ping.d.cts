@@ -3,8 +3,16 @@ type af_family = number & { __af_family: never }
 
 /** Type for our {@link open} callback */
 type open_callback =
-  | ((error: Error, fd: undefined) => void)
-  | ((error: null, fd: number) => void)
+  | ((error: Error, fd: undefined, identifier: undefined) => void)
+  | ((error: null, fd: number, identifier: number | undefined) => void)
+
+/** Type for our {@link handoff_send} callback */
+type handoff_send_callback = (error: Error | null) => void
+
+/** Type for our {@link handoff_receive} callback */
+type handoff_receive_callback =
+  | ((error: Error, fds: undefined, data: undefined) => void)
+  | ((error: null, fds: number[], data: Buffer) => void)
 
 /** Constant indicating that we are about to open an `ICMPv4` socket */
 export const AF_INET: af_family
@@ -14,21 +22,104 @@ export const AF_INET6: af_family
 /** The version of the native addon that was loaded */
 export const version: string
 
+/**
+ * Whether {@link open} accepts an ICMP identifier to bind to (binaries built
+ * before it did don't export this, and only accept the 4 arguments form).
+ */
+export const identifiers: boolean | undefined
+
 /**
  * Open an `ICMPv4` or `ICMPv6` socket optionally bound to the specified
  * IP address, and return its _file descriptor_ in a callback.
  *
+ * On Linux the socket is always bound to an ICMP _identifier_ (its "port"),
+ * either the one specified or one assigned by the kernel, and replies are
+ * delivered only to the socket bound to their identifier. The identifier is
+ * returned as the third argument of the callback (`undefined` elsewhere).
+ *
  * @param family Either the constant {@link AF_INET} for `ICMPv4` or
  *               {@link AF_INET6} for `ICMPv6`
  * @param from_address An _IP address_ (not a _host name_) the socked should be
  *                     bound to before being returned. This must be a valid
  *                     address for a local interface, or `null` or `undefined`.
  * @param source_interface The interface name to bind, or `null` or `undefined`.
+ * @param identifier The ICMP identifier to bind to (0...65535), where `0`,
+ *                   `null` or `undefined` let the kernel assign one. It can
+ *                   be omitted, as older binaries only accept 4 arguments.
  * @param callback The callback to invoke after the socket was opened and bound.
  */
 export function open(
   family: af_family,
   from_address: string | null | undefined,
   source_interface: string | null | undefined,
+  identifier: number | null | undefined,
   callback: open_callback
 ): void
+export function open(
+  family: af_family,
+  from_address: string | null | undefined,
+  source_interface: string | null | undefined,
+  callback: open_callback
+): void
+
+/**
+ * Return the delay (in nanoseconds) between the time the kernel received the
+ * last packet on a socket and _now_, or `undefined` if this is unknown (no
+ * packet was received yet, or the platform doesn't support it).
+ *
+ * @param fd The file descriptor of a socket returned by {@link open}.
+ */
+export function stamp(fd: number): bigint | undefined
+
+/**
+ * Return the Internet checksum (RFC 1071) of the specified data, optionally
+ * prepended by the ICMPv6 pseudo header for the specified source and
+ * destination addresses (16 bytes each).
+ *
+ * The checksum of a packet including its (correct) checksum is always `0`.
+ *
+ * @param data The ICMP or ICMPv6 packet to compute the checksum of.
+ * @param source The IPv6 source address (for ICMPv6 only).
+ * @param destination The IPv6 destination address (for ICMPv6 only).
+ */
+export function checksum(data: Buffer): number
+export function checksum(data: Buffer, source: Buffer, destination: Buffer): number
+
+/**
+ * Send file descriptors and some data to the process listening on a UNIX
+ * socket (see {@link handoff_receive}).
+ *
+ * Connecting to the UNIX socket and duplicating the file descriptors happen
+ * synchronously (and errors are thrown), so that the caller can close its
+ * own file descriptors immediately after calling this.
+ *
+ * @param path The path of the UNIX socket to connect to.
+ * @param fds The file descriptors to send.
+ * @param data The data to send along with the file descriptors.
+ * @param timeout The timeout (in milliseconds) for sending.
+ * @param callback The callback to invoke after the receiver acknowledged.
+ */
+export function handoff_send(
+  path: string,
+  fds: number[],
+  data: Buffer,
+  timeout: number,
+  callback: handoff_send_callback,
+): void
+
+/**
+ * Listen on a UNIX socket, and receive file descriptors and some data from
+ * the first process connecting to it (see {@link handoff_send}).
+ *
+ * Binding and listening happen synchronously (and errors are thrown) and the
+ * path of the UNIX socket is removed once a connection is accepted.
+ *
+ * @param path The path of the UNIX socket to listen on.
+ * @param timeout The timeout (in milliseconds) for accepting and receiving.
+ * @param callback The callback to invoke with the file descriptors and data.
+ */
+export function handoff_receive(
+  path: string,
+  timeout: number,
+  callback: handoff_receive_callback,
+): void
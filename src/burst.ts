@@ -0,0 +1,134 @@
+/* ========================================================================== *
+ * BURSTS                                                                     *
+ * ========================================================================== *
+ *                                                                            *
+ * Sends a number of probes back-to-back (or at a fixed, possibly sub-milli-  *
+ * second, spacing) and summarizes their outcome once all replies are in, or  *
+ * timed out, for on-demand diagnostics ("probe 100 times, now").             *
+ *                                                                            *
+ * Timers have a (roughly) 1 millisecond resolution, so spacing is kept by    *
+ * sending every probe whose time has come, and then yielding to the event    *
+ * loop with `setImmediate` (replies are received meanwhile). Only when the   *
+ * next probe is more than a couple of milliseconds away, a timer is used.    *
+ *                                                                            *
+ * The summary is computed by the same accumulator used for rollups.          *
+ *                                                                            *
+ * ========================================================================== */
+
+import { ProbeError } from './probe'
+import { RollupAccumulator } from './rollup'
+
+import type { PingerProbe } from './probe'
+
+/** The summary of a burst of probes */
+export interface PingerBurst {
+  /** The number of probes sent */
+  sent: number,
+  /** The number of probes answered */
+  received: number,
+  /** The number of probes lost (timed out, or overtaken by a later reply) */
+  lost: number,
+  /** The ratio (0...1) of lost probes over sent ones */
+  loss: number,
+  /**
+   * The number of probes overtaken by a later reply, already counted in
+   * `lost`: this is _not_ a count of reordered replies, as late replies to
+   * overtaken probes are never accepted (and can't be told from lost ones)
+   */
+  overtaken: number,
+  /** The minimum round trip time (in milliseconds) or `NaN` */
+  min: number,
+  /** The maximum round trip time (in milliseconds) or `NaN` */
+  max: number,
+  /** The average round trip time (in milliseconds) or `NaN` */
+  avg: number,
+  /** The 50th percentile round trip time (in milliseconds) or `NaN` */
+  p50: number,
+  /** The 90th percentile round trip time (in milliseconds) or `NaN` */
+  p90: number,
+  /** The 95th percentile round trip time (in milliseconds) or `NaN` */
+  p95: number,
+  /** The 99th percentile round trip time (in milliseconds) or `NaN` */
+  p99: number,
+  /** The mean absolute difference between consecutive round trip times or `NaN` */
+  jitter: number,
+  /** The time **in milliseconds** between the first probe sent and the last settled */
+  elapsed: number,
+}
+
+/** Validate the count and spacing of a burst */
+export function checkBurst(count: number, spacing: number): void {
+  if ((! Number.isInteger(count)) || (count < 1)) {
+    throw new Error(`Invalid burst count ${count} (must be an integer >= 1)`)
+  }
+  if ((! Number.isFinite(spacing)) || (spacing < 0)) {
+    throw new Error(`Invalid burst spacing ${spacing} (must be a number >= 0 ms)`)
+  }
+}
+
+/**
+ * Send `count` probes spaced by `spacing` milliseconds (zero: back-to-back)
+ * and summarize them. Errors other than lost probes reject the burst.
+ */
+export async function burst(
+    probe: () => Promise<PingerProbe>,
+    count: number,
+    spacing: number,
+): Promise<PingerBurst> {
+  checkBurst(count, spacing)
+
+  const accumulator = new RollupAccumulator()
+  const probes: Promise<void>[] = []
+  let failure: Error | undefined = undefined
+  let overtaken = 0
+
+  const settle = (promise: Promise<PingerProbe>): Promise<void> => promise.then(({ rtt }) => {
+    accumulator.received(rtt)
+  }, (error) => {
+    if (! (error instanceof ProbeError)) {
+      failure ||= error
+      return
+    }
+    if (error.code === 'ERR_PROBE_OVERTAKEN') overtaken ++
+    accumulator.lost(1)
+  })
+
+  // Send all probes whose time has come, then wait for the next one
+  const step = BigInt(Math.round(spacing * 1000000))
+  const start = process.hrtime.bigint()
+  await new Promise<void>((resolve) => {
+    const send = (): void => {
+      const now = process.hrtime.bigint()
+      while ((! failure) && (probes.length < count) && ((start + BigInt(probes.length) * step) <= now)) {
+        accumulator.sent()
+        probes.push(settle(probe()))
+      }
+      if (failure || (probes.length >= count)) return resolve()
+
+      const wait = Number(start + BigInt(probes.length) * step - now) / 1000000
+      if (wait > 2) setTimeout(send, Math.floor(wait) - 1)
+      else setImmediate(send)
+    }
+    send()
+  })
+
+  await Promise.all(probes)
+  if (failure) throw failure
+  return summarize(accumulator, overtaken, Number(process.hrtime.bigint() - start) / 1000000)
+}
+
+/** Summarize the probes recorded by an accumulator (for bursts and floods) */
+export function summarize(accumulator: RollupAccumulator, overtaken: number, elapsed: number): PingerBurst {
+  const { sent, received, lost, min, max, avg, p50, p90, p95, p99, jitter } = accumulator.rollup('', 0, 0)
+  return {
+    sent,
+    received,
+    lost,
+    loss: sent < 1 ? NaN : lost / sent,
+    overtaken,
+    min, max, avg,
+    p50, p90, p95, p99,
+    jitter,
+    elapsed,
+  }
+}
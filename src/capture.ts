@@ -0,0 +1,359 @@
+/* ========================================================================== *
+ * PACKET CAPTURE                                                             *
+ * ========================================================================== *
+ *                                                                            *
+ * Keeps the last `size` packets sent and received by a pinger (including     *
+ * the ones rejected by the protocol handler) in a preallocated ring, so that *
+ * when something goes wrong we have actual packets to look at.               *
+ *                                                                            *
+ * Each slot in the ring holds up to SNAPLEN bytes of the packet, its time    *
+ * (received packets use the kernel's timestamp, when available), direction   *
+ * and the result of validating it. No memory is allocated per packet.        *
+ *                                                                            *
+ * Captures are exported as pcapng (https://www.ietf.org/archive/id/draft-    *
+ * tuexen-opsawg-pcapng-05.html) only on demand. As ping sockets only give us *
+ * the ICMP message, an IPv4 or IPv6 header is synthesized for each packet.   *
+ *                                                                            *
+ * A "warning storm" is detected when `warnings` warnings happen within a     *
+ * `window` of milliseconds.                                                  *
+ *                                                                            *
+ * ========================================================================== */
+
+import { isIPv4 } from 'node:net'
+import { performance } from 'node:perf_hooks'
+
+import { ERR_WRONG_SOURCE, getWarning } from './protocol'
+
+/** Options for packet capture */
+export interface CaptureOptions {
+  /** The number of packets to keep (default: 256) */
+  size?: number,
+  /** The number of warnings making a _storm_ (default: 10) */
+  warnings?: number,
+  /** The window **in milliseconds** for detecting warning storms (default: 1000) */
+  window?: number,
+  /** A directory where captures are written on warning storms or changes */
+  directory?: string,
+}
+
+/** A packet capture, produced automatically on warning storms or changes */
+export interface PingerCapture {
+  /** Why this capture was produced */
+  reason: 'storm' | 'change',
+  /** The pcapng file contents */
+  data: Buffer,
+  /** The file the capture was written to (when a `directory` was specified) */
+  file?: string,
+}
+
+/** The maximum number of bytes captured per packet */
+export const SNAPLEN = 128
+
+/* Packet directions, as in the pcapng "epb_flags" option */
+const INBOUND = 1
+const OUTBOUND = 2
+
+/* Link types for raw IPv4 and IPv6 packets */
+const LINKTYPE_IPV4 = 228
+const LINKTYPE_IPV6 = 229
+
+export class Capture {
+  /** The directory where captures are written automatically, if any */
+  readonly directory: string | undefined
+
+  private __size: number
+  private readonly __warnings: number
+  private readonly __window: number
+  private __data: Buffer
+  private __lengths: Uint16Array
+  private __times: Float64Array
+  private __directions: Uint8Array
+  private __results: Int8Array
+  private readonly __storm: Float64Array
+
+  private __next: number = 0
+  private __count: number = 0
+  private __since: number = 0
+  private __warning: number = 0
+
+  constructor(options: CaptureOptions = {}) {
+    const { size = 256, warnings = 10, window = 1000, directory } = options
+
+    if (!(Number.isInteger(size) && size >= 1)) throw new Error(`Invalid capture size ${size}`)
+    if (!(Number.isInteger(warnings) && warnings >= 1)) throw new Error(`Invalid capture warnings ${warnings}`)
+    if (!(window > 0)) throw new Error(`Invalid capture window ${window}`)
+
+    this.directory = directory
+    this.__size = size
+    this.__warnings = warnings
+    this.__window = window
+    this.__data = Buffer.alloc(size * SNAPLEN)
+    this.__lengths = new Uint16Array(size)
+    this.__times = new Float64Array(size)
+    this.__directions = new Uint8Array(size)
+    this.__results = new Int8Array(size)
+    this.__storm = new Float64Array(warnings).fill(-Infinity)
+    this.__since = size // the first automatic capture is always allowed
+  }
+
+  /** The number of bytes used by this capture's ring */
+  get bytes(): number {
+    return this.__data.byteLength + this.__lengths.byteLength + this.__times.byteLength +
+      this.__directions.byteLength + this.__results.byteLength + this.__storm.byteLength
+  }
+
+  /** The number of packets currently in the ring */
+  get count(): number {
+    return this.__count
+  }
+
+  /**
+   * Whether an _automatic_ capture can be produced: we only allow one once
+   * the ring was completely refreshed since the last one, so that the same
+   * packets never end up in two different captures.
+   */
+  get armed(): boolean {
+    return this.__since >= this.__size
+  }
+
+  /** Record a packet sent at the specified time (wall clock, in ms) */
+  sent(buffer: Buffer, time: number): void {
+    this.__record(buffer, time, OUTBOUND, 0)
+  }
+
+  /** Record a packet received at the specified time, and its validation result */
+  received(buffer: Buffer, time: number, result: bigint): void {
+    this.__record(buffer, time, INBOUND, result < 0n ? Number(result) : 0)
+  }
+
+  /**
+   * Record a packet received from an address other than our target, keeping
+   * its real source in a synthesized IP header (unless it already has one).
+   */
+  stray(buffer: Buffer, time: number, source: string, local: string | undefined): void {
+    const version = buffer.length > 0 ? buffer[0]! >> 4 : 0
+    if ((version !== 4) && (version !== 6)) {
+      const from = address(source)
+      const to = local ? address(local) : Buffer.alloc(from.length)
+      const header = from.length === 4 ? ipv4Header(buffer.length, from, to) : ipv6Header(buffer.length, from, to)
+      buffer = Buffer.concat([ header, buffer ])
+    }
+    this.__record(buffer, time, INBOUND, Number(ERR_WRONG_SOURCE))
+  }
+
+  /** Record a warning at the specified time, returning `true` on a warning storm */
+  warning(time: number): boolean {
+    // After writing, the next slot holds the oldest of the last n warnings
+    this.__storm[this.__warning] = time
+    this.__warning = (this.__warning + 1) % this.__warnings
+    return (time - this.__storm[this.__warning]!) <= this.__window
+  }
+
+  /**
+   * Export all packets in the ring as a pcapng file, synthesizing IP headers
+   * with the specified local (our) and remote (target) addresses.
+   */
+  pcapng(local: string | undefined, remote: string): Buffer {
+    const v4 = isIPv4(remote)
+    const remoteAddress = address(remote)
+    const localAddress = local ? address(local) : Buffer.alloc(remoteAddress.length)
+
+    const blocks: Buffer[] = [ sectionHeader(), interfaceDescription(v4 ? LINKTYPE_IPV4 : LINKTYPE_IPV6) ]
+
+    const first = (this.__next - this.__count + this.__size) % this.__size
+    for (let i = 0; i < this.__count; i ++) {
+      const slot = (first + i) % this.__size
+      const inbound = this.__directions[slot] === INBOUND
+      const length = this.__lengths[slot]!
+      const captured = this.__data.subarray(slot * SNAPLEN, slot * SNAPLEN + Math.min(length, SNAPLEN))
+
+      // Packets starting with an IP version already contain their IP header
+      const version = captured.length > 0 ? captured[0]! >> 4 : 0
+      const header = (version === 4) || (version === 6) ? Buffer.alloc(0) :
+        v4 ? ipv4Header(length, inbound ? remoteAddress : localAddress, inbound ? localAddress : remoteAddress) :
+        ipv6Header(length, inbound ? remoteAddress : localAddress, inbound ? localAddress : remoteAddress)
+
+      const result = this.__results[slot]!
+      const comment = result < 0 ? getWarning(BigInt(result)).code : undefined
+
+      blocks.push(enhancedPacket(
+          this.__times[slot]!,
+          Buffer.concat([ header, captured ]),
+          header.length + length,
+          inbound ? INBOUND : OUTBOUND,
+          comment))
+    }
+
+    return Buffer.concat(blocks)
+  }
+
+  /**
+   * Halve the size of this capture's ring (keeping the most recent packets)
+   * returning `false` if already down to a single packet.
+   */
+  shrink(): boolean {
+    if (this.__size < 2) return false
+
+    const size = Math.floor(this.__size / 2)
+    const count = Math.min(this.__count, size)
+    const data = Buffer.alloc(size * SNAPLEN)
+    const lengths = new Uint16Array(size)
+    const times = new Float64Array(size)
+    const directions = new Uint8Array(size)
+    const results = new Int8Array(size)
+
+    // Copy the last "count" packets, oldest first, at the start of the ring
+    const first = (this.__next - count + this.__size) % this.__size
+    for (let i = 0; i < count; i ++) {
+      const slot = (first + i) % this.__size
+      this.__data.copy(data, i * SNAPLEN, slot * SNAPLEN, (slot + 1) * SNAPLEN)
+      lengths[i] = this.__lengths[slot]!
+      times[i] = this.__times[slot]!
+      directions[i] = this.__directions[slot]!
+      results[i] = this.__results[slot]!
+    }
+
+    this.__size = size
+    this.__data = data
+    this.__lengths = lengths
+    this.__times = times
+    this.__directions = directions
+    this.__results = results
+    this.__next = count % size
+    this.__count = count
+    this.__since = Math.min(this.__since, size)
+    return true
+  }
+
+  /** Disarm automatic captures until the ring is completely refreshed */
+  disarm(): void {
+    this.__since = 0
+  }
+
+  private __record(buffer: Buffer, time: number, direction: number, result: number): void {
+    const slot = this.__next
+    buffer.copy(this.__data, slot * SNAPLEN, 0, Math.min(buffer.length, SNAPLEN))
+    this.__lengths[slot] = Math.min(buffer.length, 0xffff)
+    this.__times[slot] = time
+    this.__directions[slot] = direction
+    this.__results[slot] = result
+
+    this.__next = (slot + 1) % this.__size
+    if (this.__count < this.__size) this.__count ++
+    if (this.__since < this.__size) this.__since ++
+  }
+}
+
+/** The current wall clock time in milliseconds (with sub-millisecond precision) */
+export function wallClock(): number {
+  return performance.timeOrigin + performance.now()
+}
+
+/* ========================================================================== *
+ * PCAPNG BLOCKS AND IP HEADERS                                               *
+ * ========================================================================== */
+
+/** Wrap a block body with its type and (repeated) total length */
+function block(type: number, body: Buffer): Buffer {
+  const length = 12 + body.length
+  const buffer = Buffer.alloc(length)
+  buffer.writeUInt32LE(type, 0)
+  buffer.writeUInt32LE(length, 4)
+  body.copy(buffer, 8)
+  buffer.writeUInt32LE(length, length - 4)
+  return buffer
+}
+
+/** Encode an option, padded to 32 bits */
+function option(code: number, value: Buffer): Buffer {
+  const buffer = Buffer.alloc(4 + ((value.length + 3) & ~3))
+  buffer.writeUInt16LE(code, 0)
+  buffer.writeUInt16LE(value.length, 2)
+  value.copy(buffer, 4)
+  return buffer
+}
+
+function sectionHeader(): Buffer {
+  const body = Buffer.alloc(16)
+  body.writeUInt32LE(0x1a2b3c4d, 0) // byte order magic
+  body.writeUInt16LE(1, 4) // major version
+  body.writeUInt16LE(0, 6) // minor version
+  body.writeBigInt64LE(-1n, 8) // section length (unspecified)
+  return block(0x0a0d0d0a, body)
+}
+
+function interfaceDescription(linktype: number): Buffer {
+  const body = Buffer.alloc(8)
+  body.writeUInt16LE(linktype, 0)
+  body.writeUInt32LE(0, 4) // no snap length (we add IP headers to SNAPLEN)
+  return block(0x00000001, body)
+}
+
+function enhancedPacket(time: number, data: Buffer, length: number, flags: number, comment?: string): Buffer {
+  // Timestamps are in microseconds (the default "if_tsresol")
+  const micros = Math.round(time * 1000)
+
+  const header = Buffer.alloc(20)
+  header.writeUInt32LE(0, 0) // interface id
+  header.writeUInt32LE(Math.floor(micros / 0x100000000), 4)
+  header.writeUInt32LE(micros % 0x100000000, 8)
+  header.writeUInt32LE(data.length, 12)
+  header.writeUInt32LE(length, 16)
+
+  const padding = Buffer.alloc(((data.length + 3) & ~3) - data.length)
+  const flagsValue = Buffer.alloc(4)
+  flagsValue.writeUInt32LE(flags, 0)
+
+  const options = [ option(2, flagsValue) ] // epb_flags
+  if (comment) options.push(option(1, Buffer.from(comment, 'utf8'))) // opt_comment
+  options.push(Buffer.alloc(4)) // opt_endofopt
+
+  return block(0x00000006, Buffer.concat([ header, data, padding, ...options ]))
+}
+
+function ipv4Header(length: number, source: Buffer, destination: Buffer): Buffer {
+  const header = Buffer.alloc(20)
+  header.writeUInt8(0x45, 0) // version 4, 5 words header
+  header.writeUInt16BE(20 + length, 2) // total length
+  header.writeUInt16BE(0x4000, 6) // don't fragment
+  header.writeUInt8(64, 8) // ttl
+  header.writeUInt8(1, 9) // protocol: ICMP
+  source.copy(header, 12)
+  destination.copy(header, 16)
+
+  let sum = 0
+  for (let i = 0; i < 20; i += 2) sum += header.readUInt16BE(i)
+  while (sum > 0xffff) sum = (sum & 0xffff) + (sum >>> 16)
+  header.writeUInt16BE((~sum) & 0xffff, 10)
+  return header
+}
+
+function ipv6Header(length: number, source: Buffer, destination: Buffer): Buffer {
+  const header = Buffer.alloc(40)
+  header.writeUInt32BE(0x60000000, 0) // version 6
+  header.writeUInt16BE(length, 4) // payload length
+  header.writeUInt8(58, 6) // next header: ICMPv6
+  header.writeUInt8(64, 7) // hop limit
+  source.copy(header, 8)
+  destination.copy(header, 24)
+  return header
+}
+
+/** Convert an IPv4 or IPv6 address into its bytes */
+export function address(ip: string): Buffer {
+  if (isIPv4(ip)) return Buffer.from(ip.split('.').map((octet) => parseInt(octet)))
+
+  // Strip any zone, and convert any trailing IPv4 address in two groups
+  ip = ip.replace(/%.*$/, '').replace(/(\d+)\.(\d+)\.(\d+)\.(\d+)$/, (_, a, b, c, d) =>
+    `${((a << 8) | b).toString(16)}:${((c << 8) | d).toString(16)}`)
+
+  const [ head, tail ] = ip.split('::') as [ string, string | undefined ]
+  const first = head ? head.split(':') : []
+  const last = tail ? tail.split(':') : []
+  const groups = tail === undefined ? first :
+    [ ...first, ...new Array(8 - first.length - last.length).fill('0'), ...last ]
+
+  const buffer = Buffer.alloc(16)
+  groups.forEach((group, i) => buffer.writeUInt16BE(parseInt(group, 16), i * 2))
+  return buffer
+}
@@ -0,0 +1,105 @@
+/* ========================================================================== *
+ * CHECKPOINTS                                                                *
+ * ========================================================================== *
+ *                                                                            *
+ * Saves the state of all pingers in a group to a file, and restores it when  *
+ * (re)starting, so that a restarted collector doesn't need to re-resolve all *
+ * its host names, nor to re-learn baselines and refill its windows.          *
+ *                                                                            *
+ * Checkpoints use the same encoding as socket handoffs, but sockets can not  *
+ * be saved: new ones are opened when restoring. As replies to requests sent  *
+ * from the old sockets will never be received by the new ones, requests in   *
+ * flight are not saved, while sequence numbers and correlation data are.     *
+ *                                                                            *
+ * ========================================================================== */
+
+import { readFile, rename, writeFile } from 'node:fs/promises'
+
+import { createPingerGroup } from './group'
+import { OPEN_CONCURRENCY } from './lazy'
+import { createPinger } from './pinger'
+import { decodeStates, encodeStates } from './state'
+
+import type { PingerGroup, PingerGroupImpl, PingerGroupOptions } from './group'
+import type { PingerImpl } from './pinger'
+
+/**
+ * Save the state of all the (open) pingers in a group to a file.
+ *
+ * The file is written atomically (written to a temporary file and renamed)
+ * so that a crash while checkpointing never leaves a truncated checkpoint.
+ *
+ * @param file The file to write the checkpoint to.
+ * @param group The group whose pingers should be checkpointed.
+ */
+export async function checkpoint(file: string, group: PingerGroup): Promise<void> {
+  const states = [ ...group.entries() ]
+      .filter(([ , pinger ]) => ! pinger.closed)
+      .map(([ to, pinger ]) => {
+        const state = (pinger as PingerImpl).__save(to)
+        return { ...state, fd: -1, handler: { ...state.handler, inflight: [] } }
+      })
+
+  const temporary = `${file}.${process.pid}.tmp`
+  await writeFile(temporary, encodeStates(states))
+  await rename(temporary, file)
+}
+
+/**
+ * Create a new group restoring all the pingers (and their state) saved in a
+ * checkpoint file (see {@link checkpoint}).
+ *
+ * Pingers are keyed by the address or host name they were originally added
+ * with, but ping the _address_ resolved when first added, so no host name is
+ * resolved again. Sockets are opened concurrently (at most `OPEN_CONCURRENCY`
+ * at a time, like lazy opens) and the returned group is _not_ started.
+ *
+ * @param file The checkpoint file to read.
+ * @param options The options for the new group (and its pingers' defaults)
+ */
+export async function restoreCheckpoint(file: string, options: PingerGroupOptions = {}): Promise<PingerGroup> {
+  const states = decodeStates(await readFile(file))
+  const group = createPingerGroup(options) as PingerGroupImpl
+  const pingers: PingerImpl[] = new Array(states.length)
+
+  // Each worker opens the next socket to open, until none is left (or one failed)
+  let next = 0
+  const open = async (): Promise<void> => {
+    while (next < states.length) {
+      const index = next ++
+      const { target, protocol, from, source, timeout, interval } = states[index]!
+      try {
+        pingers[index] = await createPinger(target, {
+          ...options,
+          rollup: undefined,
+          protocol,
+          from,
+          source,
+          timeout,
+          interval,
+        }) as PingerImpl
+      } catch (error) {
+        next = states.length
+        throw error
+      }
+    }
+  }
+
+  const workers = new Array(Math.min(states.length, OPEN_CONCURRENCY)).fill(0).map(open)
+  const failed = (await Promise.allSettled(workers)).find((settled) => settled.status === 'rejected')
+  if (failed) {
+    await Promise.all(pingers.filter((pinger) => pinger).map((pinger) => pinger.close()))
+    throw (failed as PromiseRejectedResult).reason
+  }
+
+  // Adopt pingers in the same order they were saved in, and restore them
+  states.forEach((state, index) => group.__adopt(state.to, pingers[index]!))
+  try {
+    states.forEach((state, index) => pingers[index]!.__restore(state))
+  } catch (error) {
+    await group.close()
+    throw error
+  }
+
+  return group
+}
@@ -0,0 +1,164 @@
+/* ========================================================================== *
+ * CLOCKS                                                                     *
+ * ========================================================================== *
+ *                                                                            *
+ * Where time comes from: the monotonic time (in nanoseconds), interval and   *
+ * one-shot timers. The system clock uses `process.hrtime` and Node's timers  *
+ * (unref'd unless asked otherwise), while the virtual clock only moves       *
+ * forward when running its events, in order, as fast as possible.            *
+ *                                                                            *
+ * Virtual events are kept in a binary heap ordered by time (and insertion),  *
+ * so scheduling and running each event is O(log n).                          *
+ *                                                                            *
+ * ========================================================================== */
+
+/** An opaque handle for a timer created by a {@link Clock} */
+export type ClockTimer = object
+
+/** A source of time, and timers */
+export interface Clock {
+  /** The current monotonic time, in nanoseconds */
+  now(): bigint
+  /** Invoke `callback` every `ms` milliseconds */
+  setInterval(callback: () => void, ms: number): ClockTimer
+  /** Cancel a timer created by `setInterval` */
+  clearInterval(timer: ClockTimer): void
+  /** Invoke `callback` once after `ms` milliseconds (`ref` keeps the process alive meanwhile) */
+  setTimeout(callback: () => void, ms: number, ref?: boolean): ClockTimer
+  /** Cancel a timer created by `setTimeout` */
+  clearTimeout(timer: ClockTimer): void
+}
+
+/** The system's clock, with timers not keeping the process alive */
+export const systemClock: Clock = {
+  now: () => process.hrtime.bigint(),
+  setInterval: (callback, ms) => setInterval(callback, ms).unref(),
+  clearInterval: (timer) => clearInterval(timer as NodeJS.Timeout),
+  setTimeout: (callback, ms, ref = false) => ref ? setTimeout(callback, ms) : setTimeout(callback, ms).unref(),
+  clearTimeout: (timer) => clearTimeout(timer as NodeJS.Timeout),
+}
+
+/** An event scheduled on a {@link VirtualClock} */
+interface VirtualEvent {
+  /** The time (in nanoseconds) this event runs at */
+  time: number,
+  /** The order this event was scheduled in (for events at the same time) */
+  order: number,
+  /** The callback to run */
+  callback: () => void,
+  /** The interval (in nanoseconds) for repeating events, or zero */
+  interval: number,
+  /** Whether this event was cancelled */
+  cancelled: boolean,
+}
+
+/** A clock whose time only moves when running its events */
+export class VirtualClock implements Clock {
+  private readonly __heap: VirtualEvent[] = []
+  private __now: number = 0
+  private __order: number = 0
+
+  /** The current (virtual) time, in nanoseconds (as a number) */
+  get time(): number {
+    return this.__now
+  }
+
+  /** The number of events waiting to run */
+  get pending(): number {
+    return this.__heap.length
+  }
+
+  now(): bigint {
+    return BigInt(this.__now)
+  }
+
+  setInterval(callback: () => void, ms: number): ClockTimer {
+    const interval = Math.max(Math.round(ms * 1000000), 1)
+    return this.__push({ time: this.__now + interval, order: 0, callback, interval, cancelled: false })
+  }
+
+  clearInterval(timer: ClockTimer): void {
+    (timer as VirtualEvent).cancelled = true
+  }
+
+  setTimeout(callback: () => void, ms: number): ClockTimer {
+    return this.schedule(Math.round(ms * 1000000), callback)
+  }
+
+  clearTimeout(timer: ClockTimer): void {
+    (timer as VirtualEvent).cancelled = true
+  }
+
+  /** Run `callback` once, after `ns` nanoseconds */
+  schedule(ns: number, callback: () => void): ClockTimer {
+    return this.__push({ time: this.__now + Math.max(ns, 0), order: 0, callback, interval: 0, cancelled: false })
+  }
+
+  /**
+   * Run all events up to (and including) `time` nanoseconds, in order, and
+   * move the clock to `time`. Returns the number of events run.
+   */
+  run(time: number): number {
+    const heap = this.__heap
+    let count = 0
+
+    while (heap.length && (heap[0]!.time <= time)) {
+      const event = this.__pop()
+      if (event.cancelled) continue
+
+      this.__now = event.time
+      if (event.interval) {
+        event.time += event.interval
+        this.__push(event)
+      }
+
+      event.callback()
+      count ++
+    }
+
+    this.__now = Math.max(this.__now, time)
+    return count
+  }
+
+  /** Add an event to our heap, sifting it up */
+  private __push(event: VirtualEvent): VirtualEvent {
+    const heap = this.__heap
+    event.order = this.__order ++
+
+    let index = heap.push(event) - 1
+    while (index > 0) {
+      const parent = (index - 1) >> 1
+      if (! before(event, heap[parent]!)) break
+      heap[index] = heap[parent]!
+      index = parent
+    }
+    heap[index] = event
+    return event
+  }
+
+  /** Remove the first event from our heap, sifting the last one down */
+  private __pop(): VirtualEvent {
+    const heap = this.__heap
+    const first = heap[0]!
+    const last = heap.pop()!
+    if (heap.length === 0) return first
+
+    let index = 0
+    for (;;) {
+      const left = index * 2 + 1
+      if (left >= heap.length) break
+      const right = left + 1
+      const child = (right < heap.length) && before(heap[right]!, heap[left]!) ? right : left
+      if (! before(heap[child]!, last)) break
+      heap[index] = heap[child]!
+      index = child
+    }
+    heap[index] = last
+    return first
+  }
+}
+
+/** Whether event `a` runs before event `b` */
+function before(a: VirtualEvent, b: VirtualEvent): boolean {
+  return (a.time < b.time) || ((a.time === b.time) && (a.order < b.order))
+}
@@ -0,0 +1,251 @@
+/* ========================================================================== *
+ * ONLINE CHANGE DETECTION                                                    *
+ * ========================================================================== *
+ *                                                                            *
+ * Cheap streaming change-point detection for latency and packet loss.        *
+ *                                                                            *
+ * For each metric we keep an EWMA baseline and two one-sided CUSUMs (one for *
+ * upward and one for downward shifts). A change is signalled only when the   *
+ * accumulated evidence crosses the configured threshold, after which the     *
+ * baseline is moved to the new level and the CUSUMs restart from zero.       *
+ *                                                                            *
+ * - Latency: samples are standardized against the EWMA mean and deviation,   *
+ *            and clamped so that a single spike can never trigger a change.  *
+ * - Loss:    each probe is a Bernoulli trial (lost or received), and the     *
+ *            CUSUMs accumulate the log-likelihood ratio between the baseline *
+ *            loss rate and a doubled (upwards) or halved (downwards) one.    *
+ *                                                                            *
+ * Everything is O(1) in time and memory per sample.                          *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Options for the change detector */
+export interface DetectorOptions {
+  /** The EWMA smoothing factor for baselines (default: `0.05`) */
+  alpha?: number,
+  /** The CUSUM decision threshold (default: `5`) */
+  threshold?: number,
+  /** The CUSUM slack for latency, in standard deviations (default: `0.5`) */
+  slack?: number,
+  /** The number of samples used to learn baselines before detecting (default: `30`) */
+  warmup?: number,
+}
+
+/** A change detected in the behavior of a target */
+export interface PingerChange {
+  /** The metric that changed: `latency` (in ms) or `loss` (ratio 0...1) */
+  metric: 'latency' | 'loss',
+  /** The direction of the change */
+  direction: 'up' | 'down',
+  /** The baseline value _before_ the change */
+  from: number,
+  /** The estimated value _after_ the change */
+  to: number,
+}
+
+/** Clamp for standardized latency samples: spikes can't alarm on their own */
+const LATENCY_CLAMP = 3
+/** Minimum latency deviation in milliseconds and relative to the mean */
+const LATENCY_MIN_DEVIATION = 0.01
+const LATENCY_MIN_RELATIVE = 0.05
+/** Minimum and maximum baseline loss rates (keep likelihoods finite) */
+const LOSS_MIN_RATE = 0.005
+const LOSS_MAX_RATE = 0.995
+/** Minimum baseline loss rate for detecting downward changes */
+const LOSS_MIN_DOWN_RATE = 0.01
+
+export class ChangeDetector {
+  private readonly __alpha: number
+  private readonly __threshold: number
+  private readonly __slack: number
+  private readonly __warmup: number
+
+  /* Latency: samples, EWMA mean and variance, CUSUMs and their run sums */
+  private __lat_n: number = 0
+  private __lat_mean: number = 0
+  private __lat_var: number = 0
+  private __lat_up: number = 0
+  private __lat_up_n: number = 0
+  private __lat_up_sum: number = 0
+  private __lat_down: number = 0
+  private __lat_down_n: number = 0
+  private __lat_down_sum: number = 0
+
+  /* Loss: samples, EWMA rate, CUSUMs and their run counters */
+  private __loss_n: number = 0
+  private __loss_rate: number = 0
+  private __loss_up: number = 0
+  private __loss_up_n: number = 0
+  private __loss_up_lost: number = 0
+  private __loss_down: number = 0
+  private __loss_down_n: number = 0
+  private __loss_down_lost: number = 0
+
+  constructor(options: DetectorOptions = {}) {
+    const {
+      alpha = 0.05,
+      threshold = 5,
+      slack = 0.5,
+      warmup = 30,
+    } = options
+
+    if (!(alpha > 0 && alpha < 1)) throw new Error(`Invalid detector alpha ${alpha}`)
+    if (!(threshold > 0)) throw new Error(`Invalid detector threshold ${threshold}`)
+    if (!(slack >= 0)) throw new Error(`Invalid detector slack ${slack}`)
+    if (!(warmup >= 0)) throw new Error(`Invalid detector warmup ${warmup}`)
+
+    this.__alpha = alpha
+    this.__threshold = threshold
+    this.__slack = slack
+    this.__warmup = warmup
+  }
+
+  /** Feed a latency sample (in milliseconds), returning any detected change */
+  latency(value: number): PingerChange | undefined {
+    const n = ++ this.__lat_n
+
+    // During warmup we simply learn the baseline (faster at the beginning)
+    if (n <= this.__warmup) {
+      this.__learnLatency(value, Math.max(this.__alpha, 1 / n))
+      return
+    }
+
+    const deviation = Math.max(
+        Math.sqrt(this.__lat_var),
+        this.__lat_mean * LATENCY_MIN_RELATIVE,
+        LATENCY_MIN_DEVIATION)
+    const z = Math.max(-LATENCY_CLAMP, Math.min(LATENCY_CLAMP, (value - this.__lat_mean) / deviation))
+
+    this.__lat_up = Math.max(0, this.__lat_up + z - this.__slack)
+    this.__lat_down = Math.max(0, this.__lat_down - z - this.__slack)
+
+    // Track the samples in the current (non-zero) CUSUM runs to estimate
+    // the new level when a change is detected
+    if (this.__lat_up > 0) {
+      this.__lat_up_n ++
+      this.__lat_up_sum += value
+    } else {
+      this.__lat_up_n = this.__lat_up_sum = 0
+    }
+
+    if (this.__lat_down > 0) {
+      this.__lat_down_n ++
+      this.__lat_down_sum += value
+    } else {
+      this.__lat_down_n = this.__lat_down_sum = 0
+    }
+
+    if (this.__lat_up > this.__threshold) {
+      return this.__latencyChange('up', this.__lat_up_sum / this.__lat_up_n)
+    } else if (this.__lat_down > this.__threshold) {
+      return this.__latencyChange('down', this.__lat_down_sum / this.__lat_down_n)
+    }
+
+    // Only move the baseline while nothing suspicious is accumulating
+    if ((this.__lat_up === 0) && (this.__lat_down === 0)) {
+      this.__learnLatency(value, this.__alpha)
+    }
+  }
+
+  /** Feed the outcome of a probe (`true` if lost), returning any detected change */
+  loss(lost: boolean): PingerChange | undefined {
+    const x = lost ? 1 : 0
+    const n = ++ this.__loss_n
+
+    if (n <= this.__warmup) {
+      this.__loss_rate += (x - this.__loss_rate) * Math.max(this.__alpha, 1 / n)
+      return
+    }
+
+    // Log-likelihood ratios of our sample for doubled and halved loss rates
+    const p0 = Math.min(LOSS_MAX_RATE, Math.max(LOSS_MIN_RATE, this.__loss_rate))
+    const up = Math.min(LOSS_MAX_RATE, p0 * 2)
+    const down = p0 / 2
+
+    this.__loss_up = Math.max(0, this.__loss_up + (lost ? Math.log(up / p0) : Math.log((1 - up) / (1 - p0))))
+
+    // Halving an already negligible loss rate is not a change worth reporting
+    this.__loss_down = p0 < LOSS_MIN_DOWN_RATE ? 0 :
+      Math.max(0, this.__loss_down + (lost ? Math.log(down / p0) : Math.log((1 - down) / (1 - p0))))
+
+    if (this.__loss_up > 0) {
+      this.__loss_up_n ++
+      this.__loss_up_lost += x
+    } else {
+      this.__loss_up_n = this.__loss_up_lost = 0
+    }
+
+    if (this.__loss_down > 0) {
+      this.__loss_down_n ++
+      this.__loss_down_lost += x
+    } else {
+      this.__loss_down_n = this.__loss_down_lost = 0
+    }
+
+    if (this.__loss_up > this.__threshold) {
+      return this.__lossChange('up', this.__loss_up_lost / this.__loss_up_n)
+    } else if (this.__loss_down > this.__threshold) {
+      return this.__lossChange('down', this.__loss_down_lost / this.__loss_down_n)
+    }
+
+    if ((this.__loss_up === 0) && (this.__loss_down === 0)) {
+      this.__loss_rate += (x - this.__loss_rate) * this.__alpha
+    }
+  }
+
+  /** Save baselines, CUSUMs and counters (in a fixed order) */
+  save(): number[] {
+    return [
+      this.__lat_n, this.__lat_mean, this.__lat_var,
+      this.__lat_up, this.__lat_up_n, this.__lat_up_sum,
+      this.__lat_down, this.__lat_down_n, this.__lat_down_sum,
+      this.__loss_n, this.__loss_rate,
+      this.__loss_up, this.__loss_up_n, this.__loss_up_lost,
+      this.__loss_down, this.__loss_down_n, this.__loss_down_lost,
+    ]
+  }
+
+  /** Restore what was saved by another detector, skipping its warmup */
+  restore(values: number[]): void {
+    if (values.length !== 17) throw new Error(`Invalid detector state (length=${values.length})`)
+    ;[
+      this.__lat_n, this.__lat_mean, this.__lat_var,
+      this.__lat_up, this.__lat_up_n, this.__lat_up_sum,
+      this.__lat_down, this.__lat_down_n, this.__lat_down_sum,
+      this.__loss_n, this.__loss_rate,
+      this.__loss_up, this.__loss_up_n, this.__loss_up_lost,
+      this.__loss_down, this.__loss_down_n, this.__loss_down_lost,
+    ] = values
+  }
+
+  /* ======================================================================== */
+
+  private __learnLatency(value: number, alpha: number): void {
+    const delta = value - this.__lat_mean
+    this.__lat_mean += alpha * delta
+    this.__lat_var = (1 - alpha) * (this.__lat_var + alpha * delta * delta)
+  }
+
+  private __latencyChange(direction: 'up' | 'down', level: number): PingerChange {
+    const change: PingerChange = { metric: 'latency', direction, from: this.__lat_mean, to: level }
+
+    // Rebase: the variance scales with the new level, CUSUMs restart
+    const ratio = this.__lat_mean > 0 ? level / this.__lat_mean : 1
+    this.__lat_var *= ratio * ratio
+    this.__lat_mean = level
+    this.__lat_up = this.__lat_up_n = this.__lat_up_sum = 0
+    this.__lat_down = this.__lat_down_n = this.__lat_down_sum = 0
+
+    return change
+  }
+
+  private __lossChange(direction: 'up' | 'down', level: number): PingerChange {
+    const change: PingerChange = { metric: 'loss', direction, from: this.__loss_rate, to: level }
+
+    this.__loss_rate = level
+    this.__loss_up = this.__loss_up_n = this.__loss_up_lost = 0
+    this.__loss_down = this.__loss_down_n = this.__loss_down_lost = 0
+
+    return change
+  }
+}
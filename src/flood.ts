@@ -0,0 +1,95 @@
+/* ========================================================================== *
+ * WINDOWED FLOODS                                                            *
+ * ========================================================================== *
+ *                                                                            *
+ * Loads a target keeping exactly `window` probes in flight: a new probe is   *
+ * sent the moment one is answered or lost (like `ping -f`, but allowing more *
+ * than one probe at a time), for `duration` milliseconds.                    *
+ *                                                                            *
+ * There are no timers here: probes are sent as soon as the previous ones in  *
+ * the window settle (replies are received by the event loop in between), so  *
+ * the rate achieved is bounded by the round trip time and our window, and by *
+ * the cost of a probe: each one is a separate `probe()`, a promise and one   *
+ * `send()` system call. This is _not_ a line-rate packet generator (there is *
+ * no batched send), expect tens of thousands of probes per second at most.   *
+ *                                                                            *
+ * Lost probes hold a slot until they time out, so a short `timeout` for the  *
+ * `Pinger` is advisable when flooding lossy links.                           *
+ *                                                                            *
+ * The summary is the same as a burst's, plus the window and the rate.        *
+ *                                                                            *
+ * ========================================================================== */
+
+import { summarize } from './burst'
+import { ProbeError } from './probe'
+import { RollupAccumulator } from './rollup'
+
+import type { PingerBurst } from './burst'
+import type { PingerProbe } from './probe'
+
+/** The largest window (half the space of 16 bits sequence numbers) */
+const MAX_WINDOW = 32768
+
+/** The summary of a flood of probes */
+export interface PingerFlood extends PingerBurst {
+  /** The number of probes kept in flight */
+  window: number,
+  /** The rate achieved, in probes sent per second */
+  pps: number,
+}
+
+/** Validate the window and duration of a flood */
+export function checkFlood(window: number, duration: number): void {
+  if ((! Number.isInteger(window)) || (window < 1) || (window > MAX_WINDOW)) {
+    throw new Error(`Invalid flood window ${window} (must be an integer between 1 and ${MAX_WINDOW})`)
+  }
+  if ((! Number.isFinite(duration)) || (duration <= 0)) {
+    throw new Error(`Invalid flood duration ${duration} (must be a number > 0 ms)`)
+  }
+}
+
+/**
+ * Keep `window` probes in flight for `duration` milliseconds and summarize
+ * them. Errors other than lost probes stop the flood and reject it.
+ */
+export async function flood(
+    probe: () => Promise<PingerProbe>,
+    window: number,
+    duration: number,
+): Promise<PingerFlood> {
+  checkFlood(window, duration)
+
+  const accumulator = new RollupAccumulator()
+  let failure: Error | undefined = undefined
+  let overtaken = 0
+  let inflight = 0
+
+  const start = process.hrtime.bigint()
+  const end = start + BigInt(Math.round(duration * 1000000))
+
+  await new Promise<void>((resolve) => {
+    // Send one probe, and when it settles replace it (or wind down)
+    const send = (): void => {
+      inflight ++
+      accumulator.sent()
+      probe().then(({ rtt }) => {
+        accumulator.received(rtt)
+      }, (error) => {
+        if (! (error instanceof ProbeError)) return void (failure ||= error)
+        if (error.code === 'ERR_PROBE_OVERTAKEN') overtaken ++
+        accumulator.lost(1)
+      }).then(() => {
+        inflight --
+        if ((! failure) && (process.hrtime.bigint() < end)) send()
+        else if (inflight === 0) resolve()
+      })
+    }
+
+    for (let i = 0; i < window; i ++) send()
+  })
+
+  if (failure) throw failure
+  const elapsed = Number(process.hrtime.bigint() - start) / 1000000
+  const summary = summarize(accumulator, overtaken, elapsed)
+  return { ...summary, window, pps: summary.sent / elapsed * 1000 }
+}
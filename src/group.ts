@@ -0,0 +1,364 @@
+/* ========================================================================== *
+ * PINGER GROUPS                                                              *
+ * ========================================================================== *
+ *                                                                            *
+ * A group of pingers keyed by the address or host name they were added with, *
+ * sharing default options, their lifecycle (start, stop and close) and one   *
+ * rollup timer, so that all their rollups are emitted for the same windows.  *
+ *                                                                            *
+ * Events of all pingers are re-emitted by the group, prepended by the pinger *
+ * emitting them, and `reconcile()` applies a whole new set of targets (and   *
+ * their options) adding, removing, retuning or replacing pingers as needed.  *
+ *                                                                            *
+ * ========================================================================== */
+
+import { EventEmitter } from 'node:events'
+import { isIPv6 } from 'node:net'
+import { isDeepStrictEqual } from 'node:util'
+
+import { createPinger } from './pinger'
+import { checkWindow, RollupTimer } from './rollup'
+
+import type { PingerCapture } from './capture'
+import type { PingerChange } from './detector'
+import type { PingerLosses } from './loss'
+import type { PingerMemory } from './memory'
+import type { PingerOverhead } from './overhead'
+import type { Pinger, PingerImpl, PingerOptions, PingerStats } from './pinger'
+import type { PingerRollup } from './rollup'
+import type { PingerState } from './state'
+import type { PingerTrace, TraceEvent } from './trace'
+
+/** Options to create a {@link PingerGroup} instance */
+export interface PingerGroupOptions extends Omit<PingerOptions, 'rollup'> {
+  /** The window **in milliseconds** for emitting `rollup` events (default: none) */
+  rollup?: number,
+}
+
+/** The changes applied by {@link PingerGroup.reconcile} */
+export interface PingerReconciliation {
+  /** Targets added to the group */
+  added: string[],
+  /** Targets closed and removed from the group */
+  removed: string[],
+  /** Targets whose timeout or interval were changed in place */
+  retuned: string[],
+  /**
+   * Targets whose protocol, address or interface to ping from, or whose
+   * `identifier`, `detector`, `trace`, `capture`, `heatmap` or `hibernate`
+   * options changed
+   */
+  replaced: string[],
+}
+
+/**
+ * Create a new {@link PingerGroup}.
+ *
+ * @param options The default {@link PingerOptions} for all pingers in the
+ *                group, and (optionally) the group's rollup window.
+ */
+export function createPingerGroup(options: PingerGroupOptions = {}): PingerGroup {
+  const { rollup, ...defaults } = options
+  if (rollup !== undefined) checkWindow(rollup)
+  return new PingerGroupImpl(defaults, rollup)
+}
+
+/**
+ * A group of {@link Pinger}s, keyed by the address or host name they were
+ * added with, sharing default options, lifecycle and a single rollup timer.
+ *
+ * All events emitted by the pingers in the group are re-emitted by the group
+ * itself, prepended by the {@link Pinger} that originally emitted them.
+ */
+export interface PingerGroup {
+  /** The window **in milliseconds** for emitting `rollup` events, if any */
+  readonly rollup?: number | undefined
+  /** A flag indicating whether this group is _running_ */
+  readonly running: boolean
+  /** The number of pingers in this group */
+  readonly size: number
+
+  /** Add a new pinger to this group, or return the existing one */
+  add(to: string, options?: Omit<PingerOptions, 'rollup'>): Promise<Pinger>
+  /** Return the pinger added with the specified address or host name */
+  get(to: string): Pinger | undefined
+  /** Close and remove the pinger added with the specified address or host name */
+  remove(to: string): Promise<boolean>
+  /** Iterate over all address or host names and pingers in this group */
+  entries(): IterableIterator<[ string, Pinger ]>
+  /**
+   * Bring this group in line with the specified targets (address or host
+   * names, optionally mapped to their options) touching only what changed.
+   */
+  reconcile(targets: string[] | Record<string, Omit<PingerOptions, 'rollup'>>): Promise<PingerReconciliation>
+
+  start(): void
+  stop(): void
+  close(): Promise<void>
+  stats(): Record<string, PingerStats>
+  losses(): Record<string, PingerLosses>
+  overhead(): Record<string, PingerOverhead>
+  /** Return the memory used by all pingers in this group, keyed by `to` */
+  memory(): Record<string, PingerMemory>
+  /** Export the traces of all pingers in this group, one track per pinger */
+  trace(): PingerTrace
+  /** Export the heatmaps of all pingers keeping one, keyed by `to` */
+  heatmaps(): Record<string, Buffer>
+
+  on(event: 'error', handler: (pinger: Pinger, error: Error) => void): void
+  off(event: 'error', handler: (pinger: Pinger, error: Error) => void): void
+  once(event: 'error', handler: (pinger: Pinger, error: Error) => void): void
+
+  on(event: 'warning', handler: (pinger: Pinger, code: string, message: string) => void): void
+  off(event: 'warning', handler: (pinger: Pinger, code: string, message: string) => void): void
+  once(event: 'warning', handler: (pinger: Pinger, code: string, message: string) => void): void
+
+  on(event: 'pong', handler: (pinger: Pinger, latency: number) => void): void
+  off(event: 'pong', handler: (pinger: Pinger, latency: number) => void): void
+  once(event: 'pong', handler: (pinger: Pinger, latency: number) => void): void
+
+  on(event: 'change', handler: (pinger: Pinger, change: PingerChange) => void): void
+  off(event: 'change', handler: (pinger: Pinger, change: PingerChange) => void): void
+  once(event: 'change', handler: (pinger: Pinger, change: PingerChange) => void): void
+
+  on(event: 'rollup', handler: (pinger: Pinger, rollup: PingerRollup) => void): void
+  off(event: 'rollup', handler: (pinger: Pinger, rollup: PingerRollup) => void): void
+  once(event: 'rollup', handler: (pinger: Pinger, rollup: PingerRollup) => void): void
+
+  on(event: 'capture', handler: (pinger: Pinger, capture: PingerCapture) => void): void
+  off(event: 'capture', handler: (pinger: Pinger, capture: PingerCapture) => void): void
+  once(event: 'capture', handler: (pinger: Pinger, capture: PingerCapture) => void): void
+}
+
+/** The events forwarded from each pinger to its group */
+const EVENTS = [ 'error', 'warning', 'pong', 'change', 'capture' ] as const
+
+/** Options only applied when creating a pinger, changing them replaces it */
+const REPLACING = [ 'identifier', 'detector', 'trace', 'capture', 'heatmap', 'hibernate' ] as const
+
+export class PingerGroupImpl extends EventEmitter implements PingerGroup {
+  private readonly __pingers = new Map<string, PingerImpl>()
+  private readonly __options = new Map<string, Omit<PingerOptions, 'rollup'>>()
+  private readonly __rollup_timer?: RollupTimer
+  private __running: boolean = false
+
+  constructor(
+      private readonly __defaults: PingerOptions,
+      public readonly rollup: number | undefined,
+  ) {
+    super()
+
+    // A single timer produces the rollups for all pingers in the group
+    if (rollup) {
+      this.__rollup_timer = new RollupTimer(rollup, (start, end) => {
+        for (const pinger of this.__pingers.values()) {
+          this.emit('rollup', pinger, pinger.__rollup(start, end))
+        }
+      })
+    }
+  }
+
+  get running(): boolean {
+    return this.__running
+  }
+
+  get size(): number {
+    return this.__pingers.size
+  }
+
+  // wrap "emit" so that "error" events won't throw when no listeners are there
+  emit(eventName: 'error' | 'warning' | 'pong' | 'change' | 'rollup' | 'capture', ...args: any[]): boolean {
+    if (this.listenerCount(eventName) < 1) return false
+    return super.emit(eventName, ...args)
+  }
+
+  async add(to: string, options: Omit<PingerOptions, 'rollup'> = {}): Promise<Pinger> {
+    const existing = this.__pingers.get(to)
+    if (existing) return existing
+
+    // Rollups are always produced by the group, never by the pinger itself
+    const pinger = await createPinger(to, { ...this.__defaults, ...options, rollup: undefined }) as PingerImpl
+
+    // Someone else might have added the same pinger while we were resolving
+    const raced = this.__pingers.get(to)
+    if (raced) {
+      await pinger.close()
+      return raced
+    }
+
+    this.__adopt(to, pinger, options)
+    return pinger
+  }
+
+  /**
+   * Add a pinger created elsewhere to this group, forwarding its events and
+   * remembering the options (over the group's defaults) it was created with
+   */
+  __adopt(to: string, pinger: PingerImpl, options: Omit<PingerOptions, 'rollup'> = {}): void {
+    for (const event of EVENTS) {
+      pinger.on(event as any, (...args: any[]) => this.emit(event, pinger, ...args))
+    }
+
+    this.__pingers.set(to, pinger)
+    this.__options.set(to, options)
+    if (this.__running) pinger.start()
+  }
+
+  /** The options (over the group's defaults) only applied when creating a pinger */
+  __creation(to: string): NonNullable<PingerState['options']> {
+    const options: Omit<PingerOptions, 'rollup'> = { ...this.__defaults, ...this.__options.get(to) }
+    return Object.fromEntries(REPLACING.map((key) => [ key, options[key] ]))
+  }
+
+  get(to: string): Pinger | undefined {
+    return this.__pingers.get(to)
+  }
+
+  async remove(to: string): Promise<boolean> {
+    const pinger = this.__pingers.get(to)
+    if (! pinger) return false
+
+    this.__pingers.delete(to)
+    this.__options.delete(to)
+    await pinger.close()
+    return true
+  }
+
+  entries(): IterableIterator<[ string, Pinger ]> {
+    return this.__pingers.entries()
+  }
+
+  async reconcile(
+      targets: string[] | Record<string, Omit<PingerOptions, 'rollup'>>,
+  ): Promise<PingerReconciliation> {
+    const wanted = new Map<string, Omit<PingerOptions, 'rollup'>>(Array.isArray(targets) ?
+      targets.map((to) => [ to, {} ]) :
+      Object.entries(targets))
+
+    const result: PingerReconciliation = { added: [], removed: [], retuned: [], replaced: [] }
+    const changes: Promise<unknown>[] = []
+
+    for (const to of this.__pingers.keys()) {
+      if (wanted.has(to)) continue
+      result.removed.push(to)
+      changes.push(this.remove(to))
+    }
+
+    for (const [ to, options ] of wanted) {
+      const pinger = this.__pingers.get(to)
+      if (! pinger) {
+        result.added.push(to)
+        changes.push(this.add(to, options))
+        continue
+      }
+
+      // Compare with what "createPinger" would use given the same options
+      const merged = { ...this.__defaults, ...options }
+      const {
+        protocol = isIPv6(to) ? 'ipv6' : 'ipv4',
+        timeout = 30000,
+        interval = 1000,
+        from,
+        source,
+      } = merged
+
+      // Options only read when creating the pinger are compared with its own
+      const created = { ...this.__defaults, ...this.__options.get(to) }
+      const changed = REPLACING.some((key) => ! isDeepStrictEqual(merged[key], created[key]))
+
+      if (changed || (protocol !== pinger.protocol) || (from !== pinger.from) || (source !== pinger.source)) {
+        result.replaced.push(to)
+        changes.push(this.__replace(to, pinger, options))
+      } else if ((timeout !== pinger.timeout) || (interval !== pinger.interval)) {
+        result.retuned.push(to)
+        pinger.__retune(timeout, interval)
+      }
+    }
+
+    // All changes are applied, even if some fail, before reporting the first failure
+    for (const settled of await Promise.allSettled(changes)) {
+      if (settled.status === 'rejected') throw settled.reason
+    }
+    return result
+  }
+
+  /** Replace a pinger with a new one, keeping its sequence and stats if possible */
+  private async __replace(to: string, pinger: PingerImpl, options: Omit<PingerOptions, 'rollup'>): Promise<void> {
+    const replacement = await createPinger(to, { ...this.__defaults, ...options, rollup: undefined }) as PingerImpl
+
+    // Someone else might have removed or replaced the pinger in the meantime
+    if (this.__pingers.get(to) !== pinger) {
+      await replacement.close()
+      return
+    }
+
+    // Replies to requests in flight won't reach the new socket
+    if (replacement.protocol === pinger.protocol) {
+      const state = pinger.__save(to)
+      replacement.__restore({ ...state, handler: { ...state.handler, inflight: [] } })
+    }
+
+    this.__adopt(to, replacement, options)
+    await pinger.close()
+  }
+
+  start(): void {
+    this.__running = true
+    for (const pinger of this.__pingers.values()) pinger.start()
+    this.__rollup_timer?.start()
+  }
+
+  stop(): void {
+    this.__running = false
+    for (const pinger of this.__pingers.values()) pinger.stop()
+    this.__rollup_timer?.stop()
+  }
+
+  async close(): Promise<void> {
+    this.stop()
+    const pingers = [ ...this.__pingers.values() ]
+    this.__pingers.clear()
+    this.__options.clear()
+    await Promise.all(pingers.map((pinger) => pinger.close()))
+  }
+
+  stats(): Record<string, PingerStats> {
+    const stats: Record<string, PingerStats> = {}
+    for (const [ to, pinger ] of this.__pingers) stats[to] = pinger.stats()
+    return stats
+  }
+
+  losses(): Record<string, PingerLosses> {
+    const losses: Record<string, PingerLosses> = {}
+    for (const [ to, pinger ] of this.__pingers) losses[to] = pinger.losses()
+    return losses
+  }
+
+  overhead(): Record<string, PingerOverhead> {
+    const overhead: Record<string, PingerOverhead> = {}
+    for (const [ to, pinger ] of this.__pingers) overhead[to] = pinger.overhead()
+    return overhead
+  }
+
+  memory(): Record<string, PingerMemory> {
+    const memory: Record<string, PingerMemory> = {}
+    for (const [ to, pinger ] of this.__pingers) memory[to] = pinger.memory()
+    return memory
+  }
+
+  heatmaps(): Record<string, Buffer> {
+    const heatmaps: Record<string, Buffer> = {}
+    for (const [ to, pinger ] of this.__pingers) {
+      const heatmap = pinger.heatmap()
+      if (heatmap) heatmaps[to] = heatmap
+    }
+    return heatmaps
+  }
+
+  trace(): PingerTrace {
+    const traceEvents: TraceEvent[] = []
+    let tid = 0
+    for (const pinger of this.__pingers.values()) traceEvents.push(...pinger.__trace(++ tid))
+    return { traceEvents, displayTimeUnit: 'ms' }
+  }
+}
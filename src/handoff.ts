@@ -0,0 +1,128 @@
+/* ========================================================================== *
+ * SOCKET HANDOFF                                                             *
+ * ========================================================================== *
+ *                                                                            *
+ * Hands off all sockets of a group to another process (e.g. a new version of *
+ * the same collector being started) over a UNIX socket, without closing them *
+ * and together with their state: correlation data, sequence numbers, all the *
+ * requests still in flight and the accumulated statistics.                   *
+ *                                                                            *
+ * The receiving process listens on the UNIX socket _first_, then the sending *
+ * process connects to it, stops its pingers, saves their state and sends it  *
+ * along with their sockets, closing its own copies straight away. Replies    *
+ * arriving in between are simply queued by the kernel on the very same       *
+ * sockets, and matched by the receiving process.                             *
+ *                                                                            *
+ * As `process.hrtime()` is based on the system's monotonic clock, times of   *
+ * requests in flight are valid across processes on the same host.            *
+ *                                                                            *
+ * ========================================================================== */
+
+import { closeSync } from 'node:fs'
+
+import native from '../native/ping.cjs'
+import { createPingerGroup } from './group'
+import { adoptPinger } from './pinger'
+import { decodeStates, encodeStates } from './state'
+
+import type { PingerGroup, PingerGroupImpl, PingerGroupOptions } from './group'
+import type { PingerImpl } from './pinger'
+
+/** Whether our native binary can hand off sockets (older builds can't) */
+function supported(): boolean {
+  return (typeof native.handoff_send === 'function') && (typeof native.handoff_receive === 'function')
+}
+
+/**
+ * Hand off all the (open) pingers in a group to the process listening on the
+ * UNIX socket at the specified path (see {@link receiveHandoff}).
+ *
+ * If nobody is listening, this fails _before_ touching the group, otherwise
+ * the group is closed immediately, and the promise is resolved when the other
+ * process acknowledged it received everything.
+ *
+ * @param path The path of the UNIX socket to connect to.
+ * @param group The group whose pingers should be handed off.
+ * @param timeout The timeout **in milliseconds** for sending (default: 10000).
+ */
+export function handoff(path: string, group: PingerGroup, timeout: number = 10000): Promise<void> {
+  return new Promise((resolve, reject) => {
+    if (! supported()) return reject(new Error('Socket handoff is not supported by this native binary'))
+
+    const running = group.running
+    group.stop()
+
+    // Save the state of all our open pingers, referencing sockets by index
+    const pingers = [ ...group.entries() ].filter(([ , pinger ]) => ! pinger.closed) as [ string, PingerImpl ][]
+    const fds: number[] = []
+    const states = pingers.map(([ to, pinger ]) => {
+      const state = { ...pinger.__save(to), options: (group as PingerGroupImpl).__creation(to) }
+      if (state.fd < 0) return state // lazy, and never opened
+      fds.push(state.fd)
+      return { ...state, fd: fds.length - 1 }
+    })
+
+    try {
+      native.handoff_send(path, fds, encodeStates(states), timeout, (error: Error | null) => {
+        if (! error) return resolve()
+        Error.captureStackTrace(error)
+        reject(error)
+      })
+    } catch (error) {
+      // Nothing was handed off, so simply keep going
+      if (running) group.start()
+      return reject(error)
+    }
+
+    // Our sockets were duplicated, close ours so that we stop receiving
+    void group.close()
+  })
+}
+
+/**
+ * Listen on a UNIX socket at the specified path, and create a new group
+ * adopting all the pingers (and their state) handed off by another process
+ * (see {@link handoff}).
+ *
+ * The returned group is _not_ started.
+ *
+ * @param path The path of the UNIX socket to listen on (must not exist).
+ * @param options The options for the new group (and its pingers' defaults)
+ * @param timeout The timeout **in milliseconds** for receiving (default: 10000).
+ */
+export function receiveHandoff(
+    path: string,
+    options: PingerGroupOptions = {},
+    timeout: number = 10000,
+): Promise<PingerGroup> {
+  return new Promise((resolve, reject) => {
+    if (! supported()) return reject(new Error('Socket handoff is not supported by this native binary'))
+
+    const group = createPingerGroup(options) as PingerGroupImpl
+
+    native.handoff_receive(path, timeout, (error: Error | null, fds?: number[], data?: Buffer) => {
+      if (error) {
+        Error.captureStackTrace(error)
+        return reject(error)
+      }
+
+      const adopted = new Set<number>()
+      try {
+        for (const state of decodeStates(data!)) {
+          // Lazy pingers never opened have no socket, and stay lazy
+          const fd = state.fd < 0 ? undefined : fds![state.fd]
+          if ((state.fd >= 0) && (fd === undefined)) throw new Error(`Invalid file descriptor index ${state.fd} for "${state.to}"`)
+          // Pingers keep the options they were created with (older senders don't save them)
+          const created = state.options || {}
+          group.__adopt(state.to, adoptPinger(state, fd, { ...options, ...created, rollup: undefined }), created)
+          if (fd !== undefined) adopted.add(fd)
+        }
+        resolve(group)
+      } catch (error) {
+        // Close whatever was not adopted, and the group (closing the rest)
+        for (const fd of fds!) if (! adopted.has(fd)) closeSync(fd)
+        group.close().then(() => reject(error), () => reject(error))
+      }
+    })
+  })
+}
@@ -0,0 +1,190 @@
+/* ========================================================================== *
+ * LATENCY HEATMAP                                                            *
+ * ========================================================================== *
+ *                                                                            *
+ * A fixed-size matrix of counts: one row per time slot (the last `slots`     *
+ * slots of `slot` milliseconds each, in a ring) and one column per latency   *
+ * bucket (logarithmic, `resolution` buckets per octave, like the histogram). *
+ * Packets lost are counted per slot in an extra column.                      *
+ *                                                                            *
+ * Recording is O(1): rows are only cleared when time moves into a new slot.  *
+ *                                                                            *
+ * The matrix is exported sparsely (only non-zero cells), so that dashboards  *
+ * can render heatmaps without any raw sample leaving the host:               *
+ *                                                                            *
+ * - magic ("JPHM", u32), version (u8), resolution (u8), buckets (u8),        *
+ *   slots (u16), slot width (u32, ms), minimum latency (f64, ms) and start   *
+ *   of the oldest slot (f64, ms since the epoch);                            *
+ * - for each slot, oldest first: lost (u32), the number of non-zero cells    *
+ *   (u8), and for each cell its bucket (u8) and count (u32).                 *
+ *                                                                            *
+ * ========================================================================== */
+
+import { wallClock } from './capture'
+import { StateReader, StateWriter } from './state'
+
+/** The lower bound of the first bucket (10 µs) */
+const MIN_VALUE = 0.01
+/** The number of octaves tracked above `MIN_VALUE` (up to ~ 42 sec) */
+const OCTAVES = 22
+/** Our magic number: "JPHM" */
+const MAGIC = 0x4a50484d
+/** The version of our export format */
+const VERSION = 1
+
+/** Options for keeping a latency heatmap */
+export interface HeatmapOptions {
+  /** The width **in milliseconds** of each time slot (default: 60000 - 1 min) */
+  slot?: number,
+  /** The number of time slots kept (default: 60) */
+  slots?: number,
+  /** The number of latency buckets per octave: 1, 2, 4 or 8 (default: 2) */
+  resolution?: number,
+}
+
+/** A heatmap decoded by {@link decodeHeatmap} */
+export interface PingerHeatmap {
+  /** The start of the oldest slot (milliseconds since the epoch) */
+  start: number,
+  /** The width **in milliseconds** of each time slot */
+  slot: number,
+  /** The lower bounds (in milliseconds) of all latency buckets */
+  buckets: number[],
+  /** The counts of latencies, per slot (oldest first) and bucket */
+  counts: number[][],
+  /** The number of packets lost, per slot (oldest first) */
+  lost: number[],
+}
+
+export class Heatmap {
+  private readonly __slot: number
+  private readonly __slots: number
+  private readonly __resolution: number
+  private readonly __buckets: number
+  private readonly __counts: Uint32Array
+  private readonly __lost: Uint32Array
+  /** The (absolute) number of the newest slot, or -1 */
+  private __head: number = -1
+
+  constructor(options: HeatmapOptions = {}) {
+    const { slot = 60000, slots = 60, resolution = 2 } = options
+    if (!(Number.isInteger(slot) && slot >= 1)) throw new Error(`Invalid heatmap slot ${slot}`)
+    if (!(Number.isInteger(slots) && slots >= 1 && slots <= 0xffff)) throw new Error(`Invalid heatmap slots ${slots}`)
+    if (! [ 1, 2, 4, 8 ].includes(resolution)) throw new Error(`Invalid heatmap resolution ${resolution}`)
+
+    this.__slot = slot
+    this.__slots = slots
+    this.__resolution = resolution
+    this.__buckets = OCTAVES * resolution
+    this.__counts = new Uint32Array(slots * this.__buckets)
+    this.__lost = new Uint32Array(slots)
+  }
+
+  /** The number of bytes used by this heatmap's matrix */
+  get bytes(): number {
+    return this.__counts.byteLength + this.__lost.byteLength
+  }
+
+  /** Record a latency (in milliseconds) received at `time` */
+  record(value: number, time: number = wallClock()): void {
+    const row = this.__row(time)
+    if (row < 0) return
+
+    const column = (value > MIN_VALUE) ?
+      Math.min(Math.floor(Math.log2(value / MIN_VALUE) * this.__resolution), this.__buckets - 1) :
+      0
+    this.__counts[row * this.__buckets + column] ++
+  }
+
+  /** Record a number of packets lost at `time` */
+  lost(count: number, time: number = wallClock()): void {
+    const row = this.__row(time)
+    if (row >= 0) this.__lost[row] += count
+  }
+
+  /** Export all slots up to the one of `time` (see above for the format) */
+  export(time: number = wallClock()): Buffer {
+    this.__row(time)
+
+    const writer = new StateWriter()
+      .u32(MAGIC)
+      .u8(VERSION)
+      .u8(this.__resolution)
+      .u8(this.__buckets)
+      .u16(this.__slots)
+      .u32(this.__slot)
+      .f64(MIN_VALUE)
+      .f64((this.__head - this.__slots + 1) * this.__slot)
+
+    for (let slot = this.__head - this.__slots + 1; slot <= this.__head; slot ++) {
+      const row = slot < 0 ? -1 : slot % this.__slots
+      writer.u32(row < 0 ? 0 : this.__lost[row]!)
+
+      const offset = row * this.__buckets
+      let cells = 0
+      if (row >= 0) for (let i = 0; i < this.__buckets; i ++) if (this.__counts[offset + i]) cells ++
+      writer.u8(cells)
+      if (cells) {
+        for (let i = 0; i < this.__buckets; i ++) {
+          const count = this.__counts[offset + i]!
+          if (count) writer.u8(i).u32(count)
+        }
+      }
+    }
+
+    return writer.finish()
+  }
+
+  /**
+   * Return the row for `time`, clearing rows when moving into newer slots, or
+   * -1 if `time` is older than our oldest slot.
+   */
+  private __row(time: number): number {
+    const slot = Math.floor(time / this.__slot)
+
+    if (slot > this.__head) {
+      // Clear the rows between our newest slot and this one (at most all)
+      const clear = this.__head < 0 ? this.__slots : Math.min(slot - this.__head, this.__slots)
+      for (let i = 0; i < clear; i ++) {
+        const row = (slot - i) % this.__slots
+        this.__counts.fill(0, row * this.__buckets, (row + 1) * this.__buckets)
+        this.__lost[row] = 0
+      }
+      this.__head = slot
+    } else if (slot <= (this.__head - this.__slots)) {
+      return -1
+    }
+
+    return slot % this.__slots
+  }
+}
+
+/** Decode a heatmap exported by a pinger */
+export function decodeHeatmap(buffer: Buffer): PingerHeatmap {
+  const reader = new StateReader(buffer)
+  if ((reader.u32() !== MAGIC) || (reader.u8() !== VERSION)) throw new Error('Invalid heatmap')
+
+  const resolution = reader.u8()
+  const size = reader.u8()
+  const slots = reader.u16()
+  const slot = reader.u32()
+  const min = reader.f64()
+  const start = reader.f64()
+
+  const buckets: number[] = []
+  for (let i = 0; i < size; i ++) buckets.push(min * Math.pow(2, i / resolution))
+
+  const counts: number[][] = []
+  const lost: number[] = []
+  for (let i = 0; i < slots; i ++) {
+    lost.push(reader.u32())
+    const row = new Array<number>(size).fill(0)
+    for (let cells = reader.u8(); cells > 0; cells --) {
+      const bucket = reader.u8()
+      row[bucket] = reader.u32()
+    }
+    counts.push(row)
+  }
+
+  return { start, slot, buckets, counts, lost }
+}
@@ -0,0 +1,132 @@
+/* ========================================================================== *
+ * LATENCY HISTOGRAM                                                          *
+ * ========================================================================== *
+ *                                                                            *
+ * A fixed-size, logarithmic histogram for latencies in milliseconds.         *
+ *                                                                            *
+ * The range above `MIN_VALUE` is split in `OCTAVES` powers of two, and each  *
+ * octave is split into `resolution` logarithmic sub-buckets. Percentiles are *
+ * reported as the geometric midpoint of their bucket, so their relative      *
+ * error is at most `2^(1 / (2 * resolution)) - 1` (~ 2% by default).         *
+ *                                                                            *
+ * Values below `MIN_VALUE` (1 µs) fall in the first bucket, values above     *
+ * the last octave (~ 67 sec, way above any sensible timeout) in the last.    *
+ *                                                                            *
+ * ========================================================================== */
+
+/** The minimum value tracked by the histogram (1 µs) */
+const MIN_VALUE = 0.001
+/** The number of octaves tracked above `MIN_VALUE` (up to ~ 67 sec) */
+const OCTAVES = 26
+/** The default resolution: 16 sub-buckets per octave */
+const DEFAULT_RESOLUTION = 16
+
+/** The state of a {@link Histogram}, to be saved and restored */
+export interface HistogramState {
+  resolution: number,
+  buckets: Uint32Array,
+}
+
+export class Histogram {
+  private __resolution: number
+  private __buckets: Uint32Array
+  private __count: number = 0
+
+  constructor(resolution: number = DEFAULT_RESOLUTION) {
+    if ((resolution < 1) || (resolution & (resolution - 1))) {
+      throw new Error(`Histogram resolution must be a power of two (resolution=${resolution})`)
+    }
+
+    this.__resolution = resolution
+    this.__buckets = new Uint32Array(OCTAVES * resolution)
+  }
+
+  /** The number of sub-buckets per octave */
+  get resolution(): number {
+    return this.__resolution
+  }
+
+  /** The total number of values recorded */
+  get count(): number {
+    return this.__count
+  }
+
+  /** The number of bytes used by this histogram's buckets */
+  get bytes(): number {
+    return this.__buckets.byteLength
+  }
+
+  /** Record a value (in milliseconds) */
+  record(value: number): void {
+    this.__buckets[this.__index(value)] ++
+    this.__count ++
+  }
+
+  /** Return the value at the given percentile (0...100) or `NaN` if empty */
+  percentile(percentile: number): number {
+    if (this.__count < 1) return NaN
+
+    const rank = Math.max(1, Math.ceil((percentile / 100) * this.__count))
+    let seen = 0
+    for (let i = 0; i < this.__buckets.length; i ++) {
+      seen += this.__buckets[i]!
+      if (seen >= rank) return this.__value(i)
+    }
+
+    /* coverage ignore next */
+    return this.__value(this.__buckets.length - 1)
+  }
+
+  /** Forget all recorded values */
+  reset(): void {
+    this.__buckets.fill(0)
+    this.__count = 0
+  }
+
+  /** Save the resolution and (a copy of) the buckets of this histogram */
+  save(): HistogramState {
+    return { resolution: this.__resolution, buckets: this.__buckets.slice() }
+  }
+
+  /** Restore what was saved by another histogram (resolution included) */
+  restore(state: HistogramState): void {
+    const { resolution, buckets } = state
+    if ((resolution < 1) || (resolution & (resolution - 1)) || (buckets.length !== OCTAVES * resolution)) {
+      throw new Error(`Invalid histogram state (resolution=${resolution}, buckets=${buckets.length})`)
+    }
+
+    this.__buckets = buckets.slice()
+    this.__resolution = resolution
+    this.__count = buckets.reduce((count, value) => count + value, 0)
+  }
+
+  /**
+   * Halve the resolution of this histogram (merging adjacent sub-buckets),
+   * halving the memory used. Returns `false` if already at the minimum.
+   */
+  coarsen(): boolean {
+    if (this.__resolution < 2) return false
+
+    const buckets = new Uint32Array(this.__buckets.length / 2)
+    for (let i = 0; i < buckets.length; i ++) {
+      buckets[i] = this.__buckets[i * 2]! + this.__buckets[i * 2 + 1]!
+    }
+
+    this.__buckets = buckets
+    this.__resolution /= 2
+    return true
+  }
+
+  /** Return the bucket index for the given value */
+  private __index(value: number): number {
+    if (!(value > MIN_VALUE)) return 0
+
+    const position = Math.log2(value / MIN_VALUE) * this.__resolution
+    return Math.min(Math.floor(position), this.__buckets.length - 1)
+  }
+
+  /** Return the representative value (geometric midpoint) of a bucket */
+  private __value(index: number): number {
+    return MIN_VALUE * Math.pow(2, (index + 0.5) / this.__resolution)
+  }
+}
@@ -0,0 +1,189 @@
+/* ========================================================================== *
+ * IN-FLIGHT TABLE                                                            *
+ * ========================================================================== *
+ *                                                                            *
+ * Keeps track of ECHO Requests sent out and not (yet) answered, indexed by   *
+ * their full (32 bits) sequence number.                                      *
+ *                                                                            *
+ * Sequences are allocated monotonically, so we can store them in a ring      *
+ * buffer (power of two, grown on demand) spanning from the oldest sequence   *
+ * still in flight (the "head") to the last one sent out (the "tail").        *
+ *                                                                            *
+ * As send times are _also_ monotonic, expiring timed out requests is simply  *
+ * a matter of walking the ring from its head until we find a request that    *
+ * is still within its deadline.                                              *
+ *                                                                            *
+ * When memory is tight, the number of requests in flight can be capped: the  *
+ * oldest ones beyond the cap are expired early, and the ring shrinks back.   *
+ *                                                                            *
+ * ========================================================================== */
+
+/** The initial capacity of our ring buffer, must be a power of two */
+const INITIAL_CAPACITY = 32
+
+export class InFlight {
+  private __seqs: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __times: BigInt64Array = new BigInt64Array(INITIAL_CAPACITY)
+  private __mask: number = INITIAL_CAPACITY - 1
+  private __head: number = 0
+  private __tail: number = 0
+  private __size: number = 0
+  private __limit: number = Infinity
+
+  /** The number of requests currently in flight */
+  get size(): number {
+    return this.__size
+  }
+
+  /** The number of bytes used by this table's ring */
+  get bytes(): number {
+    return this.__seqs.byteLength + this.__times.byteLength
+  }
+
+  /** The maximum number of requests kept in flight by `expire()` */
+  get limit(): number {
+    return this.__limit
+  }
+
+  /** Cap the number of requests in flight, enforced by the next `expire()` */
+  cap(limit: number): void {
+    this.__limit = Math.max(limit, 1)
+  }
+
+  /**
+   * Halve our cap (or the number of requests in flight, if lower) but never
+   * below what a ring of initial capacity holds (leaving room for one more),
+   * as capping a table that small saves no memory at all. Returns `false`
+   * when there was nothing to cap.
+   */
+  halve(): boolean {
+    const minimum = INITIAL_CAPACITY - 1
+    if (this.__size <= minimum) return false
+    const limit = Math.max(Math.floor(Math.min(this.__limit, this.__size) / 2), minimum)
+    if (limit >= this.__limit) return false
+    this.__limit = limit
+    return true
+  }
+
+  /** Record a request with the specified sequence sent at the given time */
+  add(sequence: number, time: bigint): void {
+    // First request ever (or ring drained), restart from here, otherwise
+    // extend the head or tail (sequences compared with wraparound)
+    let head = this.__head
+    let tail = this.__tail
+    if (this.__size === 0) {
+      head = tail = sequence
+    } else if (((sequence - head) | 0) < 0) {
+      head = sequence
+    } else if (((sequence - tail) | 0) > 0) {
+      tail = sequence
+    }
+
+    // Make sure the ring can hold everything from the head to the tail
+    const span = ((tail - head) >>> 0) + 1
+    if (span > this.__seqs.length) this.__resize(span)
+
+    const slot = sequence & this.__mask
+    if (this.__times[slot] === 0n) this.__size ++
+    this.__seqs[slot] = sequence
+    this.__times[slot] = time || 1n // zero is our "free slot" marker
+
+    this.__head = head
+    this.__tail = tail
+  }
+
+  /**
+   * Remove the request with the specified sequence, returning its send time,
+   * or `undefined` if the request was not in flight (expired or duplicate).
+   */
+  remove(sequence: number): bigint | undefined {
+    const slot = sequence & this.__mask
+    const time = this.__times[slot]
+    if ((time === 0n) || (this.__seqs[slot] !== sequence)) return undefined
+
+    this.__times[slot] = 0n
+    this.__size --
+    this.__advance()
+    return time
+  }
+
+  /** Drop all requests with sequences _before_ the specified one, returning their count */
+  drop(sequence: number): number {
+    let dropped = 0
+    while ((this.__size > 0) && (((this.__head - sequence) | 0) < 0)) {
+      this.__times[this.__head & this.__mask] = 0n
+      this.__size --
+      dropped ++
+      this.__advance()
+    }
+    return dropped
+  }
+
+  /**
+   * Expire all requests sent _before_ the deadline (and the oldest ones over
+   * our limit, if capped) returning their count.
+   */
+  expire(deadline: bigint): number {
+    let expired = 0
+    while (this.__size > 0) {
+      const slot = this.__head & this.__mask
+      const time = this.__times[slot]
+      if ((time > deadline) && (this.__size <= this.__limit)) break
+
+      this.__times[slot] = 0n
+      this.__size --
+      expired ++
+      this.__advance()
+    }
+
+    // When capped, give back whatever the ring doesn't need anymore
+    if (this.__limit < this.__seqs.length) {
+      const span = this.__size ? ((this.__tail - this.__head) >>> 0) + 1 : 1
+      if (Math.max(span, this.__limit + 1, INITIAL_CAPACITY) <= (this.__seqs.length / 2)) {
+        this.__resize(Math.max(span, this.__limit + 1, INITIAL_CAPACITY))
+      }
+    }
+
+    return expired
+  }
+
+  /** Return all requests in flight as `[ sequence, time ]`, oldest first */
+  entries(): [ number, bigint ][] {
+    const entries: [ number, bigint ][] = []
+    for (let sequence = this.__head, left = this.__size; left > 0; sequence = (sequence + 1) >>> 0) {
+      const slot = sequence & this.__mask
+      if ((this.__times[slot] === 0n) || (this.__seqs[slot] !== sequence)) continue
+      entries.push([ sequence, this.__times[slot]! ])
+      left --
+    }
+    return entries
+  }
+
+  /** Move the head forward, skipping over answered requests */
+  private __advance(): void {
+    while ((this.__size > 0) && (this.__times[this.__head & this.__mask] === 0n)) {
+      this.__head = (this.__head + 1) >>> 0
+    }
+  }
+
+  /** Resize the ring to the smallest power of two holding the specified span */
+  private __resize(span: number): void {
+    let capacity = INITIAL_CAPACITY
+    while (capacity < span) capacity *= 2
+
+    const seqs = new Uint32Array(capacity)
+    const times = new BigInt64Array(capacity)
+    const mask = capacity - 1
+
+    for (let i = 0; i < this.__seqs.length; i ++) {
+      if (this.__times[i] === 0n) continue
+      const slot = this.__seqs[i] & mask
+      seqs[slot] = this.__seqs[i]
+      times[slot] = this.__times[i]
+    }
+
+    this.__seqs = seqs
+    this.__times = times
+    this.__mask = mask
+  }
+}
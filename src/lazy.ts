@@ -0,0 +1,93 @@
+/* ========================================================================== *
+ * LAZY OPENS                                                                 *
+ * ========================================================================== *
+ *                                                                            *
+ * Lazy pingers only open their socket when first started (or pinged), so     *
+ * that large configurations with many standby targets are created quickly    *
+ * and hold no file descriptor until actually used.                           *
+ *                                                                            *
+ * Opens requested in the same tick (e.g. when starting a whole group) are    *
+ * queued and issued together on the next one, with at most 64 of them in     *
+ * progress at any time (`OPEN_CONCURRENCY`), so that thousands of opens      *
+ * never monopolize the thread pool where they run (and where file system     *
+ * calls run as well).                                                        *
+ *                                                                            *
+ * ========================================================================== */
+
+import native from '../native/ping.cjs'
+
+/** Open a socket, calling back with its file descriptor and bound identifier */
+export type PingerOpener = (callback: (error: Error | null, fd?: number, bound?: number) => void) => void
+
+/** The largest number of opens in progress at the same time */
+export const OPEN_CONCURRENCY = 64
+
+/** Opens waiting to be issued (from `head` onwards) */
+let queue: (() => void)[] = []
+let head = 0
+/** The number of opens in progress */
+let running = 0
+/** Whether the queue will be drained on the next tick */
+let scheduled = false
+
+/**
+ * Call our native `open`, omitting the identifier when there's none to bind
+ * to, so that binaries built before `open` accepted one keep working.
+ */
+export function openSocket(
+    family: number,
+    from: string | undefined,
+    source: string | undefined,
+    identifier: number | undefined,
+    callback: (error: Error | null, fd?: number, bound?: number) => void,
+): void {
+  if (! identifier) return native.open(family as any, from, source, callback)
+  if (native.identifiers !== true) {
+    return process.nextTick(callback, new Error('Binding to an ICMP identifier is not supported by this native binary'))
+  }
+  native.open(family as any, from, source, identifier, callback)
+}
+
+/** Issue as many queued opens as our concurrency allows */
+function drain(): void {
+  while ((running < OPEN_CONCURRENCY) && (head < queue.length)) {
+    const open = queue[head]!
+    queue[head ++] = undefined as any
+    running ++
+    open()
+  }
+
+  // Forget all the opens issued so far, once the whole queue was issued
+  if (head >= queue.length) {
+    queue = []
+    head = 0
+  }
+}
+
+/** The number of lazy opens queued or in progress */
+export function pendingOpens(): number {
+  return queue.length - head + running
+}
+
+/** Create an opener for a socket, queueing its `open` with all others */
+export function lazyOpener(
+    family: number,
+    from: string | undefined,
+    source: string | undefined,
+    identifier: number | undefined,
+): PingerOpener {
+  return (callback) => {
+    queue.push(() => openSocket(family, from, source, identifier, (error, fd, bound) => {
+      running --
+      drain()
+      callback(error, fd, bound)
+    }))
+
+    if (scheduled) return
+    scheduled = true
+    setImmediate(() => {
+      scheduled = false
+      drain()
+    })
+  }
+}
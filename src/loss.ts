@@ -0,0 +1,147 @@
+/* ========================================================================== *
+ * LOSS PATTERNS                                                              *
+ * ========================================================================== *
+ *                                                                            *
+ * Tracks the _runs_ of lost packets (bursts) and received packets (gaps      *
+ * between bursts) of a target, in sequence order, and estimates the          *
+ * transition probabilities of a two-state Gilbert-Elliott model:             *
+ *                                                                            *
+ *                         p                                                  *
+ *                  +-------------+                                           *
+ *                  |             v                                           *
+ *               +------+      +-----+                                        *
+ *        1 - p  | GOOD |      | BAD |  1 - r                                 *
+ *               +------+      +-----+                                        *
+ *                  ^             |                                           *
+ *                  +-------------+                                           *
+ *                         r                                                  *
+ *                                                                            *
+ * As we can only observe packets (not states) we use the simple Gilbert      *
+ * estimator, where every lost packet is in the BAD state and every received  *
+ * one in the GOOD state: `p = #(GOOD->BAD) / #(GOOD->*)` and similarly for   *
+ * `r`. The mean burst length is then `1 / r` and the loss rate `p / (p + r)` *
+ *                                                                            *
+ * Runs are bucketed in fixed histograms, so updates are O(1) per result (or  *
+ * per burst of consecutive losses) and memory is constant.                   *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Upper bounds (inclusive) of the buckets for burst and gap lengths */
+export const RUN_BUCKETS: readonly number[] = Object.freeze([
+  1, 2, 3, 4, 5, 6, 7, 8, 16, 32, 64, 128, 256, Infinity,
+])
+
+/** Loss pattern statistics for a target */
+export interface PingerLosses {
+  /** Counts of completed bursts (lost runs), bucketed by {@link RUN_BUCKETS} */
+  bursts: number[],
+  /** Counts of completed gaps (received runs), bucketed by {@link RUN_BUCKETS} */
+  gaps: number[],
+  /** The probability of moving from a GOOD (received) to a BAD (lost) state, or `NaN` */
+  p: number,
+  /** The probability of moving from a BAD (lost) to a GOOD (received) state, or `NaN` */
+  r: number,
+  /** Whether the run currently in progress is a burst of lost packets */
+  lost: boolean,
+  /** The length of the run currently in progress */
+  length: number,
+}
+
+/** Find the bucket index for a run of the given length */
+function bucket(length: number): number {
+  let index = 0
+  while (length > RUN_BUCKETS[index]!) index ++
+  return index
+}
+
+export class LossTracker {
+  private readonly __bursts: Uint32Array = new Uint32Array(RUN_BUCKETS.length)
+  private readonly __gaps: Uint32Array = new Uint32Array(RUN_BUCKETS.length)
+
+  /* Transitions: good->good, good->bad, bad->good, bad->bad */
+  private __gg: number = 0
+  private __gb: number = 0
+  private __bg: number = 0
+  private __bb: number = 0
+
+  /* The current run: whether it's lost (or received) and its length */
+  private __lost: boolean = false
+  private __length: number = 0
+
+  /** Record a packet received */
+  received(): void {
+    if (this.__length === 0) {
+      this.__length = 1
+    } else if (this.__lost) {
+      this.__bursts[bucket(this.__length)] ++
+      this.__bg ++
+      this.__lost = false
+      this.__length = 1
+    } else {
+      this.__gg ++
+      this.__length ++
+    }
+  }
+
+  /** Record a number of _consecutive_ packets lost */
+  lost(count: number): void {
+    if (count < 1) return
+
+    if (this.__length === 0) {
+      this.__bb += count - 1
+      this.__lost = true
+      this.__length = count
+    } else if (this.__lost) {
+      this.__bb += count
+      this.__length += count
+    } else {
+      this.__gaps[bucket(this.__length)] ++
+      this.__gb ++
+      this.__bb += count - 1
+      this.__lost = true
+      this.__length = count
+    }
+  }
+
+  /** Save runs, transitions and the current run (in a fixed order) */
+  save(): number[] {
+    return [
+      ...this.__bursts, ...this.__gaps,
+      this.__gg, this.__gb, this.__bg, this.__bb,
+      this.__lost ? 1 : 0, this.__length,
+    ]
+  }
+
+  /** Restore what was saved by another tracker */
+  restore(values: number[]): void {
+    const buckets = RUN_BUCKETS.length
+    if (values.length !== buckets * 2 + 6) throw new Error(`Invalid losses state (length=${values.length})`)
+
+    this.__bursts.set(values.slice(0, buckets))
+    this.__gaps.set(values.slice(buckets, buckets * 2))
+    ;[ this.__gg, this.__gb, this.__bg, this.__bb ] = values.slice(buckets * 2, buckets * 2 + 4)
+    this.__lost = values[buckets * 2 + 4] === 1
+    this.__length = values[buckets * 2 + 5]!
+  }
+
+  /** Collect _and reset_ loss statistics (the current run is preserved) */
+  losses(): PingerLosses {
+    const good = this.__gg + this.__gb
+    const bad = this.__bg + this.__bb
+
+    const losses: PingerLosses = {
+      bursts: [ ...this.__bursts ],
+      gaps: [ ...this.__gaps ],
+      p: good < 1 ? NaN : this.__gb / good,
+      r: bad < 1 ? NaN : this.__bg / bad,
+      lost: this.__lost,
+      length: this.__length,
+    }
+
+    this.__bursts.fill(0)
+    this.__gaps.fill(0)
+    this.__gg = this.__gb = this.__bg = this.__bb = 0
+
+    return losses
+  }
+}
@@ -4,11 +4,11 @@
 /* eslint-disable no-console */
 import { isIP } from 'node:net'
 
-import { createPinger } from './index'
+import { createPinger, createResultSink, replay, soak } from './index'
 
 import type { PingerOptions } from './index'
 
-async function main(to: string, from: string = '', protocol?: 'ipv4' | 'ipv6'): Promise<void> {
+async function main(to: string, from: string = '', protocol?: 'ipv4' | 'ipv6', sink?: string): Promise<void> {
   const options: PingerOptions = { protocol }
 
   if (isIP(from)) {
@@ -18,6 +18,14 @@ async function main(to: string, from: string = '', protocol?: 'ipv4' | 'ipv6'):
   }
 
   const pinger = await createPinger(to, options)
+  const results = sink ? await createResultSink(sink) : undefined
+  if (results) {
+    results.attach(pinger)
+    results.on('error', (error) => {
+      console.error('Error streaming results', error)
+      stop()
+    })
+  }
 
   function stop(): void {
     const { sent, received, latency } = pinger.stats()
@@ -27,7 +35,7 @@ async function main(to: string, from: string = '', protocol?: 'ipv4' | 'ipv6'):
     console.log(`--- ${to} ping statistics ---`)
     console.log(`${sent} packets sent, ${received} received, ${loss}% packet loss, avgerage latency ${average}ms`)
 
-    pinger.close().then(() => process.exit(0), (error) => {
+    Promise.all([ pinger.close(), results?.close() ]).then(() => process.exit(0), (error) => {
       console.error('Error closing', error)
       process.exit(1)
     })
@@ -61,11 +69,58 @@ async function main(to: string, from: string = '', protocol?: 'ipv4' | 'ipv6'):
   pinger.start()
 }
 
+async function replayFile(file: string): Promise<void> {
+  const { packets, elapsed, rate, stats, warnings } = await replay(file)
+
+  for (const [ target, { sent, received, latency } ] of Object.entries(stats)) {
+    const loss = Math.round((1 - (received / sent)) * 100)
+    const average = Math.round(latency * 100) / 100
+
+    console.log(`--- ${target} ping statistics ---`)
+    console.log(`${sent} packets sent, ${received} received, ${loss}% packet loss, avgerage latency ${average}ms`)
+  }
+
+  for (const [ code, count ] of Object.entries(warnings)) {
+    console.log(`**WARNING** ${count} packets rejected (code=${code})`)
+  }
+
+  console.log(`--- ${file} replay statistics ---`)
+  console.log(`${packets} packets replayed in ${Math.round(elapsed * 100) / 100}ms, ${Math.round(rate)} packets/second`)
+}
+
+async function soakFleet(seconds: number, pingers: number): Promise<void> {
+  const mb = (bytes: number): string => `${Math.round(bytes / 104857.6) / 10}MB`
+  const ms = (millis: number): string => `${Math.round(millis * 100) / 100}ms`
+
+  console.log(`SOAK ${pingers} pingers for ${seconds} seconds`)
+  const result = await soak({
+    pingers,
+    duration: seconds * 1000,
+    sample: Math.max(1000, seconds * 10), // at most 100 samples
+    onSample: ({ time, heap, rss, external, delayP99, gcs, gcTime }) => {
+      console.log(`${Math.round(time / 1000)}s: heap=${mb(heap)} rss=${mb(rss)} external=${mb(external)} ` +
+        `delay(p99)=${ms(delayP99)} gc=${gcs}/${ms(gcTime)}`)
+    },
+  })
+
+  const { sent, received, gc, drift } = result
+  console.log(`--- soak statistics ---`)
+  console.log(`${sent} packets sent, ${received} received`)
+  console.log(`${gc.count} collections, p50=${ms(gc.p50)} p99=${ms(gc.p99)} max=${ms(gc.max)} total=${ms(gc.total)}`)
+  for (const [ name, { slope, growing } ] of Object.entries(drift)) {
+    console.log(`${name}: ${mb(slope)}/hour${growing ? ' **GROWING**' : ''}`)
+  }
+}
+
 /* ========================================================================== */
 
 let to: string | undefined = undefined
 let from: string | undefined = undefined
 let protocol: 'ipv4' | 'ipv6' | undefined = undefined
+let file: string | undefined = undefined
+let sink: string | undefined = undefined
+let seconds: number | undefined = undefined
+let pingers = 100
 
 for (let i = 2; i < process.argv.length; i ++) {
   if (process.argv[i] === '-I') {
@@ -73,6 +128,26 @@ for (let i = 2; i < process.argv.length; i ++) {
     continue
   }
 
+  if (process.argv[i] === '-r') {
+    file = process.argv[++i]
+    continue
+  }
+
+  if (process.argv[i] === '-s') {
+    sink = process.argv[++i]
+    continue
+  }
+
+  if (process.argv[i] === '-S') {
+    seconds = Number(process.argv[++i])
+    continue
+  }
+
+  if (process.argv[i] === '-n') {
+    pingers = Number(process.argv[++i])
+    continue
+  }
+
   if (process.argv[i] === '-6') {
     protocol = 'ipv6'
     continue
@@ -86,12 +161,24 @@ for (let i = 2; i < process.argv.length; i ++) {
   to = process.argv[i]
 }
 
-if (! to) {
-  console.log('Usage: juit-ping [-4|-6|-I ...] target')
+if (file) {
+  replayFile(file).catch((error) => {
+    console.error('Error replaying', error)
+    process.exit(2)
+  })
+} else if (seconds !== undefined) {
+  soakFleet(seconds, pingers).catch((error) => {
+    console.error('Error soaking', error)
+    process.exit(2)
+  })
+} else if (! to) {
+  console.log('Usage: juit-ping [-4|-6|-I ...|-s ...] target')
+  console.log('       juit-ping -r file.pcap')
+  console.log('       juit-ping -S seconds [-n pingers]')
   process.exit(1)
+} else {
+  main(to, from, protocol, sink).catch((error) => {
+    console.error('Error starting', error)
+    process.exit(2)
+  })
 }
-
-main(to, from, protocol).catch((error) => {
-  console.error('Error starting', error)
-  process.exit(2)
-})
@@ -0,0 +1,117 @@
+/* ========================================================================== *
+ * MEMORY ACCOUNTING AND BUDGET                                               *
+ * ========================================================================== *
+ *                                                                            *
+ * Each pinger reports the bytes used by its in-flight table, its histogram,  *
+ * its history (trace and capture rings) and its socket buffers.              *
+ *                                                                            *
+ * A global budget can be set for all open pingers in the process: it is      *
+ * checked periodically (and whenever set) and, when exceeded, pingers are    *
+ * degraded one stage at a time, all together, until back within budget:      *
+ *                                                                            *
+ * 1. history rings (traces and captures) are halved;                         *
+ * 2. histograms are coarsened (halving their resolution);                    *
+ * 3. in-flight tables are capped to half of their entries (the oldest ones   *
+ *    are considered lost _before_ their timeout).                            *
+ *                                                                            *
+ * Degradation is not undone when memory goes back within budget. Socket      *
+ * buffers live in the kernel, so they are reported but not budgeted.         *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Memory used by a pinger, in bytes */
+export interface PingerMemory {
+  /** Bytes used by the table of requests in flight */
+  inflight: number,
+  /** Bytes used by the latency histogram (for rollups) and heatmap (if any) */
+  histogram: number,
+  /** Bytes used by the history rings (trace and capture) */
+  history: number,
+  /** Bytes of the socket's receive and send buffers (kernel memory) */
+  socket: number,
+  /** Bytes counted against the memory budget (all of the above but sockets) */
+  total: number,
+}
+
+/** The stages of degradation, in the order they are applied */
+export type MemoryStage = 'history' | 'histogram' | 'inflight'
+
+const STAGES: MemoryStage[] = [ 'history', 'histogram', 'inflight' ]
+
+/** Something (a pinger) accounting for memory, and degradable */
+export interface MemoryAccountable {
+  /** The bytes counted against the budget (the `total` of its memory) */
+  __bytes(): number
+  /** Degrade one stage by one step, returning `false` if nothing changed */
+  __degrade(stage: MemoryStage): boolean
+}
+
+/** How often the budget is checked, in milliseconds */
+const CHECK_INTERVAL = 1000
+
+const accountables = new Set<MemoryAccountable>()
+let budget: number | undefined = undefined
+let timer: NodeJS.Timeout | undefined = undefined
+
+/** Start accounting for the memory of a (new) pinger */
+export function account(accountable: MemoryAccountable): void {
+  accountables.add(accountable)
+  schedule()
+}
+
+/** Stop accounting for the memory of a (closed) pinger */
+export function unaccount(accountable: MemoryAccountable): void {
+  accountables.delete(accountable)
+  schedule()
+}
+
+/**
+ * Set (or clear, with `undefined`) the memory budget **in bytes** for all
+ * pingers in this process, enforcing it straight away.
+ */
+export function setMemoryBudget(bytes: number | undefined): void {
+  if ((bytes !== undefined) && (! (Number.isInteger(bytes) && (bytes >= 0)))) {
+    throw new Error(`Invalid memory budget ${bytes}`)
+  }
+
+  budget = bytes
+  schedule()
+  enforceMemoryBudget()
+}
+
+/** Return the memory used by all pingers, and the budget (if any) */
+export function memoryUsage(): { pingers: number, bytes: number, budget: number | undefined } {
+  return { pingers: accountables.size, bytes: total(), budget }
+}
+
+/** Degrade all pingers, one stage at a time, until within our budget */
+export function enforceMemoryBudget(): void {
+  if (budget === undefined) return
+
+  for (const stage of STAGES) {
+    while (total() > budget) {
+      let changed = false
+      for (const accountable of accountables) changed = accountable.__degrade(stage) || changed
+      if (! changed) break
+    }
+    if (total() <= budget) return
+  }
+}
+
+/** The bytes used by all pingers, counted against the budget */
+function total(): number {
+  let bytes = 0
+  for (const accountable of accountables) bytes += accountable.__bytes()
+  return bytes
+}
+
+/** Check periodically only while there's both a budget and pingers */
+function schedule(): void {
+  const needed = (budget !== undefined) && (accountables.size > 0)
+  if (needed && (! timer)) {
+    timer = setInterval(enforceMemoryBudget, CHECK_INTERVAL).unref()
+  } else if ((! needed) && timer) {
+    clearInterval(timer)
+    timer = undefined
+  }
+}
@@ -0,0 +1,64 @@
+/* ========================================================================== *
+ * LOCAL OVERHEAD                                                             *
+ * ========================================================================== *
+ *                                                                            *
+ * The latency we measure is not only the network's round trip time, but it   *
+ * also includes the time _our own process_ took to:                          *
+ *                                                                            *
+ * - send:    the delay between the time an ECHO Request was scheduled to be  *
+ *            sent (by our interval timer or calling `ping()`) and the time   *
+ *            it was actually handed over to the kernel.                      *
+ * - receive: the delay between the time the kernel received an ECHO Reply    *
+ *            and the time we actually got to process it (only available on   *
+ *            platforms supporting kernel timestamps, e.g. Linux).            *
+ *                                                                            *
+ * Both are a direct consequence of event loop lag, and tracking them         *
+ * separately from latency tells whether the network or we got slower.        *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Statistics for one kind of local delay */
+export interface PingerDelay {
+  /** The number of samples collected */
+  count: number,
+  /** The average delay (in milliseconds) or `NaN` */
+  avg: number,
+  /** The maximum delay (in milliseconds) or `NaN` */
+  max: number,
+}
+
+/** Local overhead statistics, next to the latency in `stats()` */
+export interface PingerOverhead {
+  /** Delays between scheduled and actual send times */
+  send: PingerDelay,
+  /** Delays between kernel receive times and processing */
+  receive: PingerDelay,
+}
+
+export class DelayAccumulator {
+  private __count: number = 0
+  private __sum: number = 0
+  private __max: number = 0
+
+  /** Record a delay (in nanoseconds) */
+  record(delay: bigint): void {
+    // Clocks might disagree by a tiny bit, never record negative delays
+    const ms = delay > 0n ? Number(delay) / 1000000 : 0
+    this.__count ++
+    this.__sum += ms
+    if (ms > this.__max) this.__max = ms
+  }
+
+  /** Collect _and reset_ the delay statistics */
+  collect(): PingerDelay {
+    const count = this.__count
+    const delay: PingerDelay = {
+      count,
+      avg: count < 1 ? NaN : this.__sum / count,
+      max: count < 1 ? NaN : this.__max,
+    }
+
+    this.__count = this.__sum = this.__max = 0
+    return delay
+  }
+}
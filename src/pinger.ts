@@ -0,0 +1,863 @@
+/* ========================================================================== *
+ * PINGERS                                                                    *
+ * ========================================================================== *
+ *                                                                            *
+ * The implementation of a single `Pinger`: how its options are validated,    *
+ * how its socket is opened (eagerly, lazily or adopted from another process) *
+ * and how ECHO Requests are sent and their replies processed.                *
+ *                                                                            *
+ * Only `createPinger` and its types are part of our public API (re-exported  *
+ * by `index.ts`), the implementation is used internally by groups, handoffs  *
+ * and checkpoints.                                                           *
+ *                                                                            *
+ * ========================================================================== */
+
+import assert from 'node:assert'
+import { createSocket } from 'node:dgram'
+import { resolve4, resolve6 } from 'node:dns/promises'
+import { EventEmitter } from 'node:events'
+import { closeSync } from 'node:fs'
+import { writeFile } from 'node:fs/promises'
+import { isIP, isIPv4, isIPv6 } from 'node:net'
+import { networkInterfaces } from 'node:os'
+import { join } from 'node:path'
+
+import native from '../native/ping.cjs'
+import { burst } from './burst'
+import { Capture, wallClock } from './capture'
+import { systemClock } from './clock'
+import { ChangeDetector } from './detector'
+import { flood } from './flood'
+import { Heatmap } from './heatmap'
+import { lazyOpener, openSocket } from './lazy'
+import { LossTracker } from './loss'
+import { account, unaccount } from './memory'
+import { DelayAccumulator } from './overhead'
+import { ProbeTable } from './probe'
+import { getWarning, ProtocolHandler } from './protocol'
+import { checkWindow, RollupAccumulator, RollupTimer } from './rollup'
+import { Tracer, TRACE_DELIVERED, TRACE_RECEIVED, TRACE_SENT, TRACE_VALIDATED } from './trace'
+
+import type { PingerBurst } from './burst'
+import type { CaptureOptions, PingerCapture } from './capture'
+import type { Clock, ClockTimer } from './clock'
+import type { DetectorOptions, PingerChange } from './detector'
+import type { PingerFlood } from './flood'
+import type { HeatmapOptions } from './heatmap'
+import type { PingerOpener } from './lazy'
+import type { PingerLosses } from './loss'
+import type { MemoryAccountable, MemoryStage, PingerMemory } from './memory'
+import type { PingerOverhead } from './overhead'
+import type { PingerProbe } from './probe'
+import type { PingerRollup } from './rollup'
+import type { PingerState } from './state'
+import type { PingerTrace, TraceEvent, TraceOptions } from './trace'
+
+/**
+ * The delay since the kernel received the last packet on a socket, when our
+ * native binary can tell (binaries built before `stamp` was added can't).
+ */
+const stamp: (fd: number) => bigint | undefined =
+  typeof native.stamp === 'function' ? native.stamp : (): undefined => undefined
+
+/** The part of a `dgram` socket used by a pinger */
+export interface PingerSocket {
+  send(buffer: Buffer, port: number, address: string, callback: (error: Error | null) => void): void
+  close(callback?: () => void): void
+  on(event: 'close', listener: () => void): unknown
+  removeAllListeners(event: 'close'): unknown
+  getRecvBufferSize(): number
+  getSendBufferSize(): number
+}
+
+/** How a pinger wraps its file descriptor in a socket (simulations use their own) */
+export interface PingerConnector {
+  /** Wrap an open file descriptor in a socket, receiving its messages */
+  connect(
+    protocol: 'ipv4' | 'ipv6',
+    fd: number,
+    receive: (buffer: Buffer, address: string) => void,
+    bound: () => void,
+  ): PingerSocket
+  /** The delay since the kernel received the last packet on a socket, if known */
+  stamp(fd: number): bigint | undefined
+}
+
+/** Our connector for real file descriptors, wrapped in `dgram` sockets */
+const socketConnector: PingerConnector = {
+  connect: (protocol, fd, receive, bound) => {
+    const type = protocol === 'ipv4' ? 'udp4' : 'udp6'
+    return createSocket({ type }, (buffer, info) => receive(buffer, info.address)).bind({ fd }, bound)
+  },
+  stamp,
+}
+
+/** Options to create a {@link Pinger} instance */
+export interface PingerOptions {
+  /** The protocol: either `ipv4` or `ipv6` */
+  protocol?: 'ipv4' | 'ipv6',
+  /** An optional IP address or used to ping _from_ */
+  from?: string,
+  /** An optional source interface name to bind to for pinging */
+  source?: string,
+  /** The timeout **in milliseconds** after which a packet is considered _lost_ (default: 30000 - 30 sec) */
+  timeout?: number,
+  /** The interval **in milliseconds** used to ping the remote host (default: 1000 - 1 sec) */
+  interval?: number,
+  /** The ICMP identifier to bind to (default: assigned by the kernel, Linux only) */
+  identifier?: number,
+  /** Options for detecting changes in latency and packet loss */
+  detector?: DetectorOptions,
+  /** The window **in milliseconds** for emitting `rollup` events (default: none) */
+  rollup?: number,
+  /** Options for sampling the lifecycle of ECHO Requests (default: none) */
+  trace?: TraceOptions,
+  /** Options for capturing the last packets sent and received (default: none) */
+  capture?: CaptureOptions,
+  /** Options for keeping a heatmap of latencies over time (default: none) */
+  heatmap?: HeatmapOptions,
+  /** Whether to open the socket only when first started or pinged (default: false) */
+  lazy?: boolean,
+  /** The idle time **in milliseconds** after which a stopped pinger releases its socket (default: never) */
+  hibernate?: number,
+}
+
+/**
+ * Asynchronously create a new {@link Pinger} instance.
+ *
+ * @param to The IP address or host name to ping. If this parameter is an `IPv6`
+ *           _address_ (e.g. `::1`) the protocol used will default to `IPv6`
+ *           otherwise it will default to `IPv4`.
+ */
+export async function createPinger(to: string, options: PingerOptions = {}): Promise<Pinger> {
+  const {
+    protocol = isIPv6(to) ? 'ipv6' : 'ipv4',
+    timeout = 30000,
+    interval = 1000,
+    from,
+    source,
+    identifier,
+    lazy = false,
+  } = options
+
+  // Determine (and check) the address family
+  const family =
+    protocol === 'ipv6' ? native.AF_INET6 :
+    protocol === 'ipv4' ? native.AF_INET :
+    undefined
+  assert((family === native.AF_INET) || (family === native.AF_INET6), `Invalid protocol "${protocol}" specified`)
+
+  // Determine (or resolve) the destination address
+  const target = isIP(to) ? to :
+    protocol === 'ipv6' ? (await resolve6(to).catch(() => []))[0] :
+    protocol === 'ipv4' ? (await resolve4(to).catch(() => []))[0] :
+    /* coverage ignore next */ undefined
+
+  //  Check that the target was resolved and is the right kind
+  if (! target) {
+    throw new Error(`Unable to resolve ping target "${to}" as an ${protocol} address`)
+  } else if (isIPv4(target) && (protocol != 'ipv4')) {
+    throw new Error(`Invalid IPv4 ping target "${target}"`)
+  } else if (isIPv6(target) && (protocol != 'ipv6')) {
+    throw new Error(`Invalid IPv6 ping target "${target}"`)
+  }
+
+  // Determine the optional from address and check it's the right kind
+  if (from) {
+    if (isIPv4(from) && (protocol != 'ipv4')) {
+      throw new Error(`Invalid IPv6 address to ping from "${from}"`)
+    } else if (isIPv6(from) && (protocol != 'ipv6')) {
+      throw new Error(`Invalid IPv4 address to ping from "${from}"`)
+    } else if (!isIP(from)) {
+      throw new Error(`Invalid IP address to ping from "${from}"`)
+    }
+  }
+
+  // Ensure that the source interface is actually valid
+  if ((source) && (! networkInterfaces()[source])) {
+    throw new Error(`Invalid source interface name "${source}"`)
+  }
+
+  // Ensure that the identifier (if any) fits in 16 bits
+  if ((identifier !== undefined) && (! (Number.isInteger(identifier) && (identifier >= 0) && (identifier <= 0xffff)))) {
+    throw new Error(`Invalid ICMP identifier ${identifier}`)
+  }
+
+  // Validate our detector, rollup, trace, capture and heatmap options before opening any socket
+  const extras = prepare(options)
+
+  // Lazy pingers open their socket (and learn their identifier) when first used,
+  // and so do hibernated pingers when started again
+  const opener = lazyOpener(family, from, source, identifier)
+  if (lazy) {
+    return new PingerImpl(from, source, target, timeout, interval, protocol, undefined, identifier || undefined, ...extras, opener)
+  }
+
+  // Return a promise wrapping around our native code's "open" call
+  return new Promise((resolve, reject) => {
+    openSocket(family, from, source, identifier, (error, fd, bound) => {
+      if (error) {
+        Error.captureStackTrace(error)
+        return reject(error)
+      } else if (fd) {
+        // The identifier the kernel bound us to, or the one we'll write ourselves
+        const id = bound ?? (identifier || undefined)
+        return resolve(new PingerImpl(from, source, target, timeout, interval, protocol, fd, id, ...extras, opener))
+      } else /* coverage ignore next */ {
+        return reject(new Error(`Unknown error (fd=${fd})`))
+      }
+    })
+  })
+}
+
+/** Validate the options not related to sockets, and create what they need */
+function prepare(options: PingerOptions): [
+  ChangeDetector, number | undefined, Tracer | undefined, Capture | undefined, Heatmap | undefined, number | undefined,
+] {
+  const { detector, rollup, trace, capture, heatmap, hibernate } = options
+
+  const changeDetector = new ChangeDetector(detector)
+  if (rollup !== undefined) checkWindow(rollup)
+  const tracer = trace ? new Tracer(trace) : undefined
+  const packets = capture ? new Capture(capture) : undefined
+  const latencies = heatmap ? new Heatmap(heatmap) : undefined
+
+  if ((hibernate !== undefined) && (! (Number.isFinite(hibernate) && (hibernate >= 0)))) {
+    throw new Error(`Invalid hibernation idle time ${hibernate}`)
+  }
+
+  return [ changeDetector, rollup, tracer, packets, latencies, hibernate ]
+}
+
+/**
+ * Create a {@link PingerImpl} adopting an already open socket, and restoring
+ * its saved state (used when handing off sockets from another process).
+ *
+ * Without a socket (a lazy or hibernated pinger) the new pinger is lazy as
+ * well, and opens its own socket when first used.
+ */
+export function adoptPinger(state: PingerState, fd: number | undefined, options: PingerOptions = {}): PingerImpl {
+  const { target, protocol, from, source, timeout, interval } = state
+  const family = protocol === 'ipv6' ? native.AF_INET6 : native.AF_INET
+  // Sockets opened later (lazy or hibernated) bind to the identifier we had
+  const opener = lazyOpener(family, from, source, state.handler.identifier)
+  const pinger = new PingerImpl(from, source, target, timeout, interval, protocol, fd, undefined, ...prepare(options), opener)
+  pinger.__restore(state)
+  return pinger
+}
+
+export interface Pinger {
+  /** An optional IP address or used to ping _from_ */
+  readonly from?: string | undefined
+  /** An optional source interface name to bind to for pinging */
+  readonly source?: string | undefined
+  /** The IP address or host name to ping. */
+  readonly target: string
+  /** The timeout **in milliseconds** after which a packet is considered _lost_ (default: 30000 - 30 sec) */
+  readonly timeout: number
+  /** The interval **in milliseconds** used to ping the remote host (default: 1000 - 1 sec) */
+  readonly interval: number
+  /** The protocol: either `ipv4` or `ipv6` */
+  readonly protocol: 'ipv4' | 'ipv6'
+  /** The ICMP identifier of the ECHO Requests sent by this pinger */
+  readonly identifier: number
+
+  /** A flag indicating whether this pinger is _running_ */
+  readonly running: boolean
+  /** A flag indicating whether this pinger was _closed_ */
+  readonly closed: boolean
+  /** A flag indicating whether this pinger's socket is open (lazy and hibernated pingers open it when used) */
+  readonly opened: boolean
+
+  start(): void
+  stop(): void
+  close(): Promise<void>
+  stats(): PingerStats
+  losses(): PingerLosses
+  overhead(): PingerOverhead
+  /** Return the memory used by this pinger, in bytes */
+  memory(): PingerMemory
+  trace(): PingerTrace
+  /** Export the packets captured as a pcapng file, if capturing */
+  capture(): Buffer | undefined
+  /** Export the heatmap of latencies (see `decodeHeatmap`), if keeping one */
+  heatmap(): Buffer | undefined
+
+  ping(): Promise<void>
+  ping(callback: (error: Error | null) => void): void
+
+  /**
+   * Send an ECHO Request and wait for its reply, resolving with its sequence
+   * number and round trip time, or rejecting when lost or timed out.
+   */
+  probe(): Promise<PingerProbe>
+
+  /**
+   * Send `count` probes, back-to-back or `spacing` milliseconds apart, and
+   * resolve with their summary once all of them were answered or lost.
+   */
+  burst(count: number, spacing?: number): Promise<PingerBurst>
+
+  /**
+   * Keep `window` probes in flight for `duration` milliseconds, sending a new
+   * one as soon as one is answered or lost, and resolve with their summary.
+   *
+   * Each packet is sent as an individual probe, so this measures a target
+   * under a windowed load, but it is not a line-rate traffic generator.
+   */
+  flood(window: number, duration: number): Promise<PingerFlood>
+
+  on(event: 'error', handler: (error: Error) => void): void
+  off(event: 'error', handler: (error: Error) => void): void
+  once(event: 'error', handler: (error: Error) => void): void
+
+  on(event: 'warning', handler: (code: string, message: string) => void): void
+  off(event: 'warning', handler: (code: string, message: string) => void): void
+  once(event: 'warning', handler: (code: string, message: string) => void): void
+
+  on(event: 'pong', handler: (latency: number) => void): void
+  off(event: 'pong', handler: (latency: number) => void): void
+  once(event: 'pong', handler: (latency: number) => void): void
+
+  on(event: 'change', handler: (change: PingerChange) => void): void
+  off(event: 'change', handler: (change: PingerChange) => void): void
+  once(event: 'change', handler: (change: PingerChange) => void): void
+
+  on(event: 'rollup', handler: (rollup: PingerRollup) => void): void
+  off(event: 'rollup', handler: (rollup: PingerRollup) => void): void
+  once(event: 'rollup', handler: (rollup: PingerRollup) => void): void
+
+  on(event: 'capture', handler: (capture: PingerCapture) => void): void
+  off(event: 'capture', handler: (capture: PingerCapture) => void): void
+  once(event: 'capture', handler: (capture: PingerCapture) => void): void
+}
+
+export interface PingerStats {
+  sent: number,
+  received: number,
+  latency: number,
+}
+
+export class PingerImpl extends EventEmitter implements Pinger, MemoryAccountable {
+  private readonly __handler: ProtocolHandler
+  private readonly __rollups: RollupAccumulator = new RollupAccumulator()
+  private readonly __losses: LossTracker = new LossTracker()
+  private readonly __send_delay: DelayAccumulator = new DelayAccumulator()
+  private readonly __receive_delay: DelayAccumulator = new DelayAccumulator()
+  private readonly __rollup_timer?: RollupTimer
+  private readonly __probes: ProbeTable
+  private readonly __degraded = new Set<MemoryStage>()
+  private readonly __opening: ((error: Error | null) => void)[] = []
+
+  private __socket?: PingerSocket
+  private __descriptor?: number
+  private __timer?: ClockTimer
+  private __idle?: ClockTimer
+  private __scheduled: bigint = 0n
+
+  private __sent: number = 0
+  private __received: number = 0
+  private __latency: bigint = 0n
+  private __closed: boolean = false
+
+  constructor(
+      public readonly from: string | undefined,
+      public readonly source: string | undefined,
+      public readonly target: string,
+      private __timeout: number,
+      private __interval: number,
+      public readonly protocol: 'ipv4' | 'ipv6',
+      fd: number | undefined,
+      identifier: number | undefined,
+      private readonly __detector: ChangeDetector,
+      rollup: number | undefined,
+      private readonly __tracer: Tracer | undefined,
+      private readonly __capture: Capture | undefined,
+      private readonly __heatmap: Heatmap | undefined,
+      private readonly __hibernate?: number | undefined,
+      private readonly __opener?: PingerOpener | undefined,
+      private readonly __clock: Clock = systemClock,
+      private readonly __connector: PingerConnector = socketConnector,
+  ) {
+    super()
+
+    // Probes time out (all together, on one timer) like in-flight requests do
+    this.__probes = new ProbeTable(() => BigInt(this.__timeout) * 1000000n, () => {
+      this.__lost(this.__handler.expire(BigInt(this.__timeout) * 1000000n, this.__clock.now()))
+    }, __clock)
+
+    // Emit our own rollups only when a window was specified
+    if (rollup) {
+      this.__rollup_timer = new RollupTimer(rollup, (start, end) => {
+        this.emit('rollup', this.__rollup(start, end))
+      })
+    }
+
+    this.__handler = new ProtocolHandler(protocol === 'ipv6', identifier)
+
+    // Lazy pingers have no socket yet, and open it on first use
+    if (fd !== undefined) this.__attach(fd)
+
+    // Account for our memory against the budget (if any) until closed
+    account(this)
+  }
+
+  /** Wrap our (open) file descriptor in a socket, handling its incoming messages */
+  private __attach(fd: number): void {
+    const target = this.target
+    this.__descriptor = fd
+
+    // Create a socket and handle its incoming messages
+    this.__socket = this.__connector.connect(this.protocol, fd, (buffer, address) => {
+      // Check that the address we received the packet from matches our target,
+      // still capturing packets from anywhere else (rejected, but recorded)
+      if (address !== target) {
+        this.__capture?.stray(buffer, wallClock(), address, this.from)
+        return
+      }
+
+      // Get the delay since the kernel received this packet (if supported)
+      const now = this.__clock.now()
+      const delay = this.__connector.stamp(fd)
+      if (delay !== undefined) this.__receive_delay.record(delay)
+
+      // Get the latency for the incoming packet in nanoseconds (might be)
+      const latency = this.__handler.incoming(buffer, now)
+
+      // Capture the packet (rejected or not) when it was received by the kernel
+      const capture = this.__capture
+      if (capture) {
+        const time = wallClock()
+        capture.received(buffer, delay === undefined ? time : time - Number(delay) / 1000000, latency)
+        if ((latency < 0n) && capture.warning(time) && capture.armed) this.__dump('storm')
+      }
+
+      if (latency < 0n) {
+        const warning = getWarning(latency)
+        this.emit('warning', warning.code, warning.message)
+        return // negative latency, wrong packet!
+      }
+
+      // Trace when the reply was received (by the kernel) and validated
+      const tracer = this.__tracer
+      const sequence = this.__handler.sequence
+      const traced = !! tracer?.sampled(sequence)
+      if (traced) {
+        tracer!.mark(sequence, TRACE_RECEIVED, delay === undefined ? now : now - delay)
+        tracer!.mark(sequence, TRACE_VALIDATED, this.__clock.now())
+      }
+
+      // Requests skipped by this reply are lost, and come before it
+      this.__lost(this.__handler.skipped)
+
+      // Notify listeners and increase counters for stats
+      const ms = Number(latency) / 1000000
+      this.emit('pong', ms)
+      this.__probes.settle(sequence, ms)
+      if (traced) tracer!.mark(sequence, TRACE_DELIVERED, this.__clock.now())
+      this.__latency += latency
+      this.__received ++
+      this.__rollups.received(ms)
+      this.__losses.received()
+      this.__heatmap?.record(ms)
+
+      // Feed our change detector, and notify listeners only on changes
+      this.__change(this.__detector.loss(false))
+      this.__change(this.__detector.latency(ms))
+    }, () => {
+      Object.defineProperty(this, '__fd', { value: fd, configurable: true })
+    })
+
+    // Mark when we're closed
+    this.__socket.on('close', () => {
+      this.__closed = true
+      this.__probes.clear(new Error('Socket closed'))
+      unaccount(this)
+    })
+
+    // Idle from the start, until started (or pinged)
+    this.__rest()
+  }
+
+  /** Arm our hibernation timer (if hibernating) while stopped and open */
+  private __rest(): void {
+    if ((this.__hibernate === undefined) || this.__timer || (! this.__socket)) return
+    if (this.__idle) this.__clock.clearTimeout(this.__idle)
+    this.__idle = this.__clock.setTimeout(() => this.__sleep(), this.__hibernate)
+  }
+
+  /**
+   * Release our socket (closing its file descriptor) keeping everything else,
+   * unless requests are still in flight (waiting for them to time out first).
+   */
+  private __sleep(): void {
+    this.__idle = undefined
+    const socket = this.__socket
+    if ((! socket) || this.__timer || this.__closed) return
+
+    this.__lost(this.__handler.expire(BigInt(this.__timeout) * 1000000n, this.__clock.now()))
+    if (this.__handler.inflight.size || this.__probes.size) return this.__rest()
+
+    // Closing the socket for hibernating does not close the pinger
+    socket.removeAllListeners('close')
+    socket.close()
+    this.__socket = undefined
+    this.__descriptor = undefined
+  }
+
+  /**
+   * Open our socket, if lazy (or hibernated) and not open, calling back once opened.
+   * Everyone asking while the socket is being opened waits for the same open.
+   */
+  private __open(callback: (error: Error | null) => void): void {
+    if (this.__socket) return callback(null)
+    if (this.__closed) return callback(new Error('Socket closed'))
+    if (this.__opening.push(callback) > 1) return
+
+    this.__opener!((error, fd, bound) => {
+      const waiting = this.__opening.splice(0)
+
+      if (error) {
+        this.emit('error', error)
+        void this.close()
+      } else if (this.__closed) {
+        // Closed while opening, nobody will ever use this socket
+        closeSync(fd!)
+        error = new Error('Socket closed')
+      } else {
+        if (bound !== undefined) this.__handler.bind(bound)
+        this.__attach(fd!)
+      }
+
+      for (const waiter of waiting) waiter(error)
+    })
+  }
+
+  get timeout(): number {
+    return this.__timeout
+  }
+
+  get interval(): number {
+    return this.__interval
+  }
+
+  get identifier(): number {
+    return this.__handler.identifier
+  }
+
+  get running(): boolean {
+    return !! this.__timer
+  }
+
+  get closed(): boolean {
+    return this.__closed
+  }
+
+  get opened(): boolean {
+    return !! this.__socket
+  }
+
+  // wrap "emit" so that "error" events won't throw when no listeners are there
+  emit(eventName: 'error' | 'warning' | 'pong' | 'change' | 'rollup' | 'capture', ...args: any[]): boolean {
+    if (this.listenerCount(eventName) < 1) return false
+    return super.emit(eventName, ...args)
+  }
+
+  ping(): Promise<void>
+  ping(callback: (error: Error | null) => void): void
+  ping(callback?: (error: Error | null) => void): Promise<void> | void {
+    if (! callback) {
+      return new Promise((resolve, reject) => {
+        this.ping((error: Error | null) => error ? reject(error) : resolve())
+      })
+    }
+
+    this.__open((error) => {
+      if (error) return callback(error)
+      this.__ping(this.__clock.now(), callback)
+      this.__rest()
+    })
+  }
+
+  probe(): Promise<PingerProbe> {
+    return new Promise((resolve, reject) => {
+      if (this.__closed) return reject(new Error('Socket closed'))
+
+      this.__open((error) => {
+        if (error) return reject(error)
+
+        // Sends fail asynchronously, so the probe is recorded before that
+        const buffer = this.__ping(this.__clock.now(), (error) => {
+          if (error) this.__probes.reject(sequence, error)
+        })
+        const sequence = buffer.readUInt32BE(16)
+        this.__probes.add(sequence, buffer.readBigInt64BE(8), resolve, reject)
+        this.__rest()
+      })
+    })
+  }
+
+  burst(count: number, spacing: number = 0): Promise<PingerBurst> {
+    return burst(() => this.probe(), count, spacing)
+  }
+
+  flood(window: number, duration: number): Promise<PingerFlood> {
+    return flood(() => this.probe(), window, duration)
+  }
+
+  /** Send an ECHO Request, scheduled to be sent at the specified time */
+  private __ping(scheduled: bigint, callback: (error: Error | null) => void): Buffer {
+    // Account for all requests timed out before sending a new one
+    const now = this.__clock.now()
+    this.__lost(this.__handler.expire(BigInt(this.timeout) * 1000000n, now))
+
+    const buffer = this.__handler.outgoing(now)
+
+    // Trace when this request was scheduled and built, if sampled
+    const tracer = this.__tracer
+    const sequence = buffer.readUInt32BE(16)
+    const traced = !! tracer?.sampled(sequence)
+    if (traced) tracer!.start(sequence, scheduled, now)
+    this.__capture?.sent(buffer, wallClock())
+
+    this.__socket!.send(buffer, 1, this.target, (error) => {
+      if (error) {
+        this.emit('error', error)
+        callback(error) // before closing, so that probes fail with our error
+        void this.close()
+      } else {
+        // Synchronous sends call back on the next tick, right after sending
+        const sent = this.__clock.now()
+        if (traced) tracer!.mark(sequence, TRACE_SENT, sent)
+        this.__send_delay.record(sent - scheduled)
+        this.__sent ++
+        this.__rollups.sent()
+        callback(null)
+      }
+    })
+
+    return buffer
+  }
+
+  start(): void {
+    if (this.__closed) throw new Error('Socket closed')
+    if (this.__timer) return
+    if (this.__idle) this.__clock.clearTimeout(this.__idle)
+    this.__idle = undefined
+
+    this.__schedule()
+    this.__rollup_timer?.start()
+
+    // Lazy (or hibernated) pingers open their socket now, errors are emitted as events
+    this.__open(() => void 0)
+  }
+
+  /** Start our interval timer, sending an ECHO Request at every tick */
+  private __schedule(): void {
+    // Intervals are rescheduled after each tick, so the next tick is always
+    // expected one interval after the current one was run
+    const interval = BigInt(this.__interval) * 1000000n
+    this.__scheduled = this.__clock.now() + interval
+    this.__timer = this.__clock.setInterval(() => {
+      const scheduled = this.__scheduled
+      this.__scheduled = this.__clock.now() + interval
+      // Lazy pingers skip ticks until their socket is open
+      if (this.__socket) this.__ping(scheduled, () => void 0)
+    }, this.__interval)
+  }
+
+  /** Change our timeout and interval in place, rescheduling if running */
+  __retune(timeout: number, interval: number): void {
+    if (timeout !== this.__timeout) {
+      this.__timeout = timeout
+      this.__probes.__rearm()
+    }
+    if (interval === this.__interval) return
+
+    this.__interval = interval
+    if (! this.__timer) return
+    this.__clock.clearInterval(this.__timer)
+    this.__schedule()
+  }
+
+  stop(): void {
+    if (this.__timer) this.__clock.clearInterval(this.__timer)
+    this.__timer = undefined
+    this.__rollup_timer?.stop()
+    this.__rest()
+  }
+
+  close(): Promise<void> {
+    return new Promise((resolve) => {
+      if (this.__closed) return resolve()
+      if (this.__socket) this.__socket.close(resolve)
+      else resolve()
+      this.__closed = true
+      this.stop()
+      if (this.__idle) this.__clock.clearTimeout(this.__idle)
+      this.__idle = undefined
+      this.__probes.clear(new Error('Socket closed'))
+      unaccount(this)
+    })
+  }
+
+  private __change(change: PingerChange | undefined): void {
+    if (! change) return
+    this.emit('change', change)
+    if (this.__capture?.armed) this.__dump('change')
+  }
+
+  /** Produce a capture, writing it to our directory (if any) before emitting it */
+  private __dump(reason: PingerCapture['reason']): void {
+    const capture = this.__capture!
+    const data = capture.pcapng(this.from, this.target)
+    const directory = capture.directory
+    capture.disarm()
+
+    if (! directory) return void this.emit('capture', { reason, data })
+
+    const name = `ping-${this.target.replace(/[:%]/g, '_')}-${Date.now()}-${reason}.pcapng`
+    const file = join(directory, name)
+    writeFile(file, data).then(() => {
+      this.emit('capture', { reason, data, file })
+    }, (error) => {
+      this.emit('warning', 'ERR_CAPTURE', `Unable to write capture to "${file}": ${error.message}`)
+    })
+  }
+
+  /** Account for a number of _consecutive_ requests lost */
+  private __lost(count: number): void {
+    if (count < 1) return
+    this.__rollups.lost(count)
+    this.__losses.lost(count)
+    this.__heatmap?.lost(count)
+    for (let i = 0; i < count; i ++) this.__change(this.__detector.loss(true))
+  }
+
+  /** Save the state of this pinger (the file descriptor of its socket included, or -1 if not opened) */
+  __save(to: string): PingerState {
+    return {
+      to,
+      target: this.target,
+      protocol: this.protocol,
+      from: this.from,
+      source: this.source,
+      timeout: this.timeout,
+      interval: this.interval,
+      fd: this.__descriptor ?? -1,
+      handler: this.__handler.save(),
+      stats: { sent: this.__sent, received: this.__received, latency: this.__latency },
+      detector: this.__detector.save(),
+      losses: this.__losses.save(),
+      rollup: this.__rollups.save(),
+    }
+  }
+
+  /** Restore the state saved by another pinger */
+  __restore(state: PingerState): void {
+    this.__handler.restore(state.handler)
+    this.__sent = state.stats.sent
+    this.__received = state.stats.received
+    this.__latency = state.stats.latency
+    if (state.detector) this.__detector.restore(state.detector)
+    if (state.losses) this.__losses.restore(state.losses)
+    if (state.rollup) this.__rollups.restore(state.rollup)
+  }
+
+  /** Produce the rollup for the specified window and reset its accumulator */
+  __rollup(start: number, end: number): PingerRollup {
+    return this.__rollups.rollup(this.target, start, end)
+  }
+
+  stats(): PingerStats {
+    // Latency is NaN if no packets were received
+    const latency = this.__received < 1 ? NaN :
+      Number(this.__latency / BigInt(this.__received)) / 1000000
+
+    // Prepare the stats object from our counters
+    const stats = { sent: this.__sent, received: this.__received, latency }
+
+    // Reset counters
+    this.__sent = 0
+    this.__received = 0
+    this.__latency = 0n
+
+    // Done
+    return stats
+  }
+
+  losses(): PingerLosses {
+    return this.__losses.losses()
+  }
+
+  overhead(): PingerOverhead {
+    return {
+      send: this.__send_delay.collect(),
+      receive: this.__receive_delay.collect(),
+    }
+  }
+
+  memory(): PingerMemory {
+    const inflight = this.__handler.inflight.bytes
+    const histogram = this.__rollups.histogram.bytes + (this.__heatmap?.bytes || 0)
+    const history = (this.__tracer?.bytes || 0) + (this.__capture?.bytes || 0)
+
+    // Buffer sizes can't be read until opened and bound, or once closed
+    let socket = 0
+    try {
+      if (this.__socket) socket = this.__socket.getRecvBufferSize() + this.__socket.getSendBufferSize()
+    } catch {
+      // ignore
+    }
+
+    return { inflight, histogram, history, socket, total: inflight + histogram + history }
+  }
+
+  /** The bytes counted against the memory budget (no system calls here) */
+  __bytes(): number {
+    return this.__handler.inflight.bytes + this.__rollups.histogram.bytes + (this.__heatmap?.bytes || 0) +
+      (this.__tracer?.bytes || 0) + (this.__capture?.bytes || 0)
+  }
+
+  /** Degrade one stage by one step to save memory (see `memory.ts`) */
+  __degrade(stage: MemoryStage): boolean {
+    let changed = false
+    if (stage === 'history') {
+      const tracer = !! this.__tracer?.shrink()
+      const capture = !! this.__capture?.shrink()
+      changed = tracer || capture
+    } else if (stage === 'histogram') {
+      changed = this.__rollups.histogram.coarsen()
+    } else if (stage === 'inflight') {
+      // Halve the in-flight entries, expiring the oldest ones straight away
+      if (this.__handler.inflight.halve()) {
+        this.__lost(this.__handler.expire(BigInt(this.__timeout) * 1000000n))
+        changed = true
+      }
+    }
+
+    // Warn (only once per stage) when we degrade
+    if (changed && (! this.__degraded.has(stage))) {
+      this.__degraded.add(stage)
+      this.emit('warning', 'ERR_MEMORY_BUDGET', `Memory budget exceeded, degrading ${stage}`)
+    }
+    return changed
+  }
+
+  trace(): PingerTrace {
+    return { traceEvents: this.__trace(1), displayTimeUnit: 'ms' }
+  }
+
+  capture(): Buffer | undefined {
+    return this.__capture?.pcapng(this.from, this.target)
+  }
+
+  heatmap(): Buffer | undefined {
+    return this.__heatmap?.export()
+  }
+
+  /** Export our trace events (if tracing) on the specified track */
+  __trace(tid: number): TraceEvent[] {
+    return this.__tracer ? this.__tracer.events(tid, this.target) : []
+  }
+}
@@ -0,0 +1,152 @@
+/* ========================================================================== *
+ * AWAITABLE PROBES                                                           *
+ * ========================================================================== *
+ *                                                                            *
+ * Keeps track of the promises returned by `probe()`, indexed by the full     *
+ * (32 bits) sequence number of the ECHO Request they sent out.               *
+ *                                                                            *
+ * Sequences (and send times) are monotonic, so a `Map` (iterated in order of *
+ * insertion) is already sorted by deadline, and _one_ timer armed for the    *
+ * oldest probe is enough to time out all of them: when it fires we walk the  *
+ * map from its start until we find a probe still within its deadline, and    *
+ * re-arm the timer for it. Thousands of concurrent probes cost one entry     *
+ * each in the map, and not one timer each.                                   *
+ *                                                                            *
+ * The timer is not moved when probes are answered: firing early (for a probe *
+ * already gone) simply re-arms it, and is cheaper than re-arming per reply.  *
+ *                                                                            *
+ * Replies are accepted in order, so when a reply is received all the probes  *
+ * _before_ it (skipped by the protocol handler) are lost, too.               *
+ *                                                                            *
+ * ========================================================================== */
+
+import { systemClock } from './clock'
+
+import type { Clock, ClockTimer } from './clock'
+
+/** The result of an awaitable probe */
+export interface PingerProbe {
+  /** The full (32 bits) sequence number of the ECHO Request sent */
+  seq: number,
+  /** The round trip time **in milliseconds** of the probe */
+  rtt: number,
+}
+
+/** The error rejecting a probe that was lost, and why */
+export class ProbeError extends Error {
+  constructor(
+      message: string,
+      /** Whether the probe timed out or was overtaken by a later reply */
+      public readonly code: 'ERR_PROBE_TIMEOUT' | 'ERR_PROBE_OVERTAKEN',
+  ) {
+    super(message)
+  }
+}
+
+/** A probe waiting for its reply */
+interface Pending {
+  /** The time the ECHO Request was sent at */
+  time: bigint,
+  resolve: (probe: PingerProbe) => void,
+  reject: (error: Error) => void,
+}
+
+export class ProbeTable {
+  private readonly __pending = new Map<number, Pending>()
+  private __timer?: ClockTimer
+
+  /**
+   * Create a new table of probes.
+   *
+   * @param __timeout Return the current timeout **in nanoseconds**
+   * @param __expired Invoked when the oldest probe reached its deadline,
+   *                  before probes are rejected (to expire in-flight requests)
+   * @param __clock The clock probes are timed (and timed out) with
+   */
+  constructor(
+      private readonly __timeout: () => bigint,
+      private readonly __expired: () => void,
+      private readonly __clock: Clock = systemClock,
+  ) {}
+
+  /** The number of probes waiting for a reply */
+  get size(): number {
+    return this.__pending.size
+  }
+
+  /** Record a probe for the request with the specified sequence and time */
+  add(sequence: number, time: bigint, resolve: Pending['resolve'], reject: Pending['reject']): void {
+    this.__pending.set(sequence, { time, resolve, reject })
+    this.__arm()
+  }
+
+  /**
+   * Resolve the probe (if any) for the reply with the specified sequence,
+   * rejecting all probes sent before it, as they are lost.
+   */
+  settle(sequence: number, rtt: number): void {
+    for (const [ seq, pending ] of this.__pending) {
+      if (((seq - sequence) | 0) > 0) break
+      this.__pending.delete(seq)
+
+      if (seq === sequence) pending.resolve({ seq, rtt })
+      else pending.reject(new ProbeError(`Probe lost (seq=${seq}, overtaken by seq=${sequence})`, 'ERR_PROBE_OVERTAKEN'))
+    }
+    if (this.__pending.size === 0) this.__rearm()
+  }
+
+  /** Reject the probe for the request with the specified sequence */
+  reject(sequence: number, error: Error): void {
+    const pending = this.__pending.get(sequence)
+    if (! pending) return
+
+    this.__pending.delete(sequence)
+    pending.reject(error)
+    if (this.__pending.size === 0) this.__rearm()
+  }
+
+  /** Reject all probes sent _before_ the current timeout */
+  expire(now: bigint = this.__clock.now()): void {
+    const timeout = this.__timeout()
+    const deadline = now - timeout
+    for (const [ seq, pending ] of this.__pending) {
+      if (pending.time > deadline) break
+      this.__pending.delete(seq)
+
+      const ms = Number(timeout) / 1000000
+      pending.reject(new ProbeError(`Probe timed out (seq=${seq}, timeout=${ms}ms)`, 'ERR_PROBE_TIMEOUT'))
+    }
+    this.__rearm()
+  }
+
+  /** Reject all probes with the specified error, and stop our timer */
+  clear(error: Error): void {
+    const pending = [ ...this.__pending.values() ]
+    this.__pending.clear()
+    this.__rearm()
+    for (const { reject } of pending) reject(error)
+  }
+
+  /** Re-arm our timer for the oldest probe (e.g. after the timeout changed) */
+  __rearm(): void {
+    if (this.__timer) this.__clock.clearTimeout(this.__timer)
+    this.__timer = undefined
+    this.__arm()
+  }
+
+  /** Arm our timer for the oldest probe, unless already armed */
+  private __arm(): void {
+    if (this.__timer) return
+
+    const first = this.__pending.values().next()
+    if (first.done) return
+
+    const deadline = first.value.time + this.__timeout()
+    const delay = Number(deadline - this.__clock.now()) / 1000000
+    this.__timer = this.__clock.setTimeout(() => {
+      this.__timer = undefined
+      this.__expired()
+      this.expire()
+    }, Math.max(Math.ceil(delay), 0), true) // not "unref", someone awaits a probe
+  }
+}
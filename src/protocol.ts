@@ -32,8 +32,8 @@
  *                                                                            *
  * - Type:       kind of packet (ECHO Request/Response, ICMPv4/ICMPv6)        *
  * - Code:       always 0x00                                                  *
- * - Identifier: identifies the process ID sending the ECHO Request           *
- * - Sequence:   sequential number for correlating messages                   *
+ * - Identifier: the socket's identifier (on Linux) or the process ID         *
+ * - Sequence:   lower 16 bits of the full sequence, for correlating messages *
  * - Checksum:   calculated over the whole packet with checksum as zero       *
  * - Payload:    8 bytes timestamp in nanos, full sequence, correlation data  *
  *                                                                            *
@@ -46,6 +46,9 @@
 
 import { randomBytes } from 'node:crypto'
 
+import native from '../native/ping.cjs'
+import { InFlight } from './inflight'
+
 export const ERR_WRONG_LENGTH = -1n
 export const ERR_WRONG_CORRELATION = -2n
 export const ERR_WRONG_ICMP_TYPE = -3n
@@ -54,6 +57,25 @@ export const ERR_WRONG_SEQUENCE = -5n
 export const ERR_SEQUENCE_TOO_BIG = -6n
 export const ERR_SEQUENCE_TOO_SMALL = -7n
 export const ERR_LATENCY_NEGATIVE = -8n
+export const ERR_WRONG_IDENTIFIER = -9n
+export const ERR_WRONG_CHECKSUM = -10n
+export const ERR_WRONG_SOURCE = -11n
+
+/** The state of a {@link ProtocolHandler}, to be saved and restored */
+export interface HandlerState {
+  /** Our packet template, including our correlation data */
+  packet: Buffer,
+  /** The sequence of the last request sent */
+  sent: number,
+  /** The sequence of the last reply accepted */
+  received: number,
+  /** Requests still in flight as `[ sequence, time ]` */
+  inflight: [ number, bigint ][],
+  /** The identifier the socket is bound to, if known */
+  identifier?: number,
+  /** Whether the kernel was seen truncating sequences in replies to 8 bits */
+  truncated?: boolean,
+}
 
 export function getWarning(num: bigint): { code: string, message: string } {
   if (num >= 0) return { code: 'OK', message: `Latency is ${Number(num) / 1000000} ms` }
@@ -66,6 +88,9 @@ export function getWarning(num: bigint): { code: string, message: string } {
     case ERR_SEQUENCE_TOO_BIG: return { code: 'ERR_SEQUENCE_TOO_BIG', message: 'Received packet with sequence in the future' }
     case ERR_SEQUENCE_TOO_SMALL: return { code: 'ERR_SEQUENCE_TOO_SMALL', message: 'Received packet with sequence in the past (duplicate packet?)' }
     case ERR_LATENCY_NEGATIVE: return { code: 'ERR_LATENCY_NEGATIVE', message: 'Received packet with negative latence (time travel is possible!)' }
+    case ERR_WRONG_IDENTIFIER: return { code: 'ERR_WRONG_IDENTIFIER', message: 'Received packet with invalid identifier' }
+    case ERR_WRONG_CHECKSUM: return { code: 'ERR_WRONG_CHECKSUM', message: 'Received packet with invalid checksum' }
+    case ERR_WRONG_SOURCE: return { code: 'ERR_WRONG_SOURCE', message: 'Received packet from an address other than the target' }
     default: return { code: 'ERR_UNKNOWN', message: `Unknown error code (code=${num})` }
   }
 }
@@ -73,30 +98,73 @@ export function getWarning(num: bigint): { code: string, message: string } {
 export class ProtocolHandler {
   private readonly __packet: Buffer = randomBytes(64)
   private readonly __type: number
+  private readonly __inflight: InFlight = new InFlight()
   private __seq_out: number = 0
   private __seq_in: number = 0
+  private __seq_mask: number = 0xffff
+  private __skipped: number = 0
+  private __identifier: number | undefined
 
-  constructor(v6: boolean) {
+  /**
+   * Create a new handler, optionally with the identifier its socket is bound
+   * to: the kernel delivers only replies with the same identifier to it, and
+   * replies with any other identifier are rejected straight away.
+   */
+  constructor(v6: boolean, identifier?: number) {
     this.__type = (v6 ? 0x81 : 0x00)
+    this.__identifier = identifier
     // type (0x80 for IPv6, 0x08 for IPv4), code (0x00), checksum (0x0000)
     this.__packet.writeUInt32BE(v6 ? 0x80000000 : 0x08000000, 0)
-    // itentifier (process pid)
-    this.__packet.writeUInt16BE(process.pid % 0x0ffff, 4)
+    // itentifier (the socket's, or the process pid)
+    this.__packet.writeUInt16BE(identifier ?? process.pid % 0x0ffff, 4)
     // sequence (for now set to 0)
     this.__packet.writeUInt16BE(this.__seq_out, 6)
     // timestamp (set to zero as well)
     this.__packet.writeBigUInt64BE(0n, 8)
   }
 
-  outgoing(): Buffer {
+  /**
+   * The number of requests skipped by the last reply accepted by `incoming()`.
+   *
+   * As replies are only accepted in sequence order, any request still in
+   * flight with a sequence before the one of an accepted reply is _lost_.
+   */
+  get skipped(): number {
+    return this.__skipped
+  }
+
+  /** The sequence of the last reply accepted by `incoming()` */
+  get sequence(): number {
+    return this.__seq_in
+  }
+
+  /** The table of requests in flight (for memory accounting and capping) */
+  get inflight(): InFlight {
+    return this.__inflight
+  }
+
+  /** The identifier of our ECHO Requests */
+  get identifier(): number {
+    return this.__packet.readUInt16BE(4)
+  }
+
+  /** Adopt the identifier our socket was bound to, once (lazily) opened */
+  bind(identifier: number): void {
+    this.__identifier = identifier
+    this.__packet.writeUInt16BE(identifier, 4)
+  }
+
+  outgoing(now: bigint = process.hrtime.bigint()): Buffer {
     const buffer = Buffer.from(this.__packet)
 
-    // Prep the sequence (full sequence and lower 16 bits)
-    buffer.writeUInt32BE(++ this.__seq_out, 16)
-    buffer.writeUInt16BE(this.__seq_out & 0x0ff, 6)
+    // Prep the sequence (full sequence and lower 16 bits), wrapping around
+    this.__seq_out = (this.__seq_out + 1) >>> 0
+    buffer.writeUInt32BE(this.__seq_out, 16)
+    buffer.writeUInt16BE(this.__seq_out & 0xffff, 6)
 
-    // Prep the timestamp
-    buffer.writeBigUInt64BE(process.hrtime.bigint(), 8)
+    // Prep the timestamp, and remember this request is now in flight
+    buffer.writeBigUInt64BE(now, 8)
+    this.__inflight.add(this.__seq_out, now)
 
     // Calculate the checksum
     buffer.writeUInt16BE(rfc1071crc(buffer), 2)
@@ -105,21 +173,72 @@ export class ProtocolHandler {
     return buffer
   }
 
+  /** Save our state, so that another handler can pick up where we left */
+  save(): HandlerState {
+    const state: HandlerState = {
+      packet: Buffer.from(this.__packet),
+      sent: this.__seq_out,
+      received: this.__seq_in,
+      inflight: this.__inflight.entries(),
+    }
+    if (this.__identifier !== undefined) state.identifier = this.__identifier
+    if (this.__seq_mask !== 0xffff) state.truncated = true
+    return state
+  }
+
+  /** Restore a state saved by another handler */
+  restore(state: HandlerState): void {
+    if (state.packet.length !== 64) throw new Error(`Invalid packet length ${state.packet.length} in handler state`)
+    if (state.packet.readUInt8(0) !== this.__packet.readUInt8(0)) throw new Error('Mismatched ICMP type in handler state')
+
+    // Keep our own identifier (new socket) or adopt the saved one (same socket)
+    state.packet.copy(this.__packet)
+    if (this.__identifier !== undefined) this.__packet.writeUInt16BE(this.__identifier, 4)
+    else this.__identifier = state.identifier
+    this.__seq_out = state.sent
+    this.__seq_in = state.received
+    this.__seq_mask = state.truncated ? 0xff : 0xffff
+    for (const [ sequence, time ] of state.inflight) this.__inflight.add(sequence, time)
+  }
+
+  /**
+   * Track an ECHO Request built elsewhere (e.g. read from a capture file) as
+   * if it was sent by us, adopting its correlation data, sequence and time.
+   *
+   * Returns `false` if the request doesn't look like one of ours.
+   */
+  track(request: Buffer): boolean {
+    if (request.length !== 64) return false
+
+    request.copy(this.__packet, 20, 20, 64)
+    this.__seq_out = request.readUInt32BE(16)
+    this.__inflight.add(this.__seq_out, request.readBigInt64BE(8))
+    return true
+  }
+
   incoming(buffer: Buffer, now: bigint = process.hrtime.bigint()): bigint {
     // if the buffer is _bigger_ then our fixed 64 bytes packet size, it might
-    // be prepended by the IPv4 or IPv6 header (this happens on Macs)
+    // be prepended by the IPv4 or IPv6 header (this happens on Macs, and when
+    // replaying captures), and then its checksum was not verified for us
+    let ip: Buffer | undefined = undefined
     if (buffer.length > 64) {
       const first = buffer.readUInt8(0)
       const version = first >> 4
 
       if (version === 6) {
         // IPv6 is easy and has a fixed header length of 40 bytes, soo....
-        if (buffer.length === 104) buffer = buffer.subarray(40)
+        if (buffer.length === 104) {
+          ip = buffer.subarray(0, 40)
+          buffer = buffer.subarray(40)
+        }
       } else if (version === 4) {
         // IPv4 has a variable header length, the lower 4 bits of the first byte
         // indicate the length of the header in 32-bit (4-byte) words...
         const length = (first & 0xF) * 4
-        if (buffer.length === (length + 64)) buffer = buffer.subarray(length)
+        if (buffer.length === (length + 64)) {
+          ip = buffer.subarray(0, length)
+          buffer = buffer.subarray(length)
+        }
       }
     }
 
@@ -127,6 +246,12 @@ export class ProtocolHandler {
     // safely assume this is not an ECHO reply to one of our packets
     if (buffer.length !== 64) return ERR_WRONG_LENGTH
 
+    // When our socket is bound to an identifier, the kernel only delivers us
+    // replies with it, so this is a cheap check before comparing correlation
+    if ((this.__identifier !== undefined) && (buffer.readUInt16BE(4) !== this.__identifier)) {
+      return ERR_WRONG_IDENTIFIER
+    }
+
     // Compare the _correlation data_ part of the buffer to determine whether
     // this was a packet sent for us or not.... If not, ignore
     if (buffer.compare(this.__packet, 20, 64, 20, 64) !== 0) return ERR_WRONG_CORRELATION
@@ -139,42 +264,104 @@ export class ProtocolHandler {
     const code = buffer.readUInt8(1)
     if (code !== 0x00) return ERR_WRONG_ICMP_CODE
 
-    // Checksums on IPv6 require a "pseudo header" to be prepended so for now
-    // we skip the whole shabang and ignore it... I assume the kernel checks...
-    // const checksum = buffer.readUInt16BE(2)
-    // const computedChecksum = rfc1071crc(buffer)
-    // if (checksum != computedChecksum) return
-
-    // Identifier seems to get messed up on Linux IPv6 when pinging localhost,
-    // so we ignore this too, and simply rely on out _correlation data_ above...
-    // const identifier = buffer.readUInt16BE(4)
-    // if (identifier != this._id) return
+    // When we get the IP header, the kernel didn't check the checksum for us,
+    // so we do it here (ICMPv6 checksums cover a "pseudo header" with both
+    // addresses, so those must be known)... Otherwise, the kernel checks...
+    if (ip && (checksum(buffer, ip) !== 0)) return ERR_WRONG_CHECKSUM
 
     // Check the sequence, as it's monotonic we can discard values greater than
     // the last we sent out, or lower-or-equal than the last one we received...
     const sequence = buffer.readUInt32BE(16) // this is in our "payload"
 
-    // Sequence in the ICMP header is 16 bits, but as some kernels only return
-    // the lower 8 bits on ECHO Reply packets, so only match the lower 8 bits...
-    if ((buffer.readUInt16BE(6) & 0xFF) != (sequence & 0xFF)) return ERR_WRONG_SEQUENCE
+    // Sequence in the ICMP header is 16 bits, but some kernels only return
+    // the lower 8 bits on ECHO Reply packets: once we see one of those (with
+    // our correlation data) we only match the lower 8 bits from then on...
+    // but only once the reply is accepted, so a stray or replayed packet with
+    // a bogus sequence or timestamp can't weaken our checks for good
+    const header = buffer.readUInt16BE(6)
+    const truncated = ((header ^ sequence) & this.__seq_mask) !== 0
+    if (truncated) {
+      if ((this.__seq_mask !== 0xffff) || (header !== (sequence & 0xff))) return ERR_WRONG_SEQUENCE
+    }
 
+    // Full sequences wrap around at 32 bits, so they are compared as serial
+    // numbers (by the sign of their difference) rather than by their value.
     // If the full sequence is greater than whatever we sent out, we ignore
-    if (sequence > this.__seq_out) return ERR_SEQUENCE_TOO_BIG
+    if (((sequence - this.__seq_out) | 0) > 0) return ERR_SEQUENCE_TOO_BIG
 
     // If the full sequence is lower (or equal) to the last one received this
     // means we received either a duplicate packet, or an out of order one
-    if (sequence <= this.__seq_in) return ERR_SEQUENCE_TOO_SMALL
+    if (((sequence - this.__seq_in) | 0) <= 0) return ERR_SEQUENCE_TOO_SMALL
 
     // Calculate the delta-time in nanoseconds, if negative obviously ignore
     const latency = now - buffer.readBigInt64BE(8)
     if (latency < 0n) return ERR_LATENCY_NEGATIVE
 
+    // If the request is no longer in flight, it was already considered lost
+    if (this.__inflight.remove(sequence) === undefined) return ERR_SEQUENCE_TOO_SMALL
+
+    // Drop all requests before this one, they'll never be accepted
+    this.__skipped = this.__inflight.drop(sequence)
+
     // Store the last sequence number and return our latency
     this.__seq_in = sequence
+    if (truncated) this.__seq_mask = 0xff
     return latency
   }
+
+  /**
+   * Expire all requests sent more than `timeout` nanoseconds ago which have
+   * not been answered yet, returning the number of requests considered _lost_.
+   */
+  expire(timeout: bigint, now: bigint = process.hrtime.bigint()): number {
+    return this.__inflight.expire(now - timeout)
+  }
+}
+
+/**
+ * Return the checksum of an ICMP packet given its IP header, or `0` if it
+ * can't be verified (an IPv6 header where either address is unspecified).
+ */
+export function checksum(packet: Buffer, header: Buffer): number {
+  if ((header.readUInt8(0) >> 4) !== 6) return internetChecksum(packet)
+
+  const source = header.subarray(8, 24)
+  const destination = header.subarray(24, 40)
+  if (source.equals(UNSPECIFIED) || destination.equals(UNSPECIFIED)) return 0
+  return internetChecksum(packet, source, destination)
+}
+
+/** The unspecified IPv6 address "::" */
+const UNSPECIFIED = Buffer.alloc(16)
+
+/** Add all 16-bit words of a buffer to a sum (an odd last byte is padded) */
+function addWords(sum: number, buffer: Buffer): number {
+  const even = buffer.length & ~1
+  for (let i = 0; i < even; i += 2) sum += buffer.readUInt16BE(i)
+  if (even < buffer.length) sum += buffer.readUInt8(even) << 8
+  return sum
+}
+
+/**
+ * The JavaScript equivalent of our native `checksum`, used when the native
+ * binary was built before it existed: the Internet checksum (RFC 1071) of
+ * some data, optionally prepended by the ICMPv6 pseudo header.
+ */
+export function jsChecksum(data: Buffer, source?: Buffer, destination?: Buffer): number {
+  let sum = addWords(0, data)
+  if (source && destination) {
+    sum = addWords(addWords(sum, source), destination)
+    sum += (data.length >>> 16) + (data.length & 0xffff) + 58 // IPPROTO_ICMPV6
+  }
+
+  while (sum > 0xffff) sum = (sum & 0xffff) + (sum >>> 16)
+  return (~sum) & 0xffff
 }
 
+/** Our native `checksum`, or its JavaScript equivalent for older binaries */
+const internetChecksum: (data: Buffer, source?: Buffer, destination?: Buffer) => number =
+  typeof native.checksum === 'function' ? native.checksum as any : jsChecksum
+
 export function rfc1071crc(buffer: Buffer): number {
   let sum = 0
   for (let i = 0; i < buffer.length; i += 2) {
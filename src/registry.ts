@@ -0,0 +1,515 @@
+/* ========================================================================== *
+ * TARGET REGISTRY                                                            *
+ * ========================================================================== *
+ *                                                                            *
+ * Pings a (very) large number of targets from a single socket, keeping the   *
+ * state of each target in parallel typed arrays indexed by an integer id     *
+ * rather than in a `Pinger` (an event emitter, a protocol handler with its   *
+ * own packet and in-flight table, a socket and a timer) per target.          *
+ *                                                                            *
+ * Per target we keep its address (the string we send to), a generation, the  *
+ * last sequence sent and received, and the counters for its statistics, for  *
+ * roughly 100 bytes per target (the address string and its lookup included)  *
+ * so that a million targets fit in ~100 MB.                                  *
+ *                                                                            *
+ * ECHO Requests carry the id and generation of their target in the payload,  *
+ * right after the full sequence and before the correlation data shared by    *
+ * all targets, so replies are matched to their target without any lookup:    *
+ *                                                                            *
+ *  0                   1                   2                   3             *
+ *  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1           *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |     Type      |     Code      |          Checksum             |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |           Identifier          |        Sequence Number        |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |                    Timestamp (64 bits)                        |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |                   Full sequence (32 bits)                     |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |                      Target id (32 bits)                      |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |                  Target generation (32 bits)                  |          *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ * |             Correlation data (36 bytes, random)  ...                     *
+ * +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+          *
+ *                                                                            *
+ * Generations are bumped every time an id is reused, so that late replies to *
+ * a removed target are never accounted to the one that replaced it.          *
+ *                                                                            *
+ * There is no in-flight table: replies are accepted in sequence order, and   *
+ * only within the timeout (replies arriving later are considered lost).      *
+ *                                                                            *
+ * A single timer spreads sends across the interval: the interval is split in *
+ * ticks (of at most 10 ms), and each tick pings the targets whose id falls   *
+ * in its slot (`id % slots`) so that sends never pile up on one tick.        *
+ *                                                                            *
+ * Time (timers and `now`) comes from a `Clock` and packets go through a      *
+ * transport (normally our socket) so that the whole registry can also be run *
+ * against a virtual clock and a simulated network (see `simulation.ts`).     *
+ *                                                                            *
+ * ========================================================================== */
+
+import assert from 'node:assert'
+import { randomBytes } from 'node:crypto'
+import { createSocket } from 'node:dgram'
+import { EventEmitter } from 'node:events'
+import { isIPv4, isIPv6 } from 'node:net'
+import { networkInterfaces } from 'node:os'
+
+import native from '../native/ping.cjs'
+import { systemClock } from './clock'
+import { openSocket } from './lazy'
+import {
+  checksum,
+  ERR_LATENCY_NEGATIVE,
+  ERR_SEQUENCE_TOO_BIG,
+  ERR_SEQUENCE_TOO_SMALL,
+  ERR_WRONG_CHECKSUM,
+  ERR_WRONG_CORRELATION,
+  ERR_WRONG_ICMP_CODE,
+  ERR_WRONG_ICMP_TYPE,
+  ERR_WRONG_IDENTIFIER,
+  ERR_WRONG_LENGTH,
+  ERR_WRONG_SEQUENCE,
+  getWarning,
+  rfc1071crc,
+} from './protocol'
+
+import type { Clock, ClockTimer } from './clock'
+import type { PingerStats } from './pinger'
+
+/** Options to create a {@link PingerRegistry} instance */
+export interface PingerRegistryOptions {
+  /** The protocol: either `ipv4` (default) or `ipv6` */
+  protocol?: 'ipv4' | 'ipv6',
+  /** An optional IP address or used to ping _from_ */
+  from?: string,
+  /** An optional source interface name to bind to for pinging */
+  source?: string,
+  /** The timeout **in milliseconds** after which a packet is considered _lost_ (default: 30000 - 30 sec) */
+  timeout?: number,
+  /** The interval **in milliseconds** used to ping all targets (default: 1000 - 1 sec) */
+  interval?: number,
+  /** The ICMP identifier to bind to (default: assigned by the kernel, Linux only) */
+  identifier?: number,
+}
+
+/** A thin handle over a target in a {@link PingerRegistry} */
+export interface PingerHandle {
+  /** The id of the target in its registry */
+  readonly id: number
+  /** The IP address of the target */
+  readonly target: string
+  /** Collect _and reset_ the statistics of the target */
+  stats(): PingerStats
+}
+
+/**
+ * A registry of targets pinged from a single socket, keeping their state in
+ * typed arrays and addressing them by integer id.
+ */
+export interface PingerRegistry {
+  /** The protocol: either `ipv4` or `ipv6` */
+  readonly protocol: 'ipv4' | 'ipv6'
+  /** The timeout **in milliseconds** after which a packet is considered _lost_ */
+  readonly timeout: number
+  /** The interval **in milliseconds** used to ping all targets */
+  readonly interval: number
+  /** The ICMP identifier of the ECHO Requests sent by this registry */
+  readonly identifier: number
+  /** The number of targets in this registry */
+  readonly size: number
+  /** The number of bytes used by the state of all targets (addresses included) */
+  readonly bytes: number
+  /** A flag indicating whether this registry is _running_ */
+  readonly running: boolean
+  /** A flag indicating whether this registry was _closed_ */
+  readonly closed: boolean
+
+  /** Add a target (an IP address, never resolved) returning its id */
+  add(target: string): number
+  /** Remove the target with the specified id, its id will be reused */
+  remove(id: number): boolean
+  /** Return the id of the specified target (IP address) */
+  id(target: string): number | undefined
+  /** Return a (new) handle for the target with the specified id */
+  get(id: number): PingerHandle | undefined
+  /** Collect _and reset_ the statistics of the target with the specified id */
+  stats(id: number): PingerStats | undefined
+
+  start(): void
+  stop(): void
+  close(): Promise<void>
+
+  on(event: 'error', handler: (error: Error) => void): void
+  off(event: 'error', handler: (error: Error) => void): void
+  once(event: 'error', handler: (error: Error) => void): void
+
+  on(event: 'warning', handler: (id: number | undefined, code: string, message: string) => void): void
+  off(event: 'warning', handler: (id: number | undefined, code: string, message: string) => void): void
+  once(event: 'warning', handler: (id: number | undefined, code: string, message: string) => void): void
+
+  on(event: 'pong', handler: (id: number, latency: number) => void): void
+  off(event: 'pong', handler: (id: number, latency: number) => void): void
+  once(event: 'pong', handler: (id: number, latency: number) => void): void
+}
+
+/** How a registry sends packets: a socket, or a simulated network */
+export interface RegistryTransport {
+  send(buffer: Buffer, target: string): void
+  close(callback: () => void): void
+}
+
+/** Create a transport, delivering packets received to `receive` and errors to `fail` */
+export type RegistryConnector = (
+  receive: (buffer: Buffer, address: string) => void,
+  fail: (error: Error) => void,
+) => RegistryTransport
+
+/** The initial capacity of our arrays, grown (doubling) on demand */
+const INITIAL_CAPACITY = 1024
+
+/** The longest tick (in milliseconds) our interval is split into */
+const MAX_TICK = 10
+
+/** Open a socket, resolving with its file descriptor and bound identifier */
+function open(
+    family: number,
+    from: string | undefined,
+    source: string | undefined,
+    identifier: number | undefined,
+): Promise<[ number, number | undefined ]> {
+  return new Promise((resolve, reject) => {
+    openSocket(family, from, source, identifier, (error, fd, bound) => {
+      if (error) {
+        Error.captureStackTrace(error)
+        return reject(error)
+      } else if (fd) {
+        return resolve([ fd, bound ?? (identifier || undefined) ])
+      } else /* coverage ignore next */ {
+        return reject(new Error(`Unknown error (fd=${fd})`))
+      }
+    })
+  })
+}
+
+/**
+ * Asynchronously create a new {@link PingerRegistry}, opening its socket.
+ */
+export async function createPingerRegistry(options: PingerRegistryOptions = {}): Promise<PingerRegistry> {
+  const {
+    protocol = 'ipv4',
+    timeout = 30000,
+    interval = 1000,
+    from,
+    source,
+    identifier,
+  } = options
+
+  // Determine (and check) the address family
+  const family =
+    protocol === 'ipv6' ? native.AF_INET6 :
+    protocol === 'ipv4' ? native.AF_INET :
+    undefined
+  assert((family === native.AF_INET) || (family === native.AF_INET6), `Invalid protocol "${protocol}" specified`)
+
+  // Determine the optional from address and check it's the right kind
+  if (from) {
+    if (isIPv4(from) && (protocol != 'ipv4')) {
+      throw new Error(`Invalid IPv6 address to ping from "${from}"`)
+    } else if (isIPv6(from) && (protocol != 'ipv6')) {
+      throw new Error(`Invalid IPv4 address to ping from "${from}"`)
+    } else if (! (isIPv4(from) || isIPv6(from))) {
+      throw new Error(`Invalid IP address to ping from "${from}"`)
+    }
+  }
+
+  // Ensure that the source interface is actually valid
+  if ((source) && (! networkInterfaces()[source])) {
+    throw new Error(`Invalid source interface name "${source}"`)
+  }
+
+  // Ensure that the identifier (if any) fits in 16 bits
+  if ((identifier !== undefined) && (! (Number.isInteger(identifier) && (identifier >= 0) && (identifier <= 0xffff)))) {
+    throw new Error(`Invalid ICMP identifier ${identifier}`)
+  }
+
+  const [ fd, bound ] = await open(family, from, source, identifier)
+  const type = protocol === 'ipv6' ? 'udp6' : 'udp4'
+  return new PingerRegistryImpl(protocol, timeout, interval, bound, (receive, fail) => {
+    const socket = createSocket({ type }, (buffer, info) => receive(buffer, info.address))
+    socket.bind({ fd })
+    socket.on('error', fail)
+    return {
+      send: (buffer, target): void => socket.send(buffer, 1, target),
+      close: (callback): void => void socket.close(callback),
+    }
+  })
+}
+
+export class PingerRegistryImpl extends EventEmitter implements PingerRegistry {
+  private readonly __transport: RegistryTransport
+  private readonly __packet: Buffer = Buffer.alloc(64)
+  private readonly __type: number
+  private readonly __identifier: number | undefined
+  private readonly __timeout_ns: bigint
+
+  // Per-target state, indexed by id
+  private readonly __ids = new Map<string, number>()
+  private __addresses: (string | undefined)[] = []
+  private __generations: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __seq_out: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __seq_in: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __sent: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __received: Uint32Array = new Uint32Array(INITIAL_CAPACITY)
+  private __latency: Float64Array = new Float64Array(INITIAL_CAPACITY)
+
+  private readonly __free: number[] = []
+  private __generation: number = 0
+  private __length: number = 0
+
+  private __timer?: ClockTimer
+  private __tick: number = 0
+  private __last: number | undefined = undefined
+  private __closed: boolean = false
+
+  constructor(
+      public readonly protocol: 'ipv4' | 'ipv6',
+      public readonly timeout: number,
+      public readonly interval: number,
+      identifier: number | undefined,
+      connect: RegistryConnector,
+      private readonly __clock: Clock = systemClock,
+  ) {
+    super()
+
+    const v6 = protocol === 'ipv6'
+    this.__type = v6 ? 0x81 : 0x00
+    this.__identifier = identifier
+    this.__timeout_ns = BigInt(timeout) * 1000000n
+
+    // type, code (0x00), checksum (0x0000), identifier and correlation data
+    this.__packet.writeUInt32BE(v6 ? 0x80000000 : 0x08000000, 0)
+    this.__packet.writeUInt16BE(identifier ?? process.pid % 0x0ffff, 4)
+    randomBytes(36).copy(this.__packet, 28)
+
+    // Create our transport (socket) and handle its incoming messages
+    this.__transport = connect((buffer, address) => {
+      const now = this.__clock.now()
+      const latency = this.__incoming(buffer, address, now)
+
+      if (latency < 0n) {
+        const warning = getWarning(latency)
+        this.emit('warning', this.__last, warning.code, warning.message)
+      } else {
+        this.emit('pong', this.__last, Number(latency) / 1000000)
+      }
+    }, (error) => {
+      // Errors (e.g. from sends) close the registry, just like pingers
+      this.emit('error', error)
+      void this.close()
+    })
+  }
+
+  get identifier(): number {
+    return this.__packet.readUInt16BE(4)
+  }
+
+  get size(): number {
+    return this.__ids.size
+  }
+
+  get bytes(): number {
+    // Typed arrays, plus a pointer and a (small) string per address
+    let bytes = this.__generations.byteLength + this.__seq_out.byteLength +
+      this.__seq_in.byteLength + this.__sent.byteLength +
+      this.__received.byteLength + this.__latency.byteLength +
+      this.__addresses.length * 8
+    for (const address of this.__ids.keys()) {
+      // a string (16 bytes header plus its content, 8 bytes aligned) and a
+      // map entry (key, value and chain, in a table twice as big)
+      bytes += 16 + Math.ceil(address.length / 8) * 8 + 48
+    }
+    return bytes
+  }
+
+  get running(): boolean {
+    return !! this.__timer
+  }
+
+  get closed(): boolean {
+    return this.__closed
+  }
+
+  // wrap "emit" so that "error" events won't throw when no listeners are there
+  emit(eventName: 'error' | 'warning' | 'pong', ...args: any[]): boolean {
+    if (this.listenerCount(eventName) < 1) return false
+    return super.emit(eventName, ...args)
+  }
+
+  add(target: string): number {
+    if (this.protocol === 'ipv4' ? (! isIPv4(target)) : (! isIPv6(target))) {
+      throw new Error(`Invalid ${this.protocol} target "${target}"`)
+    }
+    if (this.__ids.has(target)) throw new Error(`Target "${target}" already in registry`)
+
+    const id = this.__free.length ? this.__free.pop()! : this.__length ++
+    if (id >= this.__generations.length) this.__grow()
+
+    this.__generation = (this.__generation + 1) >>> 0
+    this.__generations[id] = this.__generation
+    this.__seq_out[id] = this.__seq_in[id] = 0
+    this.__sent[id] = this.__received[id] = this.__latency[id] = 0
+    this.__addresses[id] = target
+    this.__ids.set(target, id)
+    return id
+  }
+
+  remove(id: number): boolean {
+    const target = this.__addresses[id]
+    if (target === undefined) return false
+
+    this.__addresses[id] = undefined
+    this.__ids.delete(target)
+    this.__free.push(id)
+    return true
+  }
+
+  id(target: string): number | undefined {
+    return this.__ids.get(target)
+  }
+
+  get(id: number): PingerHandle | undefined {
+    const target = this.__addresses[id]
+    if (target === undefined) return undefined
+    return { id, target, stats: () => this.stats(id)! }
+  }
+
+  stats(id: number): PingerStats | undefined {
+    if (this.__addresses[id] === undefined) return undefined
+
+    const sent = this.__sent[id]!
+    const received = this.__received[id]!
+    const latency = received < 1 ? NaN : this.__latency[id]! / received / 1000000
+
+    this.__sent[id] = this.__received[id] = this.__latency[id] = 0
+    return { sent, received, latency }
+  }
+
+  start(): void {
+    if (this.__closed) throw new Error('Socket closed')
+    if (this.__timer) return
+
+    // Split the interval in slots, one per tick, each pinging its own targets
+    const tick = Math.min(this.interval, MAX_TICK)
+    const slots = Math.max(Math.round(this.interval / tick), 1)
+    this.__timer = this.__clock.setInterval(() => {
+      const slot = this.__tick = (this.__tick + 1) % slots
+      for (let id = slot; id < this.__length; id += slots) this.__ping(id)
+    }, tick)
+  }
+
+  stop(): void {
+    if (this.__timer) this.__clock.clearInterval(this.__timer)
+    this.__timer = undefined
+  }
+
+  close(): Promise<void> {
+    if (this.__closed) return Promise.resolve()
+    this.__closed = true
+    this.stop()
+
+    return new Promise((resolve) => this.__transport.close(resolve))
+  }
+
+  /** Send an ECHO Request to the target with the specified id */
+  __ping(id: number): void {
+    const target = this.__addresses[id]
+    if (target === undefined) return
+
+    const buffer = Buffer.from(this.__packet)
+    const sequence = this.__seq_out[id] = (this.__seq_out[id]! + 1) >>> 0
+    buffer.writeUInt16BE(sequence & 0xffff, 6)
+    buffer.writeBigUInt64BE(this.__clock.now(), 8)
+    buffer.writeUInt32BE(sequence, 16)
+    buffer.writeUInt32BE(id, 20)
+    buffer.writeUInt32BE(this.__generations[id]!, 24)
+    buffer.writeUInt16BE(rfc1071crc(buffer), 2)
+
+    // No callback: errors are emitted by the socket (one closure less)
+    this.__transport.send(buffer, target)
+    this.__sent[id] ++
+  }
+
+  /**
+   * Validate an incoming packet, returning its latency in nanoseconds or a
+   * negative error code, and remembering the id of its target (if known).
+   */
+  __incoming(buffer: Buffer, address: string, now: bigint): bigint {
+    this.__last = undefined
+
+    // Strip the IP header (if any) and remember it for checksums
+    let ip: Buffer | undefined = undefined
+    if (buffer.length > 64) {
+      const first = buffer.readUInt8(0)
+      const length = (first >> 4) === 6 ? 40 : (first & 0xf) * 4
+      if (buffer.length === (length + 64)) {
+        ip = buffer.subarray(0, length)
+        buffer = buffer.subarray(length)
+      }
+    }
+
+    if (buffer.length !== 64) return ERR_WRONG_LENGTH
+    if ((this.__identifier !== undefined) && (buffer.readUInt16BE(4) !== this.__identifier)) {
+      return ERR_WRONG_IDENTIFIER
+    }
+    if (buffer.compare(this.__packet, 28, 64, 28, 64) !== 0) return ERR_WRONG_CORRELATION
+
+    // The target must still be the one we sent to, from the same address
+    const id = buffer.readUInt32BE(20)
+    if ((this.__addresses[id] !== address) || (this.__generations[id] !== buffer.readUInt32BE(24))) {
+      return ERR_WRONG_CORRELATION
+    }
+    this.__last = id
+
+    if (buffer.readUInt8(0) !== this.__type) return ERR_WRONG_ICMP_TYPE
+    if (buffer.readUInt8(1) !== 0x00) return ERR_WRONG_ICMP_CODE
+    if (ip && (checksum(buffer, ip) !== 0)) return ERR_WRONG_CHECKSUM
+
+    // Accept 16 or 8 bits (truncating kernels) of sequence in the header
+    const sequence = buffer.readUInt32BE(16)
+    const header = buffer.readUInt16BE(6)
+    if ((header !== (sequence & 0xffff)) && (header !== (sequence & 0xff))) return ERR_WRONG_SEQUENCE
+
+    if (((sequence - this.__seq_out[id]!) | 0) > 0) return ERR_SEQUENCE_TOO_BIG
+    if (((sequence - this.__seq_in[id]!) | 0) <= 0) return ERR_SEQUENCE_TOO_SMALL
+
+    // Replies after our timeout were already considered lost
+    const latency = now - buffer.readBigInt64BE(8)
+    if (latency < 0n) return ERR_LATENCY_NEGATIVE
+    if (latency > this.__timeout_ns) return ERR_SEQUENCE_TOO_SMALL
+
+    this.__seq_in[id] = sequence
+    this.__received[id] ++
+    this.__latency[id] += Number(latency)
+    return latency
+  }
+
+  /** Double the capacity of all our typed arrays */
+  private __grow(): void {
+    const capacity = this.__generations.length * 2
+    const grow = <T extends Uint32Array | Float64Array>(array: T): T => {
+      const grown = new (array.constructor as new (length: number) => T)(capacity)
+      grown.set(array as any)
+      return grown
+    }
+
+    this.__generations = grow(this.__generations)
+    this.__seq_out = grow(this.__seq_out)
+    this.__seq_in = grow(this.__seq_in)
+    this.__sent = grow(this.__sent)
+    this.__received = grow(this.__received)
+    this.__latency = grow(this.__latency)
+  }
+}
@@ -0,0 +1,318 @@
+/* ========================================================================== *
+ * OFFLINE REPLAY                                                             *
+ * ========================================================================== *
+ *                                                                            *
+ * Reads a pcap or pcapng file of ICMP traffic and feeds its ECHO Requests    *
+ * and Replies through our protocol handler as fast as possible, producing    *
+ * the same statistics a live run would, and the speed at which packets were  *
+ * processed.                                                                 *
+ *                                                                            *
+ * Files are parsed (and packets extracted) _before_ replaying, so that only  *
+ * the protocol handler is measured. One handler is used per target, and it   *
+ * adopts the correlation data, sequence and time of each captured request.   *
+ *                                                                            *
+ * Latencies are the difference between the _capture_ times of each reply     *
+ * and its request, as the clock of the capturing process is not ours.        *
+ *                                                                            *
+ * ========================================================================== */
+
+import { readFile } from 'node:fs/promises'
+
+import { getWarning, ProtocolHandler } from './protocol'
+
+import type { PingerStats } from './pinger'
+
+/** The result of replaying a capture */
+export interface PingerReplay {
+  /** The number of ICMP ECHO Requests and Replies replayed */
+  packets: number,
+  /** The time spent **in milliseconds** processing packets */
+  elapsed: number,
+  /** The number of packets processed per second */
+  rate: number,
+  /** Statistics for each target, as returned by `stats()` */
+  stats: Record<string, PingerStats>,
+  /** The number of warnings emitted, keyed by warning code */
+  warnings: Record<string, number>,
+}
+
+/** An ICMP ECHO Request or Reply extracted from a capture */
+interface Packet {
+  /** The remote address (destination of requests, source of replies) */
+  target: string,
+  v6: boolean,
+  request: boolean,
+  icmp: Buffer,
+  /** The whole IP packet, so that checksums of replies can be verified */
+  ip: Buffer,
+  /** The capture time (requests) or the time to validate at (replies) */
+  time: bigint,
+}
+
+/**
+ * Replay a pcap or pcapng file (or its contents) through our protocol handler.
+ */
+export async function replay(file: string | Buffer): Promise<PingerReplay> {
+  const data = typeof file === 'string' ? await readFile(file) : file
+  const packets = correlate(parse(data))
+
+  const handlers = new Map<string, ProtocolHandler>()
+  const correlations = new Map<string, Buffer>()
+  const counters = new Map<string, { sent: number, received: number, latency: bigint }>()
+  const errors = new Map<bigint, number>()
+
+  // Prepare handlers and counters for all targets
+  for (const { target, v6 } of packets) {
+    if (handlers.has(target)) continue
+    handlers.set(target, new ProtocolHandler(v6))
+    counters.set(target, { sent: 0, received: 0, latency: 0n })
+  }
+
+  // Replay all packets, as fast as possible
+  const start = process.hrtime.bigint()
+  for (const packet of packets) {
+    const counter = counters.get(packet.target)!
+
+    if (packet.request) {
+      // A pinger was re-created (new correlation data), so use a new handler
+      const correlation = correlations.get(packet.target)
+      if (correlation && (packet.icmp.length === 64) && (packet.icmp.compare(correlation, 0, 44, 20, 64) !== 0)) {
+        handlers.set(packet.target, new ProtocolHandler(packet.v6))
+      }
+      if (handlers.get(packet.target)!.track(packet.icmp)) {
+        correlations.set(packet.target, packet.icmp.subarray(20, 64))
+        counter.sent ++
+      }
+    } else {
+      const latency = handlers.get(packet.target)!.incoming(packet.ip, packet.time)
+      if (latency < 0n) {
+        errors.set(latency, (errors.get(latency) || 0) + 1)
+      } else {
+        counter.latency += latency
+        counter.received ++
+      }
+    }
+  }
+  const elapsed = Number(process.hrtime.bigint() - start) / 1000000
+
+  // Prepare our statistics, just like `stats()` does
+  const stats: Record<string, PingerStats> = {}
+  for (const [ target, { sent, received, latency } ] of counters) {
+    stats[target] = {
+      sent,
+      received,
+      latency: received < 1 ? NaN : Number(latency / BigInt(received)) / 1000000,
+    }
+  }
+
+  // Count warnings by code
+  const warnings: Record<string, number> = {}
+  for (const [ error, count ] of errors) warnings[getWarning(error).code] = count
+
+  return {
+    packets: packets.length,
+    elapsed,
+    rate: elapsed > 0 ? packets.length / (elapsed / 1000) : Infinity,
+    stats,
+    warnings,
+  }
+}
+
+/**
+ * Compute the time each reply should be validated at: its request's payload
+ * timestamp, plus the time elapsed between capturing request and reply.
+ */
+function correlate(packets: Packet[]): Packet[] {
+  const requests = new Map<string, bigint>()
+
+  for (const packet of packets) {
+    if (packet.icmp.length < 20) continue
+    const key = `${packet.target}/${packet.icmp.readUInt32BE(16)}`
+
+    if (packet.request) {
+      requests.set(key, packet.time)
+    } else {
+      const sent = requests.get(key)
+      if (sent !== undefined) packet.time = packet.icmp.readBigInt64BE(8) + (packet.time - sent)
+    }
+  }
+
+  return packets
+}
+
+/* ========================================================================== *
+ * PCAP AND PCAPNG PARSING                                                    *
+ * ========================================================================== */
+
+/* Link types we know how to decode */
+const LINKTYPE_NULL = 0
+const LINKTYPE_ETHERNET = 1
+const LINKTYPE_RAW = 101
+const LINKTYPE_LINUX_SLL = 113
+const LINKTYPE_IPV4 = 228
+const LINKTYPE_IPV6 = 229
+const LINKTYPE_LINUX_SLL2 = 276
+
+/** Parse a pcap or pcapng file, returning all ICMP ECHO packets in it */
+function parse(data: Buffer): Packet[] {
+  if (data.length < 24) throw new Error('Invalid capture file (too short)')
+
+  const magic = data.readUInt32LE(0)
+  if (magic === 0x0a0d0d0a) return parsePcapng(data)
+  if ((magic === 0xa1b2c3d4) || (magic === 0xa1b23c4d)) return parsePcap(data, true)
+  if ((magic === 0xd4c3b2a1) || (magic === 0x4d3cb2a1)) return parsePcap(data, false)
+
+  throw new Error(`Invalid capture file (magic=0x${magic.toString(16)})`)
+}
+
+function parsePcap(data: Buffer, le: boolean): Packet[] {
+  const u32 = (offset: number): number => le ? data.readUInt32LE(offset) : data.readUInt32BE(offset)
+  const nanos = (u32(0) === 0xa1b23c4d)
+  const linktype = u32(20) & 0x0fffffff
+
+  const packets: Packet[] = []
+  for (let offset = 24; offset + 16 <= data.length; ) {
+    const seconds = BigInt(u32(offset))
+    const fraction = BigInt(u32(offset + 4))
+    const length = u32(offset + 8)
+    const time = seconds * 1000000000n + (nanos ? fraction : fraction * 1000n)
+
+    decode(packets, linktype, data.subarray(offset + 16, offset + 16 + length), time)
+    offset += 16 + length
+  }
+  return packets
+}
+
+function parsePcapng(data: Buffer): Packet[] {
+  const packets: Packet[] = []
+  let interfaces: { linktype: number, resolution: (ts: bigint) => bigint }[] = []
+  let le = true
+
+  for (let offset = 0; offset + 12 <= data.length; ) {
+    // The byte order is determined by each section header
+    if (data.readUInt32LE(offset) === 0x0a0d0d0a) {
+      le = data.readUInt32LE(offset + 8) === 0x1a2b3c4d
+      interfaces = []
+    }
+
+    const u16 = (at: number): number => le ? data.readUInt16LE(at) : data.readUInt16BE(at)
+    const u32 = (at: number): number => le ? data.readUInt32LE(at) : data.readUInt32BE(at)
+
+    const type = u32(offset)
+    const length = u32(offset + 4)
+    if ((length < 12) || (offset + length > data.length)) throw new Error(`Invalid pcapng block at offset ${offset}`)
+
+    if (type === 0x00000001) { // interface description block
+      let resolution = (ts: bigint): bigint => ts * 1000n // microseconds by default
+      for (let option = offset + 16; option + 4 <= offset + length - 4; ) {
+        const code = u16(option)
+        const size = u16(option + 2)
+        if (code === 0) break
+        if ((code === 9) && (size === 1)) resolution = tsresol(data.readUInt8(option + 4))
+        option += 4 + ((size + 3) & ~3)
+      }
+      interfaces.push({ linktype: u16(offset + 8), resolution })
+    } else if (type === 0x00000006) { // enhanced packet block
+      const iface = interfaces[u32(offset + 8)]
+      if (iface) {
+        const ts = (BigInt(u32(offset + 12)) << 32n) | BigInt(u32(offset + 16))
+        const captured = u32(offset + 20)
+        const packet = data.subarray(offset + 28, offset + 28 + captured)
+        decode(packets, iface.linktype, packet, iface.resolution(ts))
+      }
+    } // simple packet blocks have no timestamp, and everything else is ignored
+
+    offset += length
+  }
+
+  return packets
+}
+
+/** Convert an "if_tsresol" value into a function converting to nanoseconds */
+function tsresol(value: number): (ts: bigint) => bigint {
+  const exponent = BigInt(value & 0x7f)
+  if (value & 0x80) return (ts) => ts * 1000000000n / (1n << exponent)
+  if (exponent <= 9n) return (ts) => ts * (10n ** (9n - exponent))
+  return (ts) => ts / (10n ** (exponent - 9n))
+}
+
+/** Decode the link layer, and the IP packet within it */
+function decode(packets: Packet[], linktype: number, frame: Buffer, time: bigint): void {
+  switch (linktype) {
+    case LINKTYPE_NULL: { // 4 bytes address family, in host byte order
+      if (frame.length < 4) return
+      return decodeIP(packets, frame.subarray(4), time)
+    }
+    case LINKTYPE_ETHERNET: {
+      let offset = 12
+      let ethertype = frame.length >= 14 ? frame.readUInt16BE(offset) : 0
+      while ((ethertype === 0x8100) || (ethertype === 0x88a8)) { // VLAN tags
+        offset += 4
+        ethertype = frame.length >= offset + 2 ? frame.readUInt16BE(offset) : 0
+      }
+      if ((ethertype !== 0x0800) && (ethertype !== 0x86dd)) return
+      return decodeIP(packets, frame.subarray(offset + 2), time)
+    }
+    case LINKTYPE_LINUX_SLL: {
+      if (frame.length < 16) return
+      return decodeIP(packets, frame.subarray(16), time)
+    }
+    case LINKTYPE_LINUX_SLL2: {
+      if (frame.length < 20) return
+      return decodeIP(packets, frame.subarray(20), time)
+    }
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+      return decodeIP(packets, frame, time)
+  }
+}
+
+function decodeIP(packets: Packet[], ip: Buffer, time: bigint): void {
+  if (ip.length < 1) return
+  const version = ip.readUInt8(0) >> 4
+
+  if ((version === 4) && (ip.length >= 20)) {
+    const header = (ip.readUInt8(0) & 0x0f) * 4
+    if (ip.readUInt8(9) !== 1) return // not ICMP
+    if (ip.readUInt16BE(6) & 0x3fff) return // fragmented
+
+    ip = ip.subarray(0, ip.readUInt16BE(2))
+    const icmp = ip.subarray(header)
+    if (icmp.length < 8) return
+    const type = icmp.readUInt8(0)
+    if ((type !== 0x08) && (type !== 0x00)) return
+
+    const request = type === 0x08
+    const target = [ ...ip.subarray(request ? 16 : 12, request ? 20 : 16) ].join('.')
+    packets.push({ target, v6: false, request, icmp, ip, time })
+  } else if ((version === 6) && (ip.length >= 40)) {
+    if (ip.readUInt8(6) !== 58) return // not ICMPv6 (or extension headers)
+
+    ip = ip.subarray(0, 40 + ip.readUInt16BE(4))
+    const icmp = ip.subarray(40)
+    if (icmp.length < 8) return
+    const type = icmp.readUInt8(0)
+    if ((type !== 0x80) && (type !== 0x81)) return
+
+    const request = type === 0x80
+    const target = ipv6(ip.subarray(request ? 24 : 8, request ? 40 : 24))
+    packets.push({ target, v6: true, request, icmp, ip, time })
+  }
+}
+
+/** Format an IPv6 address, compressing the longest run of zero groups */
+function ipv6(bytes: Buffer): string {
+  const groups: string[] = []
+  for (let i = 0; i < 16; i += 2) groups.push(bytes.readUInt16BE(i).toString(16))
+
+  let best = -1, length = 0
+  for (let i = 0; i < 8; i ++) {
+    let j = i
+    while ((j < 8) && (groups[j] === '0')) j ++
+    if ((j - i) > length) [ best, length ] = [ i, j - i ]
+  }
+
+  if (length < 2) return groups.join(':')
+  return `${groups.slice(0, best).join(':')}::${groups.slice(best + length).join(':')}`
+}
@@ -0,0 +1,221 @@
+/* ========================================================================== *
+ * ROLLUPS                                                                    *
+ * ========================================================================== *
+ *                                                                            *
+ * Pre-aggregated records emitted once per target per window, where windows   *
+ * are aligned to wall-clock boundaries (e.g. every 10 seconds at :00, :10,   *
+ * :20, ... or every minute at :00).                                          *
+ *                                                                            *
+ * Records are produced by a constant-memory accumulator (counters and a      *
+ * fixed-size histogram), which is reset at every window boundary.            *
+ *                                                                            *
+ * ========================================================================== */
+
+import { Histogram } from './histogram'
+
+import type { HistogramState } from './histogram'
+
+/** An aggregate record for a single target over a single window */
+export interface PingerRollup {
+  /** The target IP address */
+  target: string,
+  /** The start of the window (milliseconds since the epoch) */
+  start: number,
+  /** The end of the window (milliseconds since the epoch) */
+  end: number,
+  /** The number of ECHO Requests sent during the window */
+  sent: number,
+  /** The number of ECHO Replies received during the window */
+  received: number,
+  /** The number of ECHO Requests timed out during the window */
+  lost: number,
+  /** The ratio (0...1) of lost packets over received + lost, or `NaN` */
+  loss: number,
+  /** The minimum latency (in milliseconds) or `NaN` */
+  min: number,
+  /** The maximum latency (in milliseconds) or `NaN` */
+  max: number,
+  /** The average latency (in milliseconds) or `NaN` */
+  avg: number,
+  /** The 50th percentile latency (in milliseconds) or `NaN` */
+  p50: number,
+  /** The 90th percentile latency (in milliseconds) or `NaN` */
+  p90: number,
+  /** The 95th percentile latency (in milliseconds) or `NaN` */
+  p95: number,
+  /** The 99th percentile latency (in milliseconds) or `NaN` */
+  p99: number,
+  /** The mean absolute difference between consecutive latencies or `NaN` */
+  jitter: number,
+}
+
+/** The state of a {@link RollupAccumulator}, to be saved and restored */
+export interface RollupState {
+  /** Counters, extremes and jitter (in a fixed order) */
+  values: number[],
+  histogram: HistogramState,
+}
+
+/** The minimum rollup window (1 second) */
+const MIN_WINDOW = 1000
+
+/** Validate a rollup window, in milliseconds */
+export function checkWindow(window: number): number {
+  if ((! Number.isInteger(window)) || (window < MIN_WINDOW)) {
+    throw new Error(`Invalid rollup window ${window} (must be an integer >= ${MIN_WINDOW} ms)`)
+  }
+  return window
+}
+
+/** Return the end of the window (wall-clock aligned) containing `now` */
+export function windowEnd(window: number, now: number = Date.now()): number {
+  return (Math.floor(now / window) + 1) * window
+}
+
+export class RollupAccumulator {
+  private readonly __histogram: Histogram = new Histogram()
+  private __sent: number = 0
+  private __received: number = 0
+  private __lost: number = 0
+  private __min: number = Infinity
+  private __max: number = -Infinity
+  private __sum: number = 0
+  private __jitter: number = 0
+  private __jitter_n: number = 0
+  private __last: number = NaN
+
+  /** The histogram used to compute percentiles */
+  get histogram(): Histogram {
+    return this.__histogram
+  }
+
+  sent(): void {
+    this.__sent ++
+  }
+
+  lost(count: number): void {
+    this.__lost += count
+  }
+
+  received(latency: number): void {
+    this.__received ++
+    this.__sum += latency
+    if (latency < this.__min) this.__min = latency
+    if (latency > this.__max) this.__max = latency
+    this.__histogram.record(latency)
+
+    // Jitter carries over between windows, so the first sample in a window
+    // is still compared with the last one in the previous window
+    if (! isNaN(this.__last)) {
+      this.__jitter += Math.abs(latency - this.__last)
+      this.__jitter_n ++
+    }
+    this.__last = latency
+  }
+
+  /** Save the window accumulated so far */
+  save(): RollupState {
+    return {
+      values: [
+        this.__sent, this.__received, this.__lost,
+        this.__min, this.__max, this.__sum,
+        this.__jitter, this.__jitter_n, this.__last,
+      ],
+      histogram: this.__histogram.save(),
+    }
+  }
+
+  /** Restore a window accumulated by another accumulator */
+  restore(state: RollupState): void {
+    const { values, histogram } = state
+    if (values.length !== 9) throw new Error(`Invalid rollup state (length=${values.length})`)
+
+    this.__histogram.restore(histogram)
+    ;[
+      this.__sent, this.__received, this.__lost,
+      this.__min, this.__max, this.__sum,
+      this.__jitter, this.__jitter_n, this.__last,
+    ] = values
+  }
+
+  /** Produce a record for the window, and reset for the next one */
+  rollup(target: string, start: number, end: number): PingerRollup {
+    const received = this.__received
+    const lost = this.__lost
+    const empty = received < 1
+
+    // Percentiles are clamped to the exact min/max values we have
+    const percentile = (p: number): number => empty ? NaN :
+      Math.min(this.__max, Math.max(this.__min, this.__histogram.percentile(p)))
+
+    const rollup: PingerRollup = {
+      target,
+      start,
+      end,
+      sent: this.__sent,
+      received,
+      lost,
+      loss: (received + lost) < 1 ? NaN : lost / (received + lost),
+      min: empty ? NaN : this.__min,
+      max: empty ? NaN : this.__max,
+      avg: empty ? NaN : this.__sum / received,
+      p50: percentile(50),
+      p90: percentile(90),
+      p95: percentile(95),
+      p99: percentile(99),
+      jitter: this.__jitter_n < 1 ? NaN : this.__jitter / this.__jitter_n,
+    }
+
+    this.__histogram.reset()
+    this.__sent = this.__received = this.__lost = 0
+    this.__min = Infinity
+    this.__max = -Infinity
+    this.__sum = this.__jitter = this.__jitter_n = 0
+
+    return rollup
+  }
+}
+
+/**
+ * A timer invoking its callback at every wall-clock aligned window boundary,
+ * with the start and end of the window that just completed.
+ *
+ * The first window starts when the timer is started (so it's likely to be
+ * shorter than the others), and stopping the timer flushes the last window.
+ */
+export class RollupTimer {
+  private __timer?: NodeJS.Timeout
+  private __start: number = 0
+
+  constructor(
+      private readonly __window: number,
+      private readonly __callback: (start: number, end: number) => void,
+  ) {}
+
+  get running(): boolean {
+    return !! this.__timer
+  }
+
+  start(): void {
+    if (this.__timer) return
+    this.__start = Date.now()
+    this.__schedule(this.__start)
+  }
+
+  stop(): void {
+    if (! this.__timer) return
+    clearTimeout(this.__timer)
+    this.__timer = undefined
+    this.__callback(this.__start, Date.now())
+  }
+
+  private __schedule(now: number): void {
+    const end = windowEnd(this.__window, now)
+    this.__timer = setTimeout(() => {
+      const start = this.__start
+      this.__start = end
+      this.__schedule(Math.max(Date.now(), end))
+      this.__callback(start, end)
+    }, end - Date.now()).unref()
+  }
+}
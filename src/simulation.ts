@@ -0,0 +1,232 @@
+/* ========================================================================== *
+ * SIMULATION                                                                 *
+ * ========================================================================== *
+ *                                                                            *
+ * Runs a registry (its scheduler, packets and validation, all unchanged), or *
+ * one `Pinger` per target, against a virtual clock and a simulated network,  *
+ * with no sockets, as fast as possible and deterministically (given the same *
+ * seed).                                                                     *
+ *                                                                            *
+ * The network delivers each ECHO Request back as its ECHO Reply after a      *
+ * latency of `latency` plus an exponentially distributed `jitter`, unless    *
+ * lost (with probability `loss`). Replies later than the timeout are dealt   *
+ * with by the registry (or pingers) themselves, exactly as they would live.  *
+ *                                                                            *
+ * Pacing is verified by tracking the largest number of requests sent at the  *
+ * same (virtual) instant: a registry never exceeds one slot's worth, while   *
+ * pingers started together all send at the same instant.                     *
+ *                                                                            *
+ * Pingers are driven by their timers and replies only: their rollups (and    *
+ * other wall-clock timestamps), bursts and floods still use real time.       *
+ *                                                                            *
+ * ========================================================================== */
+
+import { VirtualClock } from './clock'
+import { ChangeDetector } from './detector'
+import { PingerImpl } from './pinger'
+import { PingerRegistryImpl } from './registry'
+
+import type { PingerConnector } from './pinger'
+import type { RegistryTransport } from './registry'
+
+/** Options for a simulation */
+export interface SimulationOptions {
+  /** The number of targets to simulate (default: 1000, at most 16777216) */
+  targets?: number,
+  /** The (virtual) duration of the simulation **in milliseconds** (default: 60000) */
+  duration?: number,
+  /** The interval **in milliseconds** used to ping all targets (default: 1000) */
+  interval?: number,
+  /** The timeout **in milliseconds** after which a packet is considered _lost_ (default: 1000) */
+  timeout?: number,
+  /** The base latency of the network **in milliseconds** (default: 10) */
+  latency?: number,
+  /** The average jitter added to the latency **in milliseconds** (default: 1) */
+  jitter?: number,
+  /** The ratio (0...1) of requests lost by the network (default: 0) */
+  loss?: number,
+  /** The seed of the network's random numbers (default: 1) */
+  seed?: number,
+  /** Whether to simulate one `Pinger` per target rather than a registry (default: false, at most 65536 targets) */
+  pingers?: boolean,
+}
+
+/** The outcome of a simulation */
+export interface PingerSimulation {
+  /** The number of targets simulated */
+  targets: number,
+  /** The number of ECHO Requests sent */
+  sent: number,
+  /** The number of ECHO Replies accepted */
+  received: number,
+  /** The number of ECHO Requests not answered (lost, or timed out) */
+  lost: number,
+  /** The average latency (in milliseconds) of the replies accepted */
+  latency: number,
+  /** Replies rejected by the registry, by warning code */
+  warnings: Record<string, number>,
+  /** The largest number of ECHO Requests sent at the same instant */
+  burst: number,
+  /** The number of (virtual) events run: timer ticks and replies */
+  events: number,
+  /** The real time **in milliseconds** taken by the simulation */
+  elapsed: number,
+  /** How much faster than real time the simulation ran */
+  speedup: number,
+}
+
+/** A small, fast, seeded PRNG (mulberry32) returning numbers in [0, 1) */
+function random(seed: number): () => number {
+  let state = seed >>> 0
+  return () => {
+    state = (state + 0x6d2b79f5) >>> 0
+    let value = Math.imul(state ^ (state >>> 15), state | 1)
+    value ^= value + Math.imul(value ^ (value >>> 7), value | 61)
+    return ((value ^ (value >>> 14)) >>> 0) / 4294967296
+  }
+}
+
+/** Validate a numeric simulation option */
+function check(name: string, value: number, valid: boolean): void {
+  if (! valid) throw new Error(`Invalid simulation ${name} ${value}`)
+}
+
+/** Simulate a registry (or pingers) pinging `targets` for `duration` (virtual) milliseconds */
+export async function simulate(options: SimulationOptions = {}): Promise<PingerSimulation> {
+  const {
+    targets = 1000,
+    duration = 60000,
+    interval = 1000,
+    timeout = 1000,
+    latency = 10,
+    jitter = 1,
+    loss = 0,
+    seed = 1,
+    pingers = false,
+  } = options
+
+  check('targets', targets, Number.isInteger(targets) && (targets >= 1) && (targets <= (pingers ? 0x10000 : 0x1000000)))
+  check('duration', duration, Number.isFinite(duration) && (duration > 0))
+  check('interval', interval, Number.isFinite(interval) && (interval > 0))
+  check('timeout', timeout, Number.isFinite(timeout) && (timeout > 0))
+  check('latency', latency, Number.isFinite(latency) && (latency >= 0))
+  check('jitter', jitter, Number.isFinite(jitter) && (jitter >= 0))
+  check('loss', loss, (loss >= 0) && (loss <= 1))
+
+  const clock = new VirtualClock()
+  const next = random(seed)
+  let burst = 0
+  let instant = -1
+  let count = 0
+
+  // The simulated network: send back replies (or lose requests)
+  const deliver = (buffer: Buffer, target: string, receive: (buffer: Buffer, address: string) => void): void => {
+    // Track how many requests are sent at the same instant
+    if (clock.time === instant) {
+      burst = Math.max(burst, ++ count)
+    } else {
+      instant = clock.time
+      burst = Math.max(burst, count = 1)
+    }
+
+    if (next() < loss) return
+    const delay = (latency - Math.log(1 - next()) * jitter) * 1000000
+    clock.schedule(Math.round(delay), () => {
+      buffer.writeUInt8(buffer.readUInt8(0) === 0x08 ? 0x00 : 0x81, 0) // ECHO Reply
+      receive(buffer, target)
+    })
+  }
+
+  const warnings: Record<string, number> = {}
+  const warning = (code: string): void => void (warnings[code] = (warnings[code] || 0) + 1)
+  const address = (i: number): string => `10.${(i >> 16) & 0xff}.${(i >> 8) & 0xff}.${i & 0xff}`
+
+  let sent = 0
+  let received = 0
+  let total = 0
+  let events = 0
+  let elapsed = 0
+
+  if (pingers) {
+    // Sockets on the simulated network, calling back (like `dgram`) after sending
+    const connector: PingerConnector = {
+      connect: (_protocol, _fd, receive, bound) => {
+        bound()
+        return {
+          send: (buffer, _port, target, callback): void => {
+            deliver(buffer, target, receive)
+            clock.schedule(0, () => callback(null))
+          },
+          close: (callback): void => callback?.(),
+          on: (): void => void 0,
+          removeAllListeners: (): void => void 0,
+          getRecvBufferSize: (): number => 0,
+          getSendBufferSize: (): number => 0,
+        }
+      },
+      stamp: (): undefined => undefined,
+    }
+
+    const simulated: PingerImpl[] = []
+    for (let i = 0; i < targets; i ++) {
+      const pinger = new PingerImpl(undefined, undefined, address(i), timeout, interval, 'ipv4', i, undefined,
+          new ChangeDetector(), undefined, undefined, undefined, undefined, undefined, undefined, clock, connector)
+      pinger.on('warning', warning)
+      simulated.push(pinger)
+    }
+
+    // Ping for our duration, then let all replies in flight arrive
+    const start = process.hrtime.bigint()
+    for (const pinger of simulated) pinger.start()
+    events += clock.run(duration * 1000000)
+    for (const pinger of simulated) pinger.stop()
+    events += clock.run(Number.MAX_SAFE_INTEGER)
+    elapsed = Number(process.hrtime.bigint() - start) / 1000000
+
+    for (const pinger of simulated) {
+      const stats = pinger.stats()
+      sent += stats.sent
+      received += stats.received
+      if (stats.received) total += stats.latency * stats.received
+    }
+    await Promise.all(simulated.map((pinger) => pinger.close()))
+  } else {
+    const connect = (receive: (buffer: Buffer, address: string) => void): RegistryTransport => ({
+      send: (buffer, target): void => deliver(buffer, target, receive),
+      close: (callback): void => callback(),
+    })
+
+    const registry = new PingerRegistryImpl('ipv4', timeout, interval, undefined, connect, clock)
+    registry.on('warning', (_, code) => warning(code))
+    for (let i = 0; i < targets; i ++) registry.add(address(i))
+
+    // Ping for our duration, then let all replies in flight arrive
+    const start = process.hrtime.bigint()
+    registry.start()
+    events += clock.run(duration * 1000000)
+    registry.stop()
+    events += clock.run(Number.MAX_SAFE_INTEGER)
+    elapsed = Number(process.hrtime.bigint() - start) / 1000000
+
+    for (let id = 0; id < targets; id ++) {
+      const stats = registry.stats(id)!
+      sent += stats.sent
+      received += stats.received
+      if (stats.received) total += stats.latency * stats.received
+    }
+    await registry.close()
+  }
+
+  return {
+    targets,
+    sent,
+    received,
+    lost: sent - received,
+    latency: received ? total / received : NaN,
+    warnings,
+    burst,
+    events,
+    elapsed,
+    speedup: duration / elapsed,
+  }
+}
@@ -0,0 +1,330 @@
+/* ========================================================================== *
+ * BINARY RESULT SINK                                                         *
+ * ========================================================================== *
+ *                                                                            *
+ * Streams results (pongs) and rollups of pingers and groups to another local *
+ * process over a UNIX domain socket, as compact length-prefixed frames:      *
+ *                                                                            *
+ *                      +----------+------+---------+                         *
+ *                      | LENGTH   | TYPE | PAYLOAD |                         *
+ *                      | (u32)    | (u8) |         |                         *
+ *                      +----------+------+---------+                         *
+ *                                                                            *
+ * The length covers type and payload. Targets are sent once (per connection) *
+ * in a TARGET frame assigning them an id, and referred to by id afterwards:  *
+ *                                                                            *
+ * - TARGET (1): id (u32), target (u16 length, UTF-8)                         *
+ * - PONG   (2): id (u32), time (f64, ms since the epoch), latency (f64, ms)  *
+ * - ROLLUP (3): id (u32), start and end (f64, ms since the epoch), sent,     *
+ *               received and lost (u32), loss, min, max, avg, p50, p90, p95, *
+ *               p99 and jitter (f64)                                         *
+ *                                                                            *
+ * All integers are big endian. Frames are appended to a buffer and written   *
+ * in batches (once per tick, or as soon as a batch is full). When the socket *
+ * can't keep up, frames are buffered up to a limit, and dropped (counted) in *
+ * excess, so that a slow consumer never slows down (nor grows) the pingers.  *
+ *                                                                            *
+ * ========================================================================== */
+
+import { EventEmitter } from 'node:events'
+import { createConnection } from 'node:net'
+
+import { wallClock } from './capture'
+
+import type { Socket } from 'node:net'
+import type { PingerGroup } from './group'
+import type { Pinger } from './pinger'
+import type { PingerRollup } from './rollup'
+
+/* Frame types */
+export const FRAME_TARGET = 1
+export const FRAME_PONG = 2
+export const FRAME_ROLLUP = 3
+
+/** Options to create a {@link ResultSink} */
+export interface ResultSinkOptions {
+  /** The size **in bytes** of a batch, written as soon as full (default: 64 KiB) */
+  batch?: number,
+  /** The bytes buffered while the socket can't keep up, before dropping (default: 4 MiB) */
+  limit?: number,
+}
+
+/** A frame decoded by {@link decodeFrames} */
+export type ResultFrame =
+  | { type: 'target', id: number, target: string }
+  | { type: 'pong', id: number, time: number, latency: number }
+  | { type: 'rollup', id: number, rollup: Omit<PingerRollup, 'target'> }
+
+/** Streams results and rollups to a UNIX domain socket */
+export interface ResultSink {
+  /** The number of frames dropped because the socket couldn't keep up */
+  readonly dropped: number
+  /** The number of bytes waiting to be written */
+  readonly pending: number
+  /** A flag indicating whether this sink was _closed_ */
+  readonly closed: boolean
+
+  /** Stream the results and rollups of a pinger or group, returning a function detaching it */
+  attach(source: Pinger | PingerGroup): () => void
+  /** Write all pending frames and close the socket */
+  close(): Promise<void>
+
+  on(event: 'error', handler: (error: Error) => void): void
+  off(event: 'error', handler: (error: Error) => void): void
+  once(event: 'error', handler: (error: Error) => void): void
+}
+
+/** Connect a new {@link ResultSink} to the UNIX domain socket at `path` */
+export function createResultSink(path: string, options: ResultSinkOptions = {}): Promise<ResultSink> {
+  const { batch = 65536, limit = 4194304 } = options
+  if (!(Number.isInteger(batch) && batch >= 256)) throw new Error(`Invalid sink batch size ${batch}`)
+  if (!(Number.isInteger(limit) && limit >= batch)) throw new Error(`Invalid sink limit ${limit}`)
+
+  return new Promise((resolve, reject) => {
+    const socket = createConnection({ path })
+    socket.once('error', reject)
+    socket.once('connect', () => {
+      socket.off('error', reject)
+      resolve(new ResultSinkImpl(socket, batch, limit))
+    })
+  })
+}
+
+export class ResultSinkImpl extends EventEmitter implements ResultSink {
+  private readonly __targets = new Map<string, number>()
+  private __buffer: Buffer
+  private __offset: number = 0
+  private __dropped: number = 0
+  private __scheduled: boolean = false
+  private __draining: boolean = false
+  private __closed: boolean = false
+
+  constructor(
+      private readonly __socket: Socket,
+      private readonly __batch: number,
+      private readonly __limit: number,
+  ) {
+    super()
+    this.__buffer = Buffer.allocUnsafe(__batch)
+
+    __socket.on('drain', () => {
+      this.__draining = false
+      this.__flush()
+    })
+    __socket.on('error', (error) => this.emit('error', error))
+    __socket.on('close', () => this.__closed = true)
+  }
+
+  get dropped(): number {
+    return this.__dropped
+  }
+
+  get pending(): number {
+    return this.__offset + this.__socket.writableLength
+  }
+
+  get closed(): boolean {
+    return this.__closed
+  }
+
+  // wrap "emit" so that "error" events won't throw when no listeners are there
+  emit(eventName: 'error', ...args: any[]): boolean {
+    if (this.listenerCount(eventName) < 1) return false
+    return super.emit(eventName, ...args)
+  }
+
+  attach(source: Pinger | PingerGroup): () => void {
+    if ('entries' in source) {
+      const group = source as PingerGroup
+      const pong = (pinger: Pinger, latency: number): void => this.pong(pinger.target, latency)
+      const rollup = (_: Pinger, rollup: PingerRollup): void => this.rollup(rollup)
+      group.on('pong', pong)
+      group.on('rollup', rollup)
+      return () => {
+        group.off('pong', pong)
+        group.off('rollup', rollup)
+      }
+    }
+
+    const pinger = source as Pinger
+    const pong = (latency: number): void => this.pong(pinger.target, latency)
+    const rollup = (rollup: PingerRollup): void => this.rollup(rollup)
+    pinger.on('pong', pong)
+    pinger.on('rollup', rollup)
+    return () => {
+      pinger.off('pong', pong)
+      pinger.off('rollup', rollup)
+    }
+  }
+
+  /** Write a PONG frame (and the TARGET frame, if needed) */
+  pong(target: string, latency: number, time: number = wallClock()): void {
+    const id = this.__target(target)
+    if (id < 0) return
+    const offset = this.__frame(FRAME_PONG, 20)
+    if (offset < 0) return
+
+    this.__buffer.writeUInt32BE(id, offset)
+    this.__buffer.writeDoubleBE(time, offset + 4)
+    this.__buffer.writeDoubleBE(latency, offset + 12)
+  }
+
+  /** Write a ROLLUP frame (and the TARGET frame, if needed) */
+  rollup(rollup: PingerRollup): void {
+    const id = this.__target(rollup.target)
+    if (id < 0) return
+    let offset = this.__frame(FRAME_ROLLUP, 4 + 2 * 8 + 3 * 4 + 9 * 8)
+    if (offset < 0) return
+
+    offset = this.__buffer.writeUInt32BE(id, offset)
+    offset = this.__buffer.writeDoubleBE(rollup.start, offset)
+    offset = this.__buffer.writeDoubleBE(rollup.end, offset)
+    offset = this.__buffer.writeUInt32BE(rollup.sent, offset)
+    offset = this.__buffer.writeUInt32BE(rollup.received, offset)
+    offset = this.__buffer.writeUInt32BE(rollup.lost, offset)
+    for (const value of [
+      rollup.loss, rollup.min, rollup.max, rollup.avg,
+      rollup.p50, rollup.p90, rollup.p95, rollup.p99,
+      rollup.jitter,
+    ]) offset = this.__buffer.writeDoubleBE(value, offset)
+  }
+
+  close(): Promise<void> {
+    return new Promise((resolve) => {
+      if (this.__closed) return resolve()
+      this.__closed = true
+
+      // Whatever is still in our buffer is written before ending
+      if (this.__offset > 0) this.__socket.write(this.__buffer.subarray(0, this.__offset))
+      this.__offset = 0
+      this.__socket.end(resolve)
+    })
+  }
+
+  /** Return the id of a target, writing its TARGET frame the first time */
+  private __target(target: string): number {
+    const id = this.__targets.get(target)
+    if (id !== undefined) return id
+
+    const name = Buffer.from(target, 'utf8')
+    const offset = this.__frame(FRAME_TARGET, 6 + name.length)
+    if (offset < 0) return -1
+
+    const next = this.__targets.size
+    this.__buffer.writeUInt32BE(next, offset)
+    this.__buffer.writeUInt16BE(name.length, offset + 4)
+    name.copy(this.__buffer, offset + 6)
+    this.__targets.set(target, next)
+    return next
+  }
+
+  /**
+   * Reserve a frame with a payload of `length` bytes, writing its header and
+   * returning the offset of its payload, or -1 if the frame was dropped.
+   */
+  private __frame(type: number, length: number): number {
+    if (this.__closed) return -1
+
+    // Too much pending, the consumer can't keep up: drop
+    const size = length + 5
+    if ((this.__socket.writableLength + this.__offset + size) > this.__limit) {
+      this.__dropped ++
+      return -1
+    }
+
+    // Full batch, write it out (or grow, if the socket is not draining)
+    if ((this.__offset + size) > this.__buffer.length) {
+      if (this.__draining) this.__grow(this.__offset + size)
+      else this.__flush()
+    }
+
+    const offset = this.__offset
+    this.__buffer.writeUInt32BE(length + 1, offset)
+    this.__buffer.writeUInt8(type, offset + 4)
+    this.__offset += size
+
+    // Write at the end of this tick, all frames produced in it together
+    if (! this.__scheduled) {
+      this.__scheduled = true
+      setImmediate(() => {
+        this.__scheduled = false
+        this.__flush()
+      })
+    }
+
+    return offset + 5
+  }
+
+  /** Write our buffer to the socket, unless waiting for it to drain */
+  private __flush(): void {
+    if (this.__draining || this.__closed || (this.__offset === 0)) return
+
+    const data = this.__buffer.subarray(0, this.__offset)
+    this.__buffer = Buffer.allocUnsafe(this.__batch) // the socket owns "data" now
+    this.__offset = 0
+
+    if (! this.__socket.write(data)) this.__draining = true
+  }
+
+  /** Grow our buffer (while the socket is draining) to hold `size` bytes */
+  private __grow(size: number): void {
+    let length = this.__buffer.length * 2
+    while (length < size) length *= 2
+
+    const buffer = Buffer.allocUnsafe(length)
+    this.__buffer.copy(buffer, 0, 0, this.__offset)
+    this.__buffer = buffer
+  }
+}
+
+/**
+ * Decode all complete frames in a buffer (as read from the socket), returning
+ * them and the number of bytes consumed (any remainder is a partial frame).
+ */
+export function decodeFrames(buffer: Buffer): { frames: ResultFrame[], consumed: number } {
+  const frames: ResultFrame[] = []
+  let offset = 0
+
+  while ((offset + 4) <= buffer.length) {
+    const length = buffer.readUInt32BE(offset)
+    if ((offset + 4 + length) > buffer.length) break
+
+    const type = buffer.readUInt8(offset + 4)
+    const payload = offset + 5
+    offset += 4 + length
+
+    if (type === FRAME_TARGET) {
+      const size = buffer.readUInt16BE(payload + 4)
+      const target = buffer.toString('utf8', payload + 6, payload + 6 + size)
+      frames.push({ type: 'target', id: buffer.readUInt32BE(payload), target })
+    } else if (type === FRAME_PONG) {
+      frames.push({
+        type: 'pong',
+        id: buffer.readUInt32BE(payload),
+        time: buffer.readDoubleBE(payload + 4),
+        latency: buffer.readDoubleBE(payload + 12),
+      })
+    } else if (type === FRAME_ROLLUP) {
+      const f64 = (index: number): number => buffer.readDoubleBE(payload + 32 + index * 8)
+      frames.push({ type: 'rollup', id: buffer.readUInt32BE(payload), rollup: {
+        start: buffer.readDoubleBE(payload + 4),
+        end: buffer.readDoubleBE(payload + 12),
+        sent: buffer.readUInt32BE(payload + 20),
+        received: buffer.readUInt32BE(payload + 24),
+        lost: buffer.readUInt32BE(payload + 28),
+        loss: f64(0),
+        min: f64(1),
+        max: f64(2),
+        avg: f64(3),
+        p50: f64(4),
+        p90: f64(5),
+        p95: f64(6),
+        p99: f64(7),
+        jitter: f64(8),
+      } })
+    }
+    // unknown frame types are skipped, for forward compatibility
+  }
+
+  return { frames, consumed: offset }
+}
@@ -0,0 +1,229 @@
+/* ========================================================================== *
+ * SOAK BENCHMARK                                                             *
+ * ========================================================================== *
+ *                                                                            *
+ * Runs a (large) group of pingers against the local responder (every address *
+ * in `127.0.0.0/8` answers on loopback) for a long time, periodically        *
+ * sampling heap and RSS sizes, event loop delay and garbage collections, in  *
+ * order to catch slow leaks (listeners, buffers, timers) before production.  *
+ *                                                                            *
+ * GC pauses are observed with `perf_hooks` and recorded in a histogram, the  *
+ * event loop delay is sampled by `monitorEventLoopDelay` (reset every time   *
+ * it is sampled).                                                            *
+ *                                                                            *
+ * Drift is detected on the _minimum_ of each quarter of the samples (after   *
+ * a warm up), as garbage collected heaps go up and down: a leak shows up as  *
+ * a baseline steadily going up, rather than as a single high sample.         *
+ *                                                                            *
+ * ========================================================================== */
+
+import { monitorEventLoopDelay, PerformanceObserver } from 'node:perf_hooks'
+
+import { createPingerGroup } from './group'
+import { Histogram } from './histogram'
+
+/** Options for a soak benchmark */
+export interface SoakOptions {
+  /** The number of pingers in the fleet (default: 100) */
+  pingers?: number,
+  /** The interval **in milliseconds** used by each pinger (default: 100) */
+  interval?: number,
+  /** The duration **in milliseconds** of the benchmark (default: 60000) */
+  duration?: number,
+  /** How often **in milliseconds** memory and delays are sampled (default: 1000) */
+  sample?: number,
+  /** The ratio of growth of the baseline flagged as drift (default: 0.05) */
+  threshold?: number,
+  /** A callback invoked with every sample, as soon as taken */
+  onSample?: (sample: SoakSample) => void,
+}
+
+/** A sample of memory and delays taken during a soak benchmark */
+export interface SoakSample {
+  /** The time **in milliseconds** since the benchmark started */
+  time: number,
+  /** The bytes of the V8 heap in use */
+  heap: number,
+  /** The resident set size of the process, in bytes */
+  rss: number,
+  /** The bytes of memory used outside of the V8 heap (buffers included) */
+  external: number,
+  /** The mean event loop delay (in milliseconds) since the last sample */
+  delay: number,
+  /** The 99th percentile event loop delay (in milliseconds) since the last sample */
+  delayP99: number,
+  /** The maximum event loop delay (in milliseconds) since the last sample */
+  delayMax: number,
+  /** The number of garbage collections since the last sample */
+  gcs: number,
+  /** The time **in milliseconds** spent collecting garbage since the last sample */
+  gcTime: number,
+}
+
+/** The drift detected in a series of samples */
+export interface SoakDrift {
+  /** The growth rate (linear regression) per hour, in the unit of the samples */
+  slope: number,
+  /** The minimum of each quarter of the samples (after the warm up) */
+  baselines: number[],
+  /** Whether baselines grew monotonically, and by more than the threshold */
+  growing: boolean,
+}
+
+/** The outcome of a soak benchmark */
+export interface PingerSoak {
+  /** The number of ECHO Requests sent by the fleet */
+  sent: number,
+  /** The number of ECHO Replies received by the fleet */
+  received: number,
+  /** All samples taken, in order */
+  samples: SoakSample[],
+  /** Garbage collection pauses (in milliseconds) */
+  gc: { count: number, total: number, p50: number, p99: number, max: number },
+  /** Drift of the heap and the resident set size */
+  drift: { heap: SoakDrift, rss: SoakDrift, external: SoakDrift },
+}
+
+/** The ratio of the samples considered warm up (not checked for drift) */
+const WARM_UP = 0.2
+
+/** Detect drift in a series of values taken at the specified times (in ms) */
+export function drift(times: number[], values: number[], threshold: number = 0.05): SoakDrift {
+  const skip = Math.floor(values.length * WARM_UP)
+  const x = times.slice(skip)
+  const y = values.slice(skip)
+  if (y.length < 4) return { slope: NaN, baselines: [], growing: false }
+
+  // Least squares slope, per hour
+  const mx = x.reduce((a, b) => a + b, 0) / x.length
+  const my = y.reduce((a, b) => a + b, 0) / y.length
+  let numerator = 0
+  let denominator = 0
+  for (let i = 0; i < x.length; i ++) {
+    numerator += (x[i]! - mx) * (y[i]! - my)
+    denominator += (x[i]! - mx) * (x[i]! - mx)
+  }
+  const slope = denominator ? numerator / denominator * 3600000 : 0
+
+  // Baselines: the minimum of each quarter
+  const baselines: number[] = []
+  for (let quarter = 0; quarter < 4; quarter ++) {
+    const from = Math.floor(y.length * quarter / 4)
+    const to = Math.floor(y.length * (quarter + 1) / 4)
+    baselines.push(Math.min(...y.slice(from, to)))
+  }
+
+  const monotonic = baselines.every((value, i) => (i === 0) || (value > baselines[i - 1]!))
+  const growing = monotonic && ((baselines[3]! - baselines[0]!) > (Math.abs(baselines[0]!) * threshold))
+  return { slope, baselines, growing }
+}
+
+/** Run a fleet of pingers against the local responder, sampling memory and delays */
+export async function soak(options: SoakOptions = {}): Promise<PingerSoak> {
+  const {
+    pingers = 100,
+    interval = 100,
+    duration = 60000,
+    sample = 1000,
+    threshold = 0.05,
+    onSample,
+  } = options
+
+  if (!(Number.isInteger(pingers) && (pingers >= 1) && (pingers < 0xffffff))) {
+    throw new Error(`Invalid soak pingers ${pingers}`)
+  }
+  if (!(duration > 0)) throw new Error(`Invalid soak duration ${duration}`)
+  if (!(sample > 0)) throw new Error(`Invalid soak sample ${sample}`)
+
+  // Observe garbage collections
+  const pauses = new Histogram()
+  let gcs = 0
+  let gcTime = 0
+  let gcMax = 0
+  let gcTotal = 0
+  const observer = new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+      pauses.record(entry.duration)
+      gcs ++
+      gcTime += entry.duration
+      gcTotal += entry.duration
+      gcMax = Math.max(gcMax, entry.duration)
+    }
+  })
+  observer.observe({ entryTypes: [ 'gc' ] })
+
+  const delays = monitorEventLoopDelay({ resolution: 10 })
+  delays.enable()
+
+  const group = createPingerGroup({ interval })
+  const samples: SoakSample[] = []
+  let sent = 0
+  let received = 0
+
+  try {
+    // Every address in 127.0.0.0/8 is answered by the local responder
+    for (let i = 1; i <= pingers; i ++) {
+      await group.add(`127.${(i >> 16) & 0xff}.${(i >> 8) & 0xff}.${i & 0xff}`)
+    }
+
+    const start = process.hrtime.bigint()
+    group.start()
+
+    await new Promise<void>((resolve) => {
+      const timer = setInterval(() => {
+        // Collect (and reset) statistics, like a long-lived process would
+        for (const stats of Object.values(group.stats())) {
+          sent += stats.sent
+          received += stats.received
+        }
+
+        const time = Number(process.hrtime.bigint() - start) / 1000000
+        const { heapUsed, rss, external } = process.memoryUsage()
+        const current: SoakSample = {
+          time,
+          heap: heapUsed,
+          rss,
+          external,
+          delay: delays.count ? delays.mean / 1000000 : 0,
+          delayP99: delays.count ? delays.percentile(99) / 1000000 : 0,
+          delayMax: delays.count ? delays.max / 1000000 : 0,
+          gcs,
+          gcTime,
+        }
+        delays.reset()
+        gcs = gcTime = 0
+
+        samples.push(current)
+        onSample?.(current)
+
+        if (time >= duration) {
+          clearInterval(timer)
+          resolve()
+        }
+      }, sample)
+    })
+  } finally {
+    observer.disconnect()
+    delays.disable()
+    await group.close()
+  }
+
+  const times = samples.map(({ time }) => time)
+  return {
+    sent,
+    received,
+    samples,
+    gc: {
+      count: pauses.count,
+      total: gcTotal,
+      p50: pauses.percentile(50),
+      p99: pauses.percentile(99),
+      max: gcMax,
+    },
+    drift: {
+      heap: drift(times, samples.map(({ heap }) => heap), threshold),
+      rss: drift(times, samples.map(({ rss }) => rss), threshold),
+      external: drift(times, samples.map(({ external }) => external), threshold),
+    },
+  }
+}
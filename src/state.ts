@@ -0,0 +1,356 @@
+/* ========================================================================== *
+ * PINGER STATE ENCODING                                                      *
+ * ========================================================================== *
+ *                                                                            *
+ * A compact binary encoding for the state of pingers, used when handing off  *
+ * sockets to another process and when checkpointing a group to a file.       *
+ *                                                                            *
+ *                 +-------------+---------+-------+------------+             *
+ *                 | MAGIC "JPST"| VERSION | COUNT | PINGERS... |             *
+ *                 | (4 bytes)   | (u16)   | (u32) |            |             *
+ *                 +-------------+---------+-------+------------+             *
+ *                                                                            *
+ * Each pinger starts with its configuration (key, target, protocol, ...)     *
+ * followed by a list of _sections_ (tag, length, data) terminated by a zero  *
+ * tag. Readers skip sections with tags they don't know, so that new kinds of *
+ * state can be added without breaking older readers.                         *
+ *                                                                            *
+ * All integers are big endian, strings are UTF-8 prefixed by their length.   *
+ *                                                                            *
+ * ========================================================================== */
+
+import type { PingerOptions } from './pinger'
+import type { HandlerState } from './protocol'
+import type { RollupState } from './rollup'
+
+/** The magic number at the start of our encoded state */
+const MAGIC = 0x4a505354 // "JPST"
+/** The current version of our encoding */
+const VERSION = 1
+
+/* Section tags */
+const SECTION_END = 0
+const SECTION_HANDLER = 1
+const SECTION_STATS = 2
+const SECTION_DETECTOR = 3
+const SECTION_LOSSES = 4
+const SECTION_ROLLUP = 5
+const SECTION_OPTIONS = 6
+
+/** Counters for statistics, as accumulated between calls to `stats()` */
+export interface StatsState {
+  sent: number,
+  received: number,
+  latency: bigint,
+}
+
+/** The state of a pinger */
+export interface PingerState {
+  /** The address or host name the pinger was added to its group with */
+  to: string,
+  target: string,
+  protocol: 'ipv4' | 'ipv6',
+  from: string | undefined,
+  source: string | undefined,
+  timeout: number,
+  interval: number,
+  /** The socket's file descriptor (or its index when handing off) or -1 */
+  fd: number,
+  handler: HandlerState,
+  stats: StatsState,
+  /** Baselines and CUSUMs of the change detector, if saved */
+  detector?: number[],
+  /** Runs and transitions of the loss tracker, if saved */
+  losses?: number[],
+  /** The rollup window accumulated so far, if saved */
+  rollup?: RollupState,
+  /** The options only applied when the pinger was created, if saved */
+  options?: Pick<PingerOptions, 'identifier' | 'detector' | 'trace' | 'capture' | 'heatmap' | 'hibernate'>,
+}
+
+/* ========================================================================== */
+
+/** A simple writer for our binary encoding, growing its buffer as needed */
+export class StateWriter {
+  private __buffer: Buffer = Buffer.allocUnsafe(4096)
+  private __offset: number = 0
+
+  private __ensure(length: number): void {
+    if (this.__offset + length <= this.__buffer.length) return
+    let size = this.__buffer.length * 2
+    while (size < this.__offset + length) size *= 2
+    const buffer = Buffer.allocUnsafe(size)
+    this.__buffer.copy(buffer, 0, 0, this.__offset)
+    this.__buffer = buffer
+  }
+
+  u8(value: number): this {
+    this.__ensure(1)
+    this.__offset = this.__buffer.writeUInt8(value, this.__offset)
+    return this
+  }
+
+  u16(value: number): this {
+    this.__ensure(2)
+    this.__offset = this.__buffer.writeUInt16BE(value, this.__offset)
+    return this
+  }
+
+  u32(value: number): this {
+    this.__ensure(4)
+    this.__offset = this.__buffer.writeUInt32BE(value, this.__offset)
+    return this
+  }
+
+  i32(value: number): this {
+    this.__ensure(4)
+    this.__offset = this.__buffer.writeInt32BE(value, this.__offset)
+    return this
+  }
+
+  i64(value: bigint): this {
+    this.__ensure(8)
+    this.__offset = this.__buffer.writeBigInt64BE(value, this.__offset)
+    return this
+  }
+
+  f64(value: number): this {
+    this.__ensure(8)
+    this.__offset = this.__buffer.writeDoubleBE(value, this.__offset)
+    return this
+  }
+
+  bytes(value: Uint8Array): this {
+    this.u32(value.length)
+    this.__ensure(value.length)
+    this.__buffer.set(value, this.__offset)
+    this.__offset += value.length
+    return this
+  }
+
+  string(value: string | undefined): this {
+    return this.bytes(Buffer.from(value || '', 'utf8'))
+  }
+
+  numbers(values: ArrayLike<number>): this {
+    this.u32(values.length)
+    for (let i = 0; i < values.length; i ++) this.f64(values[i]!)
+    return this
+  }
+
+  /** Write a section, its length is back-filled after `write` returns */
+  section(tag: number, write: (writer: this) => void): this {
+    this.u8(tag).u32(0)
+    const start = this.__offset
+    write(this)
+    this.__buffer.writeUInt32BE(this.__offset - start, start - 4)
+    return this
+  }
+
+  finish(): Buffer {
+    return Buffer.from(this.__buffer.subarray(0, this.__offset))
+  }
+}
+
+/** A simple reader for our binary encoding, throwing on truncated data */
+export class StateReader {
+  private __offset: number = 0
+
+  constructor(private readonly __buffer: Buffer) {}
+
+  get remaining(): number {
+    return this.__buffer.length - this.__offset
+  }
+
+  private __check(length: number): number {
+    if (this.__offset + length > this.__buffer.length) throw new Error('Invalid pinger state (truncated)')
+    const offset = this.__offset
+    this.__offset += length
+    return offset
+  }
+
+  u8(): number {
+    return this.__buffer.readUInt8(this.__check(1))
+  }
+
+  u16(): number {
+    return this.__buffer.readUInt16BE(this.__check(2))
+  }
+
+  u32(): number {
+    return this.__buffer.readUInt32BE(this.__check(4))
+  }
+
+  i32(): number {
+    return this.__buffer.readInt32BE(this.__check(4))
+  }
+
+  i64(): bigint {
+    return this.__buffer.readBigInt64BE(this.__check(8))
+  }
+
+  f64(): number {
+    return this.__buffer.readDoubleBE(this.__check(8))
+  }
+
+  bytes(): Buffer {
+    const length = this.u32()
+    const offset = this.__check(length)
+    return Buffer.from(this.__buffer.subarray(offset, offset + length))
+  }
+
+  string(): string {
+    return this.bytes().toString('utf8')
+  }
+
+  numbers(): number[] {
+    const values: number[] = []
+    for (let i = this.u32(); i > 0; i --) values.push(this.f64())
+    return values
+  }
+
+  /** Read all sections until the end tag, returning their contents by tag */
+  sections(): Map<number, StateReader> {
+    const sections = new Map<number, StateReader>()
+    for (let tag = this.u8(); tag !== SECTION_END; tag = this.u8()) {
+      const length = this.u32()
+      const offset = this.__check(length)
+      sections.set(tag, new StateReader(this.__buffer.subarray(offset, offset + length)))
+    }
+    return sections
+  }
+}
+
+/* ========================================================================== */
+
+/** Encode the state of a number of pingers */
+export function encodeStates(states: PingerState[]): Buffer {
+  const writer = new StateWriter().u32(MAGIC).u16(VERSION).u32(states.length)
+
+  for (const state of states) {
+    writer
+        .string(state.to)
+        .string(state.target)
+        .u8(state.protocol === 'ipv6' ? 6 : 4)
+        .string(state.from)
+        .string(state.source)
+        .u32(state.timeout)
+        .u32(state.interval)
+        .i32(state.fd)
+
+    writer.section(SECTION_HANDLER, (writer) => {
+      const { packet, sent, received, inflight, identifier = -1, truncated = false } = state.handler
+      writer.bytes(packet).u32(sent).u32(received).u32(inflight.length)
+      for (const [ sequence, time ] of inflight) writer.u32(sequence).i64(time)
+      writer.i32(identifier) // appended later, older states don't have it
+      writer.u8(truncated ? 1 : 0) // appended after the identifier, likewise
+    })
+
+    writer.section(SECTION_STATS, (writer) => {
+      const { sent, received, latency } = state.stats
+      writer.u32(sent).u32(received).i64(latency)
+    })
+
+    const { detector, losses, rollup, options } = state
+    if (detector) writer.section(SECTION_DETECTOR, (writer) => writer.numbers(detector))
+    if (losses) writer.section(SECTION_LOSSES, (writer) => writer.numbers(losses))
+    if (rollup) {
+      writer.section(SECTION_ROLLUP, (writer) => {
+        writer.numbers(rollup.values).u16(rollup.histogram.resolution).u32(rollup.histogram.buckets.length)
+        for (const count of rollup.histogram.buckets) writer.u32(count)
+      })
+    }
+    if (options) {
+      // Keys are written even when undefined, as "not set" must be restored too
+      writer.section(SECTION_OPTIONS, (writer) => {
+        const entries = Object.entries(options)
+        writer.u32(entries.length)
+        for (const [ key, value ] of entries) {
+          writer.string(key).string(value === undefined ? '' : JSON.stringify(value))
+        }
+      })
+    }
+
+    writer.u8(SECTION_END)
+  }
+
+  return writer.finish()
+}
+
+/** Decode the state of a number of pingers */
+export function decodeStates(buffer: Buffer): PingerState[] {
+  const reader = new StateReader(buffer)
+  if (reader.remaining < 10 || reader.u32() !== MAGIC) throw new Error('Invalid pinger state (wrong magic)')
+  const version = reader.u16()
+  if (version !== VERSION) throw new Error(`Unsupported pinger state version ${version}`)
+
+  const states: PingerState[] = []
+  for (let count = reader.u32(); count > 0; count --) {
+    const to = reader.string()
+    const target = reader.string()
+    const protocol = reader.u8() === 6 ? 'ipv6' : 'ipv4'
+    const from = reader.string() || undefined
+    const source = reader.string() || undefined
+    const timeout = reader.u32()
+    const interval = reader.u32()
+    const fd = reader.i32()
+
+    const sections = reader.sections()
+
+    const handler = sections.get(SECTION_HANDLER)
+    if (! handler) throw new Error(`Invalid pinger state for "${to}" (no handler state)`)
+    const packet = handler.bytes()
+    const sent = handler.u32()
+    const received = handler.u32()
+    const inflight: [ number, bigint ][] = []
+    for (let i = handler.u32(); i > 0; i --) inflight.push([ handler.u32(), handler.i64() ])
+    const identifier = handler.remaining >= 4 ? handler.i32() : -1
+    const truncated = handler.remaining >= 1 ? handler.u8() !== 0 : false
+
+    const stats = sections.get(SECTION_STATS)
+    const sentCount = stats ? stats.u32() : 0
+    const receivedCount = stats ? stats.u32() : 0
+    const latency = stats ? stats.i64() : 0n
+
+    const state: PingerState = {
+      to, target, protocol, from, source, timeout, interval, fd,
+      handler: { packet, sent, received, inflight },
+      stats: { sent: sentCount, received: receivedCount, latency },
+    }
+
+    if (identifier >= 0) state.handler.identifier = identifier
+    if (truncated) state.handler.truncated = true
+
+    const detector = sections.get(SECTION_DETECTOR)
+    if (detector) state.detector = detector.numbers()
+
+    const losses = sections.get(SECTION_LOSSES)
+    if (losses) state.losses = losses.numbers()
+
+    const rollup = sections.get(SECTION_ROLLUP)
+    if (rollup) {
+      const values = rollup.numbers()
+      const resolution = rollup.u16()
+      const length = rollup.u32()
+      if (length * 4 > rollup.remaining) throw new Error('Invalid pinger state (truncated)')
+      const buckets = new Uint32Array(length)
+      for (let i = 0; i < buckets.length; i ++) buckets[i] = rollup.u32()
+      state.rollup = { values, histogram: { resolution, buckets } }
+    }
+
+    const options = sections.get(SECTION_OPTIONS)
+    if (options) {
+      const values: Record<string, any> = {}
+      for (let i = options.u32(); i > 0; i --) {
+        const key = options.string()
+        const json = options.string()
+        values[key] = json ? JSON.parse(json) : undefined
+      }
+      state.options = values
+    }
+
+    states.push(state)
+  }
+
+  return states
+}
@@ -0,0 +1,173 @@
+/* ========================================================================== *
+ * LIFECYCLE TRACING                                                          *
+ * ========================================================================== *
+ *                                                                            *
+ * Samples one ECHO Request every `sample` (by sequence number) and records   *
+ * the timestamps of its whole lifecycle in a fixed-size ring:                *
+ *                                                                            *
+ * - scheduled: when the request was scheduled (timer or call to `ping()`)    *
+ * - built:     when the packet was built by the protocol handler             *
+ * - sent:      when the packet was handed over to the kernel                 *
+ * - received:  when the reply was received by the kernel (Linux only)        *
+ * - validated: when the reply was validated by the protocol handler          *
+ * - delivered: when the reply was delivered to `pong` listeners              *
+ *                                                                            *
+ * As sampled sequences are multiples of `sample`, the slot of a sequence in  *
+ * the ring is simply `(sequence / sample) % size`, and older samples are     *
+ * overwritten by newer ones without any allocation.                          *
+ *                                                                            *
+ * Samples can be exported as Chrome Trace Event Format "complete" events,    *
+ * which can be loaded in `chrome://tracing` or https://ui.perfetto.dev/      *
+ *                                                                            *
+ * ========================================================================== */
+
+/** Options for lifecycle tracing */
+export interface TraceOptions {
+  /** Trace one in `sample` ECHO Requests (default: 100) */
+  sample?: number,
+  /** The number of samples to keep (default: 256) */
+  size?: number,
+}
+
+/** A Chrome Trace Event Format event (the subset we produce) */
+export interface TraceEvent {
+  name: string,
+  cat: string,
+  ph: 'X' | 'M',
+  pid: number,
+  tid: number,
+  ts?: number,
+  dur?: number,
+  args: Record<string, string | number>,
+}
+
+/** A Chrome Trace Event Format JSON object */
+export interface PingerTrace {
+  traceEvents: TraceEvent[],
+  displayTimeUnit: 'ms' | 'ns',
+}
+
+/** Lifecycle phases, in order */
+export const TRACE_SCHEDULED = 0
+export const TRACE_BUILT = 1
+export const TRACE_SENT = 2
+export const TRACE_RECEIVED = 3
+export const TRACE_VALIDATED = 4
+export const TRACE_DELIVERED = 5
+
+/** Names of the spans _ending_ in each phase (the first phase has no span) */
+const SPANS = [ '', 'build', 'send', 'network', 'validate', 'deliver' ]
+
+const PHASES = SPANS.length
+
+export class Tracer {
+  private readonly __sample: number
+  private __size: number
+  private __seqs: Uint32Array
+  private __times: Float64Array
+
+  constructor(options: TraceOptions = {}) {
+    const { sample = 100, size = 256 } = options
+
+    if (!(Number.isInteger(sample) && sample >= 1)) throw new Error(`Invalid trace sample rate ${sample}`)
+    if (!(Number.isInteger(size) && size >= 1)) throw new Error(`Invalid trace size ${size}`)
+
+    this.__sample = sample
+    this.__size = size
+    this.__seqs = new Uint32Array(size)
+    this.__times = new Float64Array(size * PHASES).fill(NaN)
+  }
+
+  /** The number of bytes used by this tracer's ring */
+  get bytes(): number {
+    return this.__seqs.byteLength + this.__times.byteLength
+  }
+
+  /**
+   * Halve the size of this tracer's ring (keeping the most recent samples
+   * that still fit), returning `false` if already down to a single slot.
+   */
+  shrink(): boolean {
+    if (this.__size < 2) return false
+
+    const size = Math.floor(this.__size / 2)
+    const seqs = new Uint32Array(size)
+    const times = new Float64Array(size * PHASES).fill(NaN)
+
+    for (let slot = 0; slot < this.__size; slot ++) {
+      const offset = slot * PHASES
+      if (isNaN(this.__times[offset + TRACE_SCHEDULED]!)) continue
+
+      // Two samples can end up in the same slot, keep the most recent one
+      const sequence = this.__seqs[slot]!
+      const target = Math.floor(sequence / this.__sample) % size
+      if ((! isNaN(times[target * PHASES]!)) && (((seqs[target]! - sequence) | 0) > 0)) continue
+
+      seqs[target] = sequence
+      times.set(this.__times.subarray(offset, offset + PHASES), target * PHASES)
+    }
+
+    this.__size = size
+    this.__seqs = seqs
+    this.__times = times
+    return true
+  }
+
+  /** Whether the specified sequence is sampled or not */
+  sampled(sequence: number): boolean {
+    return (sequence % this.__sample) === 0
+  }
+
+  /** Start tracing a (sampled) sequence, scheduled and built at the given times */
+  start(sequence: number, scheduled: bigint, built: bigint): void {
+    const slot = Math.floor(sequence / this.__sample) % this.__size
+    const offset = slot * PHASES
+
+    this.__seqs[slot] = sequence
+    this.__times.fill(NaN, offset, offset + PHASES)
+    this.__times[offset + TRACE_SCHEDULED] = Number(scheduled)
+    this.__times[offset + TRACE_BUILT] = Number(built)
+  }
+
+  /** Mark a phase for a (sampled) sequence, if still in our ring */
+  mark(sequence: number, phase: number, time: bigint): void {
+    const slot = Math.floor(sequence / this.__sample) % this.__size
+    if (this.__seqs[slot] !== sequence) return
+    this.__times[slot * PHASES + phase] = Number(time)
+  }
+
+  /** Export all samples as Chrome Trace Event Format events */
+  events(tid: number, name: string): TraceEvent[] {
+    const pid = process.pid
+    const events: TraceEvent[] = [ {
+      name: 'thread_name', cat: '__metadata', ph: 'M', pid, tid, args: { name },
+    } ]
+
+    for (let slot = 0; slot < this.__size; slot ++) {
+      const offset = slot * PHASES
+      const sequence = this.__seqs[slot]!
+      if (isNaN(this.__times[offset + TRACE_SCHEDULED]!)) continue
+
+      // Emit a span between each phase and the _last known_ phase before it
+      let previous = this.__times[offset + TRACE_SCHEDULED]!
+      for (let phase = TRACE_BUILT; phase < PHASES; phase ++) {
+        const time = this.__times[offset + phase]!
+        if (isNaN(time)) continue
+
+        events.push({
+          name: SPANS[phase]!,
+          cat: 'ping',
+          ph: 'X',
+          pid,
+          tid,
+          ts: previous / 1000,
+          dur: Math.max(0, time - previous) / 1000,
+          args: { sequence },
+        })
+        previous = time
+      }
+    }
+
+    return events
+  }
+}
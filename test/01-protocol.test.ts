@@ -1,13 +1,19 @@
+import { randomBytes } from 'node:crypto'
+
+import native from '../native/ping.cjs'
 import {
   ERR_LATENCY_NEGATIVE,
   ERR_SEQUENCE_TOO_BIG,
   ERR_SEQUENCE_TOO_SMALL,
+  ERR_WRONG_CHECKSUM,
   ERR_WRONG_CORRELATION,
   ERR_WRONG_ICMP_CODE,
+  ERR_WRONG_IDENTIFIER,
   ERR_WRONG_ICMP_TYPE,
   ERR_WRONG_LENGTH,
   ERR_WRONG_SEQUENCE,
   getWarning,
+  jsChecksum,
   ProtocolHandler,
   rfc1071crc,
 } from '../src/protocol'
@@ -141,6 +147,54 @@ describe('ICMP protocol', () => {
     expect(seqIn6()).toEqual(seqOut6())
   })
 
+  it('should verify checksums of incoming packets with IP headers', () => {
+    const ip4 = Buffer.alloc(20).fill(0)
+    ip4.writeUint8(0x45, 0)
+
+    const icmp4 = reply4()
+    icmp4.writeUInt16BE(icmp4.readUInt16BE(2) ^ 0x0100, 2)
+    expect(handler4.incoming(Buffer.concat([ ip4, icmp4 ]), icmp4.readBigInt64BE(8))).toEqual(ERR_WRONG_CHECKSUM)
+    expect(seqIn4()).not.toEqual(seqOut4())
+
+    // ICMPv6 checksums include a pseudo header with source and destination
+    const ip6 = Buffer.alloc(40).fill(0)
+    ip6.writeUint8(0x60, 0)
+    ip6.fill(0x11, 8, 24) // source
+    ip6.fill(0x22, 24, 40) // destination
+
+    const icmp6 = reply6()
+    icmp6.writeUInt16BE(0x00, 2)
+    icmp6.writeUInt16BE(native.checksum(icmp6, ip6.subarray(8, 24), ip6.subarray(24, 40)), 2)
+
+    // the plain checksum we'd get (from the kernel) is wrong with addresses
+    const plain = Buffer.from(icmp6)
+    plain.writeUInt16BE(0x00, 2)
+    plain.writeUInt16BE(rfc1071crc(plain), 2)
+    expect(handler6.incoming(Buffer.concat([ ip6, plain ]), icmp6.readBigInt64BE(8))).toEqual(ERR_WRONG_CHECKSUM)
+    expect(seqIn6()).not.toEqual(seqOut6())
+
+    expect(handler6.incoming(Buffer.concat([ ip6, icmp6 ]), icmp6.readBigInt64BE(8))).toEqual(0n)
+    expect(seqIn6()).toEqual(seqOut6())
+  })
+
+  it('should compute the same checksums as our native code in JavaScript', () => {
+    const source = randomBytes(16)
+    const destination = randomBytes(16)
+
+    for (const length of [ 0, 1, 63, 64, 1501 ]) {
+      const data = randomBytes(length)
+      expect(jsChecksum(data)).toEqual(native.checksum(data))
+      expect(jsChecksum(data, source, destination)).toEqual(native.checksum(data, source, destination))
+    }
+
+    // the checksum of a packet including its (correct) checksum is zero
+    const icmp6 = reply6()
+    icmp6.writeUInt16BE(0x00, 2)
+    icmp6.writeUInt16BE(jsChecksum(icmp6, source, destination), 2)
+    expect(jsChecksum(icmp6, source, destination)).toEqual(0)
+    expect(jsChecksum(icmp6)).not.toEqual(0)
+  })
+
   it('should not handle incoming short packets', () => {
     const buffer = reply6()
     const now = buffer.readBigInt64BE(8)
@@ -180,7 +234,7 @@ describe('ICMP protocol', () => {
     expect(seqIn6()).not.toEqual(seqOut6())
   })
 
-  it('should not handle incoming packets with the lower 8 bits of sequence number', () => {
+  it('should not handle incoming packets with the wrong 16 bits of sequence number', () => {
     const buffer = reply6()
     const now = buffer.readBigInt64BE(8)
 
@@ -191,13 +245,121 @@ describe('ICMP protocol', () => {
     expect(handler6.incoming(buffer, now)).toEqual(ERR_WRONG_SEQUENCE)
     expect(seqIn6()).not.toEqual(seqOut6())
 
-    // but it should match when the higher 8 bits are changed
+    // and neither when the higher 8 bits are changed
     buffer.writeUint16BE((seq & 0x0ff) + 0x0500, 6)
+    expect(handler6.incoming(buffer, now)).toEqual(ERR_WRONG_SEQUENCE)
     expect(seqIn6()).not.toEqual(seqOut6())
+
+    // but it should match when the full 16 bits are right
+    buffer.writeUint16BE(seq, 6)
     expect(handler6.incoming(buffer, now)).toEqual(0n) // success!
     expect(seqIn6()).toEqual(seqOut6())
   })
 
+  it('should fall back to the lower 8 bits of sequence number for truncating kernels', () => {
+    const handler = new ProtocolHandler(false)
+    handler.restore({ ...handler.save(), sent: 0x1233, received: 0x1233 })
+
+    const request = handler.outgoing()
+    expect(request.readUInt16BE(6)).toEqual(0x1234)
+
+    const reply = Buffer.from(request)
+    reply.writeUInt8(0x00, 0)
+    reply.writeUInt16BE(0x0034, 6) // truncated to 8 bits
+    expect(handler.incoming(reply, reply.readBigInt64BE(8))).toEqual(0n)
+
+    // from now on, only the lower 8 bits are matched
+    const next = Buffer.from(handler.outgoing())
+    next.writeUInt8(0x00, 0)
+    next.writeUInt16BE(0x0535, 6)
+    expect(handler.incoming(next, next.readBigInt64BE(8))).toEqual(0n)
+
+    // ... and a handler restoring our state keeps matching them
+    const state = handler.save()
+    expect(state.truncated).toBeTrue()
+
+    const restored = new ProtocolHandler(false)
+    restored.restore(state)
+    const after = Buffer.from(restored.outgoing())
+    after.writeUInt8(0x00, 0)
+    after.writeUInt16BE(0x0936, 6)
+    expect(restored.incoming(after, after.readBigInt64BE(8))).toEqual(0n)
+  })
+
+  it('should not fall back to 8 bits of sequence number for rejected replies', () => {
+    const handler = new ProtocolHandler(false)
+    handler.restore({ ...handler.save(), sent: 0x1233, received: 0x1233 })
+
+    // a truncated reply from the future (or the past) is rejected...
+    const request = handler.outgoing()
+    const future = Buffer.from(request)
+    future.writeUInt8(0x00, 0)
+    future.writeUInt32BE(0x1235, 16)
+    future.writeUInt16BE(0x0035, 6)
+    expect(handler.incoming(future, future.readBigInt64BE(8))).toEqual(ERR_SEQUENCE_TOO_BIG)
+
+    // ... and so is one travelling back in time
+    const negative = Buffer.from(request)
+    negative.writeUInt8(0x00, 0)
+    negative.writeUInt16BE(0x0034, 6)
+    expect(handler.incoming(negative, negative.readBigInt64BE(8) - 1n)).toEqual(ERR_LATENCY_NEGATIVE)
+
+    // ... without weakening the check of the full 16 bits
+    expect(handler.save().truncated).toBeUndefined()
+    const reply = Buffer.from(request)
+    reply.writeUInt8(0x00, 0)
+    reply.writeUInt16BE(0x0534, 6)
+    expect(handler.incoming(reply, reply.readBigInt64BE(8))).toEqual(ERR_WRONG_SEQUENCE)
+  })
+
+  it('should use and check the identifier its socket is bound to', () => {
+    const handler = new ProtocolHandler(false, 0x1234)
+    expect(handler.identifier).toEqual(0x1234)
+
+    const reply = Buffer.from(handler.outgoing())
+    expect(reply.readUInt16BE(4)).toEqual(0x1234)
+    reply.writeUInt8(0x00, 0)
+
+    reply.writeUInt16BE(0x4321, 4)
+    expect(handler.incoming(reply, reply.readBigInt64BE(8))).toEqual(ERR_WRONG_IDENTIFIER)
+    reply.writeUInt16BE(0x1234, 4)
+    expect(handler.incoming(reply, reply.readBigInt64BE(8))).toEqual(0n)
+
+    // a new socket keeps its own identifier, the same socket adopts the saved one
+    const state = handler.save()
+    expect(state.identifier).toEqual(0x1234)
+
+    const renewed = new ProtocolHandler(false, 0x5678)
+    renewed.restore(state)
+    expect(renewed.identifier).toEqual(0x5678)
+
+    const adopted = new ProtocolHandler(false)
+    adopted.restore(state)
+    expect(adopted.identifier).toEqual(0x1234)
+    expect(adopted.save().identifier).toEqual(0x1234)
+  })
+
+  it('should wrap around 32 bits sequence numbers', () => {
+    const handler = new ProtocolHandler(true)
+    handler.restore({ ...handler.save(), sent: 0xfffffffe, received: 0xfffffffe })
+
+    const replies = [ handler.outgoing(), handler.outgoing() ].map((request) => {
+      const reply = Buffer.from(request)
+      reply.writeUInt8(0x81, 0)
+      return reply
+    })
+
+    expect(replies.map((reply) => reply.readUInt32BE(16))).toEqual([ 0xffffffff, 0 ])
+    expect(replies.map((reply) => reply.readUInt16BE(6))).toEqual([ 0xffff, 0 ])
+
+    expect(handler.incoming(replies[0]!, replies[0]!.readBigInt64BE(8))).toEqual(0n)
+    expect(handler.incoming(replies[1]!, replies[1]!.readBigInt64BE(8))).toEqual(0n)
+    expect(handler.sequence).toEqual(0)
+
+    // duplicates before the wraparound are still in the past
+    expect(handler.incoming(replies[0]!, replies[0]!.readBigInt64BE(8))).toEqual(ERR_SEQUENCE_TOO_SMALL)
+  })
+
   it('should not handle incoming packets with sequence greater than last packet out', () => {
     const buffer = reply6()
     const now = buffer.readBigInt64BE(8)
@@ -230,6 +392,37 @@ describe('ICMP protocol', () => {
     expect(seqIn6()).not.toEqual(seqOut6())
   })
 
+  it('should expire requests after a timeout', () => {
+    const handler = new ProtocolHandler(false)
+    const first = handler.outgoing()
+    const second = handler.outgoing()
+    const sent = first.readBigInt64BE(8)
+    const last = second.readBigInt64BE(8)
+
+    expect(handler.expire(1000n, sent + 999n)).toEqual(0)
+    expect(handler.expire(1000n, last + 1000n)).toEqual(2)
+    expect(handler.expire(1000n, last + 1000n)).toEqual(0)
+
+    // replies for expired requests are considered in the past
+    second.writeUInt8(0x00, 0) // type
+    expect(handler.incoming(second, last + 1000n)).toEqual(ERR_SEQUENCE_TOO_SMALL)
+  })
+
+  it('should skip requests before an accepted reply', () => {
+    const handler = new ProtocolHandler(false)
+    handler.outgoing()
+    handler.outgoing()
+    const third = handler.outgoing()
+    const now = third.readBigInt64BE(8)
+
+    third.writeUInt8(0x00, 0) // type
+    expect(handler.incoming(third, now)).toEqual(0n)
+    expect(handler.skipped).toEqual(2)
+
+    // skipped requests are not in flight anymore
+    expect(handler.expire(0n, now)).toEqual(0)
+  })
+
   it('should provide informative warning messages', () => {
     expect(getWarning(1234567n)).toEqual({ code: 'OK', message: 'Latency is 1.234567 ms' })
 
@@ -241,6 +434,9 @@ describe('ICMP protocol', () => {
     expect(getWarning(-6n)).toEqual({ code: 'ERR_SEQUENCE_TOO_BIG', message: 'Received packet with sequence in the future' })
     expect(getWarning(-7n)).toEqual({ code: 'ERR_SEQUENCE_TOO_SMALL', message: 'Received packet with sequence in the past (duplicate packet?)' })
     expect(getWarning(-8n)).toEqual({ code: 'ERR_LATENCY_NEGATIVE', message: 'Received packet with negative latence (time travel is possible!)' })
-    expect(getWarning(-9n)).toEqual({ code: 'ERR_UNKNOWN', message: `Unknown error code (code=${-9})` })
+    expect(getWarning(-9n)).toEqual({ code: 'ERR_WRONG_IDENTIFIER', message: 'Received packet with invalid identifier' })
+    expect(getWarning(-10n)).toEqual({ code: 'ERR_WRONG_CHECKSUM', message: 'Received packet with invalid checksum' })
+    expect(getWarning(-11n)).toEqual({ code: 'ERR_WRONG_SOURCE', message: 'Received packet from an address other than the target' })
+    expect(getWarning(-12n)).toEqual({ code: 'ERR_UNKNOWN', message: `Unknown error code (code=${-12})` })
   })
 })
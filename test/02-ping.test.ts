@@ -55,6 +55,74 @@ describe('Ping Test', () => {
     })
   }
 
+  it('should bind to kernel-assigned and explicit identifiers', async () => {
+    const pinger1 = await createPinger('127.0.0.1')
+    const pinger2 = await createPinger('127.0.0.1')
+    const pinger3 = await createPinger('::1', { identifier: 4321 })
+    try {
+      if (process.platform === 'linux') {
+        expect(pinger1.identifier).not.toEqual(pinger2.identifier)
+      } else {
+        expect(pinger1.identifier).toEqual(process.pid % 0xffff)
+      }
+      expect(pinger3.identifier).toEqual(4321)
+
+      // each pinger only receives the replies to its own requests
+      const warnings: string[] = []
+      let pongs = 0
+      for (const pinger of [ pinger1, pinger2, pinger3 ]) {
+        pinger.on('pong', () => pongs ++)
+        pinger.on('warning', (code) => warnings.push(code))
+        await pinger.ping()
+      }
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      expect(pongs).toEqual(3)
+      expect(warnings).toEqual([])
+    } finally {
+      await pinger1.close()
+      await pinger2.close()
+      await pinger3.close()
+    }
+
+    await expectAsync(createPinger('127.0.0.1', { identifier: 65536 }))
+        .toBeRejectedWithError(Error, 'Invalid ICMP identifier 65536')
+  })
+
+  it('should measure the local overhead', async () => {
+    const pinger = await createPinger('127.0.0.1', { interval: 100 })
+    try {
+      expect(pinger.overhead()).toEqual({
+        send: { count: 0, avg: NaN, max: NaN },
+        receive: { count: 0, avg: NaN, max: NaN },
+      })
+
+      pinger.start()
+      await new Promise((resolve) => setTimeout(resolve, 550))
+      pinger.stop()
+      await pinger.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      const { received } = pinger.stats()
+      const { send, receive } = pinger.overhead()
+
+      expect(send.count).toEqual(6)
+      expect(send.avg).toBeGreaterThanOrEqual(0)
+      expect(send.avg).toBeLessThan(10)
+      expect(send.max).toBeGreaterThanOrEqual(send.avg)
+
+      // kernel timestamps are only available on Linux
+      if (process.platform === 'linux') {
+        expect(receive.count).toEqual(received)
+        expect(receive.avg).toBeGreaterThanOrEqual(0)
+        expect(receive.avg).toBeLessThan(10)
+        expect(receive.max).toBeGreaterThanOrEqual(receive.avg)
+      }
+    } finally {
+      await pinger.close()
+    }
+  })
+
   it('should ping a real host over the network', async () => {
     const pinger = await createPinger('1.1.1.1', { interval: 100 })
     try {
@@ -1,3 +1,4 @@
+import { closeSync } from 'node:fs'
 import { promisify } from 'node:util'
 
 import native from '../native/ping.cjs'
@@ -7,85 +8,111 @@ const long = 'a_very_very_very_very_very_very_very_very_very_very_long_string'
 describe('Native Adapter', () => {
   it('should not construct with the wrong number of parameters', () => {
     expect(() => (<any> native.open)())
-        .toThrowError(TypeError, 'Expected 4 arguments: socket family, from address, source interface, callback')
+        .toThrowError(TypeError, 'Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback')
 
     expect(() => (<any> native.open)(1))
-        .toThrowError(TypeError, 'Expected 4 arguments: socket family, from address, source interface, callback')
+        .toThrowError(TypeError, 'Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback')
 
     expect(() => (<any> native.open)(1, 2))
-        .toThrowError(TypeError, 'Expected 4 arguments: socket family, from address, source interface, callback')
+        .toThrowError(TypeError, 'Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback')
 
     expect(() => (<any> native.open)(1, 2, 3))
-        .toThrowError(TypeError, 'Expected 4 arguments: socket family, from address, source interface, callback')
+        .toThrowError(TypeError, 'Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback')
+
+    expect(() => (<any> native.open)(1, 2, 3, 4, 5, 6))
+        .toThrowError(TypeError, 'Expected 4 or 5 arguments: socket family, from address, source interface, [identifier], callback')
+  })
+
+  it('should open sockets with the original 4 arguments form', async () => {
+    expect(native.identifiers).toBeTrue()
+
+    const open = promisify(native.open as (...args: any[]) => void)
+    const fd = await open(native.AF_INET, null, null)
+    expect(fd).toBeGreaterThan(0)
+    closeSync(fd)
+
+    expect(() => (<any> native.open)(native.AF_INET, null, null, 'cb'))
+        .toThrowError(TypeError, 'Specified callback is not a function')
   })
 
   it('should not construct with the wrong family', () => {
-    expect(() => (<any> native.open)('foo', 'addr', 'if', 'cb'))
+    expect(() => (<any> native.open)('foo', 'addr', 'if', null, 'cb'))
         .toThrowError(TypeError, 'Specified socket family is not a number')
 
-    expect(() => (<any> native.open)(12345, 'addr', 'if', 'cb'))
+    expect(() => (<any> native.open)(12345, 'addr', 'if', null, 'cb'))
         .toThrowError(TypeError, 'Socket family must be AF_INET or AF_INET6')
   })
 
   it('should not construct with the wrong from address', () => {
-    expect(() => (<any> native.open)(native.AF_INET, 123, 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET, 123, 'if', null, 'cb'))
         .toThrowError(TypeError, 'From address must be a string, null or undefined')
 
-    expect(() => (<any> native.open)(native.AF_INET, long, 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET, long, 'if', null, 'cb'))
         .toThrowError(TypeError, 'From address must be at most 40 characters long')
 
-    expect(() => (<any> native.open)(native.AF_INET, '::1', 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET, '::1', 'if', null, 'cb'))
         .toThrowError(TypeError, 'Invalid IPv4 from address: ::1')
 
-    expect(() => (<any> native.open)(native.AF_INET6, 123, 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET6, 123, 'if', null, 'cb'))
         .toThrowError(TypeError, 'From address must be a string, null or undefined')
 
-    expect(() => (<any> native.open)(native.AF_INET6, '127.0.0.1', 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET6, '127.0.0.1', 'if', null, 'cb'))
         .toThrowError(TypeError, 'Invalid IPv6 from address: 127.0.0.1')
 
-    expect(() => (<any> native.open)(native.AF_INET6, long, 'if', 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET6, long, 'if', null, 'cb'))
         .toThrowError(TypeError, 'From address must be at most 40 characters long')
   })
 
   it('should not construct with the wrong source interface', () => {
-    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 123, 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 123, null, 'cb'))
         .toThrowError(TypeError, 'Source interface must be a string, null or undefined')
 
-    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', long, 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', long, null, 'cb'))
         .toThrowError(TypeError, /^Source interface must be at most \d+ characters long$/)
 
-    expect(() => (<any> native.open)(native.AF_INET6, '::1', 123, 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET6, '::1', 123, null, 'cb'))
         .toThrowError(TypeError, 'Source interface must be a string, null or undefined')
 
-    expect(() => (<any> native.open)(native.AF_INET6, '::1', long, 'cb'))
+    expect(() => (<any> native.open)(native.AF_INET6, '::1', long, null, 'cb'))
         .toThrowError(TypeError, /^Source interface must be at most \d+ characters long$/)
   })
 
   it('should not construct with the wrong callback', () => {
-    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 'eth0', 'callback'))
+    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 'eth0', null, 'callback'))
         .toThrowError(TypeError, 'Specified callback is not a function')
 
-    expect(() => (<any> native.open)(native.AF_INET6, '::1', 'eth0', 'callback'))
+    expect(() => (<any> native.open)(native.AF_INET6, '::1', 'eth0', null, 'callback'))
         .toThrowError(TypeError, 'Specified callback is not a function')
   })
 
   it('should not construct with the wrong callback', () => {
-    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 'eth0', 'callback'))
+    expect(() => (<any> native.open)(native.AF_INET, '127.0.0.1', 'eth0', null, 'callback'))
         .toThrowError(TypeError, 'Specified callback is not a function')
 
-    expect(() => (<any> native.open)(native.AF_INET6, '::1', 'eth0', 'callback'))
+    expect(() => (<any> native.open)(native.AF_INET6, '::1', 'eth0', null, 'callback'))
         .toThrowError(TypeError, 'Specified callback is not a function')
   })
 
+  it('should not construct with the wrong identifier', () => {
+    expect(() => (<any> native.open)(native.AF_INET, null, null, 'foo', 'cb'))
+        .toThrowError(TypeError, 'Identifier must be a number between 0 and 65535, null or undefined')
+
+    expect(() => (<any> native.open)(native.AF_INET, null, null, -1, 'cb'))
+        .toThrowError(TypeError, 'Identifier must be a number between 0 and 65535, null or undefined')
+
+    expect(() => (<any> native.open)(native.AF_INET6, null, null, 65536, 'cb'))
+        .toThrowError(TypeError, 'Identifier must be a number between 0 and 65535, null or undefined')
+  })
+
   it('should not bind to the wrong source interface', async () => {
     const open = promisify(native.open)
 
-    await expectAsync(open(native.AF_INET, null, 'xyznope'))
+    await expectAsync(open(native.AF_INET, null, 'xyznope', null))
         .toBeRejectedWith(jasmine.objectContaining({
           syscall: jasmine.stringMatching(/^(setsockopt)|(if_nametoindex)$/),
         }))
 
-    await expectAsync(open(native.AF_INET6, null, 'xyznope'))
+    await expectAsync(open(native.AF_INET6, null, 'xyznope', null))
         .toBeRejectedWith(jasmine.objectContaining({
           syscall: jasmine.stringMatching(/^(setsockopt)|(if_nametoindex)$/),
         }))
@@ -97,14 +124,92 @@ describe('Native Adapter', () => {
 
     const open = promisify(native.open)
 
-    await expectAsync(open(native.AF_INET, '1.1.1.1', null))
+    await expectAsync(open(native.AF_INET, '1.1.1.1', null, null))
         .toBeRejectedWith(jasmine.objectContaining({
           syscall: 'bind',
         }))
 
-    await expectAsync(open(native.AF_INET6, '2606:4700:4700::1111', null))
+    await expectAsync(open(native.AF_INET6, '2606:4700:4700::1111', null, null))
         .toBeRejectedWith(jasmine.objectContaining({
           syscall: 'bind',
         }))
   })
+
+  it('should not stamp with the wrong parameters', () => {
+    expect(() => (<any> native.stamp)())
+        .toThrowError(TypeError, 'Expected 1 argument: file descriptor')
+
+    expect(() => (<any> native.stamp)('foo'))
+        .toThrowError(TypeError, 'Specified file descriptor is not a number')
+  })
+
+  it('should not checksum with the wrong parameters', () => {
+    expect(() => (<any> native.checksum)())
+        .toThrowError(TypeError, 'Expected 1 or 3 arguments: data, source address, destination address')
+
+    expect(() => (<any> native.checksum)(Buffer.alloc(8), Buffer.alloc(16)))
+        .toThrowError(TypeError, 'Expected 1 or 3 arguments: data, source address, destination address')
+
+    expect(() => (<any> native.checksum)('foo'))
+        .toThrowError(TypeError, 'Specified data is not a buffer')
+
+    expect(() => (<any> native.checksum)(Buffer.alloc(8), 'foo', Buffer.alloc(16)))
+        .toThrowError(TypeError, 'Specified address is not a buffer')
+
+    expect(() => (<any> native.checksum)(Buffer.alloc(8), Buffer.alloc(16), Buffer.alloc(4)))
+        .toThrowError(TypeError, 'Specified address is not 16 bytes long')
+  })
+
+  it('should calculate checksums', () => {
+    // the example from RFC 1071, section 3
+    const data = Buffer.from([ 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 ])
+    expect(native.checksum(data)).toEqual(0x220d)
+    expect(native.checksum(data.subarray(0, 7))).toEqual(0x2304)
+    expect(native.checksum(Buffer.alloc(0))).toEqual(0xffff)
+
+    // pseudo header: both addresses, the length and the next header (58)
+    const source = Buffer.alloc(16, 0x11)
+    const destination = Buffer.alloc(16, 0x22)
+    const pseudo = Buffer.alloc(40)
+    source.copy(pseudo, 0)
+    destination.copy(pseudo, 16)
+    pseudo.writeUInt32BE(data.length, 32)
+    pseudo.writeUInt32BE(58, 36)
+    expect(native.checksum(data, source, destination))
+        .toEqual(native.checksum(Buffer.concat([ pseudo, data ])))
+
+    // a packet with its checksum in place sums to zero
+    const packet = Buffer.concat([ Buffer.from([ 0x81, 0x00, 0x00, 0x00 ]), data ])
+    packet.writeUInt16BE(native.checksum(packet, source, destination), 2)
+    expect(native.checksum(packet, source, destination)).toEqual(0)
+  })
+
+  it('should not hand off with the wrong parameters', () => {
+    expect(() => (<any> native.handoff_send)())
+        .toThrowError(TypeError, 'Expected 5 arguments: path, file descriptors, data, timeout, callback')
+
+    expect(() => (<any> native.handoff_send)(123, [], Buffer.alloc(0), 1000, () => {}))
+        .toThrowError(TypeError, 'Specified path is not a string')
+
+    expect(() => (<any> native.handoff_send)('x'.repeat(200), [], Buffer.alloc(0), 1000, () => {}))
+        .toThrowError(TypeError, 'Specified path is empty or too long for a UNIX socket')
+
+    expect(() => (<any> native.handoff_send)('/tmp/foo', [], Buffer.alloc(0), 0, () => {}))
+        .toThrowError(TypeError, 'Specified timeout must be a positive number')
+
+    expect(() => (<any> native.handoff_send)('/tmp/foo', [], Buffer.alloc(0), 1000, 'foo'))
+        .toThrowError(TypeError, 'Specified callback is not a function')
+
+    expect(() => (<any> native.handoff_send)('/tmp/foo', 'foo', Buffer.alloc(0), 1000, () => {}))
+        .toThrowError(TypeError, 'Specified file descriptors are not an array')
+
+    expect(() => (<any> native.handoff_send)('/tmp/foo', [ 'foo' ], Buffer.alloc(0), 1000, () => {}))
+        .toThrowError(TypeError, 'Specified file descriptor is not a number')
+
+    expect(() => (<any> native.handoff_send)('/tmp/foo', [], 'foo', 1000, () => {}))
+        .toThrowError(TypeError, 'Specified data is not a buffer')
+
+    expect(() => (<any> native.handoff_receive)())
+        .toThrowError(TypeError, 'Expected 3 arguments: path, timeout, callback')
+  })
 })
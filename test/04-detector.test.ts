@@ -0,0 +1,73 @@
+import { ChangeDetector } from '../src/detector'
+
+import type { PingerChange } from '../src/detector'
+
+describe('Change detector', () => {
+  // deterministic "noise" so that our tests are repeatable
+  const noise = (i: number): number => Math.sin(i * 12.9898) * 0.5
+
+  it('should not detect changes on a stable latency', () => {
+    const detector = new ChangeDetector()
+    for (let i = 0; i < 10000; i ++) {
+      expect(detector.latency(20 + noise(i))).toBeUndefined()
+    }
+  })
+
+  it('should not detect changes on isolated latency spikes', () => {
+    const detector = new ChangeDetector()
+    for (let i = 0; i < 1000; i ++) {
+      const latency = (i % 100) === 99 ? 500 : 20 + noise(i)
+      expect(detector.latency(latency)).toBeUndefined()
+    }
+  })
+
+  it('should detect latency going up and down', () => {
+    const detector = new ChangeDetector()
+    const changes: PingerChange[] = []
+
+    for (let i = 0; i < 300; i ++) {
+      const latency = (i < 100 ? 20 : i < 200 ? 40 : 20) + noise(i)
+      const change = detector.latency(latency)
+      if (change) changes.push(change)
+    }
+
+    expect(changes.length).toEqual(2)
+    expect(changes[0]).toEqual(jasmine.objectContaining({ metric: 'latency', direction: 'up' }))
+    expect(changes[0]!.from).toBeCloseTo(20, 0)
+    expect(changes[0]!.to).toBeCloseTo(40, 0)
+    expect(changes[1]).toEqual(jasmine.objectContaining({ metric: 'latency', direction: 'down' }))
+    expect(changes[1]!.from).toBeCloseTo(40, 0)
+    expect(changes[1]!.to).toBeCloseTo(20, 0)
+  })
+
+  it('should detect loss going up and down', () => {
+    const detector = new ChangeDetector()
+    const changes: PingerChange[] = []
+
+    for (let i = 0; i < 300; i ++) {
+      const lost = (i >= 100) && (i < 200) // a full outage
+      const change = detector.loss(lost)
+      if (change) changes.push(change)
+    }
+
+    expect(changes.length).toEqual(2)
+    expect(changes[0]).toEqual(jasmine.objectContaining({ metric: 'loss', direction: 'up', from: 0 }))
+    expect(changes[0]!.to).toEqual(1)
+    expect(changes[1]).toEqual(jasmine.objectContaining({ metric: 'loss', direction: 'down', from: 1 }))
+    expect(changes[1]!.to).toBeLessThan(0.1)
+  })
+
+  it('should not detect changes on sporadic losses', () => {
+    const detector = new ChangeDetector()
+    for (let i = 0; i < 10000; i ++) {
+      expect(detector.loss((i % 500) === 250)).toBeUndefined()
+    }
+  })
+
+  it('should validate its options', () => {
+    expect(() => new ChangeDetector({ alpha: 0 })).toThrowError('Invalid detector alpha 0')
+    expect(() => new ChangeDetector({ threshold: -1 })).toThrowError('Invalid detector threshold -1')
+    expect(() => new ChangeDetector({ slack: -1 })).toThrowError('Invalid detector slack -1')
+    expect(() => new ChangeDetector({ warmup: -1 })).toThrowError('Invalid detector warmup -1')
+  })
+})
@@ -0,0 +1,158 @@
+import { createPingerGroup } from '../src/index'
+import { Histogram } from '../src/histogram'
+import { checkWindow, RollupAccumulator, windowEnd } from '../src/rollup'
+
+import type { Pinger, PingerRollup } from '../src/index'
+
+describe('Rollups', () => {
+  it('should compute percentiles from a histogram', () => {
+    const histogram = new Histogram()
+    expect(histogram.percentile(50)).toBeNaN()
+
+    for (let i = 1; i <= 1000; i ++) histogram.record(i / 10)
+
+    expect(histogram.count).toEqual(1000)
+    expect(Math.abs(histogram.percentile(50) / 50 - 1)).toBeLessThan(0.025)
+    expect(Math.abs(histogram.percentile(90) / 90 - 1)).toBeLessThan(0.025)
+    expect(Math.abs(histogram.percentile(99) / 99 - 1)).toBeLessThan(0.025)
+
+    histogram.reset()
+    expect(histogram.count).toEqual(0)
+    expect(histogram.percentile(50)).toBeNaN()
+  })
+
+  it('should coarsen a histogram', () => {
+    const histogram = new Histogram(4)
+    for (let i = 1; i <= 1000; i ++) histogram.record(i / 10)
+
+    const bytes = histogram.bytes
+    const p50 = histogram.percentile(50)
+
+    expect(histogram.coarsen()).toBeTrue()
+    expect(histogram.resolution).toEqual(2)
+    expect(histogram.bytes).toEqual(bytes / 2)
+    expect(histogram.count).toEqual(1000)
+    expect(Math.abs(histogram.percentile(50) / p50 - 1)).toBeLessThan(0.5)
+
+    expect(histogram.coarsen()).toBeTrue()
+    expect(histogram.coarsen()).toBeFalse()
+    expect(histogram.resolution).toEqual(1)
+
+    expect(() => new Histogram(3)).toThrowError('Histogram resolution must be a power of two (resolution=3)')
+  })
+
+  it('should accumulate and reset rollups', () => {
+    const accumulator = new RollupAccumulator()
+    for (let i = 0; i < 4; i ++) accumulator.sent()
+    accumulator.received(10)
+    accumulator.received(20)
+    accumulator.received(12)
+    accumulator.lost(1)
+
+    const rollup = accumulator.rollup('1.2.3.4', 10000, 20000)
+    expect(rollup).toEqual(jasmine.objectContaining({
+      target: '1.2.3.4',
+      start: 10000,
+      end: 20000,
+      sent: 4,
+      received: 3,
+      lost: 1,
+      loss: 0.25,
+      min: 10,
+      max: 20,
+      avg: 14,
+      jitter: 9, // (10 + 8) / 2
+    }))
+    expect(rollup.p50).toBeCloseTo(12, 0)
+    expect(rollup.p99).toBeCloseTo(20, 0)
+
+    // after a reset, jitter is still computed against the last latency
+    accumulator.received(14)
+    expect(accumulator.rollup('1.2.3.4', 20000, 30000)).toEqual({
+      target: '1.2.3.4',
+      start: 20000,
+      end: 30000,
+      sent: 0,
+      received: 1,
+      lost: 0,
+      loss: 0,
+      min: 14,
+      max: 14,
+      avg: 14,
+      p50: 14,
+      p90: 14,
+      p95: 14,
+      p99: 14,
+      jitter: 2,
+    })
+
+    expect(accumulator.rollup('1.2.3.4', 30000, 40000)).toEqual(jasmine.objectContaining({
+      sent: 0,
+      received: 0,
+      lost: 0,
+      loss: NaN,
+      min: NaN,
+      max: NaN,
+      avg: NaN,
+      p50: NaN,
+      jitter: NaN,
+    }))
+  })
+
+  it('should align windows to wall-clock boundaries', () => {
+    expect(windowEnd(10000, 0)).toEqual(10000)
+    expect(windowEnd(10000, 9999)).toEqual(10000)
+    expect(windowEnd(10000, 10000)).toEqual(20000)
+    expect(windowEnd(60000, 1677628800123)).toEqual(1677628860000)
+
+    expect(checkWindow(10000)).toEqual(10000)
+    expect(() => checkWindow(999)).toThrowError('Invalid rollup window 999 (must be an integer >= 1000 ms)')
+    expect(() => checkWindow(1000.5)).toThrowError('Invalid rollup window 1000.5 (must be an integer >= 1000 ms)')
+  })
+
+  it('should emit rollups from a group', async () => {
+    const group = createPingerGroup({ interval: 100, rollup: 1000 })
+    try {
+      const pinger4 = await group.add('127.0.0.1')
+      const pinger6 = await group.add('::1')
+
+      expect(await group.add('127.0.0.1')).toBe(pinger4)
+      expect(group.get('::1')).toBe(pinger6)
+      expect(group.size).toEqual(2)
+
+      const rollups: [ Pinger, PingerRollup ][] = []
+      group.on('rollup', (pinger, rollup) => rollups.push([ pinger, rollup ]))
+
+      group.start()
+      expect(group.running).toBeTrue()
+      expect(pinger4.running).toBeTrue()
+      expect(pinger6.running).toBeTrue()
+
+      await new Promise((resolve) => setTimeout(resolve, 2100))
+      group.stop()
+
+      // at least one full window, one partial at start and one at stop
+      expect(rollups.length).toBeGreaterThanOrEqual(6)
+      for (const [ pinger, rollup ] of rollups) {
+        expect(rollup.target).toEqual(pinger.target)
+        expect(rollup.end).toBeGreaterThan(rollup.start)
+      }
+
+      const full = rollups.filter(([ , rollup ]) => (rollup.start % 1000 === 0) && (rollup.end % 1000 === 0))
+      expect(full.length).toBeGreaterThanOrEqual(2)
+      for (const [ , rollup ] of full) {
+        expect(rollup.end - rollup.start).toEqual(1000)
+        expect(rollup.received).toBeGreaterThanOrEqual(8)
+        expect(rollup.min).toBeLessThanOrEqual(rollup.p50)
+        expect(rollup.p50).toBeLessThanOrEqual(rollup.max)
+      }
+
+      expect(await group.remove('::1')).toBeTrue()
+      expect(await group.remove('::1')).toBeFalse()
+      expect(pinger6.closed).toBeTrue()
+      expect(group.size).toEqual(1)
+    } finally {
+      await group.close()
+    }
+  })
+})
@@ -0,0 +1,84 @@
+import { LossTracker, RUN_BUCKETS } from '../src/loss'
+
+describe('Loss patterns', () => {
+  // replay a pattern of received (".") and lost ("x") packets
+  function replay(tracker: LossTracker, pattern: string): LossTracker {
+    for (const char of pattern) char === 'x' ? tracker.lost(1) : tracker.received()
+    return tracker
+  }
+
+  // expected bucket counts from a map of { bucket index: count }
+  function buckets(counts: Record<number, number>): number[] {
+    return RUN_BUCKETS.map((_, i) => counts[i] || 0)
+  }
+
+  it('should distinguish isolated losses from bursts', () => {
+    const isolated = replay(new LossTracker(), '..x..x..x..x..x..').losses()
+    const burst = replay(new LossTracker(), '......xxxxx......').losses()
+
+    expect(isolated).toEqual({
+      bursts: buckets({ 0: 5 }),
+      gaps: buckets({ 1: 5 }),
+      p: 5 / 11, // 5 transitions out of 11 received packets followed by another one
+      r: 1, // every lost packet is followed by a received one
+      lost: false,
+      length: 2,
+    })
+
+    expect(burst).toEqual({
+      bursts: buckets({ 4: 1 }),
+      gaps: buckets({ 5: 1 }),
+      p: 1 / 11,
+      r: 1 / 5,
+      lost: false,
+      length: 6,
+    })
+  })
+
+  it('should record consecutive losses in one go', () => {
+    const tracker = new LossTracker()
+    tracker.received()
+    tracker.lost(3)
+    tracker.lost(0) // ignored
+    tracker.lost(2)
+    tracker.received()
+    tracker.lost(300)
+
+    expect(tracker.losses()).toEqual({
+      bursts: buckets({ 4: 1 }),
+      gaps: buckets({ 0: 2 }),
+      p: 1, // both received packets were followed by a loss
+      r: 1 / 304, // 1 transition to a received packet, out of 304 from lost ones
+      lost: true,
+      length: 300,
+    })
+  })
+
+  it('should reset counts but preserve the current run', () => {
+    const tracker = replay(new LossTracker(), 'xx...')
+    expect(tracker.losses()).toEqual(jasmine.objectContaining({
+      bursts: buckets({ 1: 1 }),
+      lost: false,
+      length: 3,
+    }))
+
+    replay(tracker, '..x')
+    expect(tracker.losses()).toEqual({
+      bursts: buckets({}),
+      gaps: buckets({ 4: 1 }),
+      p: 1 / 3,
+      r: NaN,
+      lost: true,
+      length: 1,
+    })
+
+    expect(tracker.losses()).toEqual({
+      bursts: buckets({}),
+      gaps: buckets({}),
+      p: NaN,
+      r: NaN,
+      lost: true,
+      length: 1,
+    })
+  })
+})
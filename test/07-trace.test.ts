@@ -0,0 +1,95 @@
+import { createPinger } from '../src/index'
+import { Tracer, TRACE_DELIVERED, TRACE_RECEIVED, TRACE_SENT, TRACE_VALIDATED } from '../src/trace'
+
+describe('Lifecycle tracing', () => {
+  it('should validate its options', () => {
+    expect(() => new Tracer({ sample: 0 })).toThrowError('Invalid trace sample rate 0')
+    expect(() => new Tracer({ sample: 1.5 })).toThrowError('Invalid trace sample rate 1.5')
+    expect(() => new Tracer({ size: 0 })).toThrowError('Invalid trace size 0')
+  })
+
+  it('should sample one sequence every N', () => {
+    const tracer = new Tracer({ sample: 10 })
+    expect(tracer.sampled(0)).toBeTrue()
+    expect(tracer.sampled(1)).toBeFalse()
+    expect(tracer.sampled(9)).toBeFalse()
+    expect(tracer.sampled(10)).toBeTrue()
+    expect(tracer.sampled(20)).toBeTrue()
+  })
+
+  it('should export complete events for each phase', () => {
+    const tracer = new Tracer({ sample: 1 })
+    tracer.start(1, 1000n, 2000n)
+    tracer.mark(1, TRACE_SENT, 4000n)
+    tracer.mark(1, TRACE_RECEIVED, 10000n)
+    tracer.mark(1, TRACE_VALIDATED, 11000n)
+    tracer.mark(1, TRACE_DELIVERED, 15000n)
+
+    // partial lifecycle (lost request)
+    tracer.start(2, 20000n, 21000n)
+    tracer.mark(2, TRACE_SENT, 22000n)
+
+    const pid = process.pid
+    expect(tracer.events(3, 'target')).toEqual([
+      { name: 'thread_name', cat: '__metadata', ph: 'M', pid, tid: 3, args: { name: 'target' } },
+      { name: 'build', cat: 'ping', ph: 'X', pid, tid: 3, ts: 1, dur: 1, args: { sequence: 1 } },
+      { name: 'send', cat: 'ping', ph: 'X', pid, tid: 3, ts: 2, dur: 2, args: { sequence: 1 } },
+      { name: 'network', cat: 'ping', ph: 'X', pid, tid: 3, ts: 4, dur: 6, args: { sequence: 1 } },
+      { name: 'validate', cat: 'ping', ph: 'X', pid, tid: 3, ts: 10, dur: 1, args: { sequence: 1 } },
+      { name: 'deliver', cat: 'ping', ph: 'X', pid, tid: 3, ts: 11, dur: 4, args: { sequence: 1 } },
+      { name: 'build', cat: 'ping', ph: 'X', pid, tid: 3, ts: 20, dur: 1, args: { sequence: 2 } },
+      { name: 'send', cat: 'ping', ph: 'X', pid, tid: 3, ts: 21, dur: 1, args: { sequence: 2 } },
+    ])
+  })
+
+  it('should overwrite older samples in its ring', () => {
+    const tracer = new Tracer({ sample: 2, size: 2 })
+    tracer.start(2, 1000n, 2000n)
+    tracer.start(4, 3000n, 4000n)
+    tracer.start(6, 5000n, 6000n) // overwrites 2
+    tracer.mark(2, TRACE_SENT, 7000n) // ignored, no longer in the ring
+
+    const sequences = tracer.events(1, 'target')
+        .filter((event) => event.ph === 'X')
+        .map((event) => event.args.sequence)
+    expect(sequences).toEqual([ 4, 6 ])
+  })
+
+  it('should shrink its ring keeping the most recent samples', () => {
+    const tracer = new Tracer({ sample: 1, size: 4 })
+    for (let i = 0; i < 4; i ++) tracer.start(i, BigInt(i * 1000), BigInt(i * 1000 + 500))
+    const bytes = tracer.bytes
+
+    expect(tracer.shrink()).toBeTrue()
+    expect(tracer.bytes).toEqual(bytes / 2)
+
+    const sequences = tracer.events(1, 'target')
+        .filter((event) => event.ph === 'X')
+        .map((event) => event.args.sequence)
+    expect(sequences).toEqual([ 2, 3 ])
+
+    expect(tracer.shrink()).toBeTrue()
+    expect(tracer.shrink()).toBeFalse()
+  })
+
+  it('should trace pings to localhost', async () => {
+    const pinger = await createPinger('127.0.0.1', { trace: { sample: 2 } })
+    try {
+      for (let i = 0; i < 4; i ++) await pinger.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      const { traceEvents, displayTimeUnit } = pinger.trace()
+      expect(displayTimeUnit).toEqual('ms')
+
+      const spans = traceEvents.filter((event) => event.ph === 'X')
+      expect(spans.map((event) => `${event.args.sequence}:${event.name}`)).toEqual([
+        '2:build', '2:send', '2:network', '2:validate', '2:deliver',
+        '4:build', '4:send', '4:network', '4:validate', '4:deliver',
+      ])
+
+      for (const span of spans) expect(span.dur).toBeGreaterThanOrEqual(0)
+    } finally {
+      await pinger.close()
+    }
+  })
+})
@@ -0,0 +1,186 @@
+import { mkdtemp, readFile, rm } from 'node:fs/promises'
+import { tmpdir } from 'node:os'
+import { join } from 'node:path'
+
+import { address, Capture, SNAPLEN } from '../src/capture'
+import { createPinger } from '../src/index'
+import { ERR_WRONG_CORRELATION } from '../src/protocol'
+
+import type { PingerCapture } from '../src/index'
+
+/** Parse the blocks of a pcapng file into `[ type, body ]` */
+function blocks(pcapng: Buffer): [ number, Buffer ][] {
+  const result: [ number, Buffer ][] = []
+  for (let offset = 0; offset < pcapng.length; ) {
+    const type = pcapng.readUInt32LE(offset)
+    const length = pcapng.readUInt32LE(offset + 4)
+    expect(pcapng.readUInt32LE(offset + length - 4)).toEqual(length)
+    result.push([ type, pcapng.subarray(offset + 8, offset + length - 4) ])
+    offset += length
+  }
+  return result
+}
+
+describe('Packet capture', () => {
+  it('should validate its options', () => {
+    expect(() => new Capture({ size: 0 })).toThrowError('Invalid capture size 0')
+    expect(() => new Capture({ warnings: 0 })).toThrowError('Invalid capture warnings 0')
+    expect(() => new Capture({ window: 0 })).toThrowError('Invalid capture window 0')
+  })
+
+  it('should convert addresses into bytes', () => {
+    expect([ ...address('10.0.1.2') ]).toEqual([ 10, 0, 1, 2 ])
+    expect(address('::1').toString('hex')).toEqual('00000000000000000000000000000001')
+    expect(address('fe80::1:2%eth0').toString('hex')).toEqual('fe800000000000000000000000010002')
+    expect(address('::ffff:10.0.1.2').toString('hex')).toEqual('00000000000000000000ffff0a000102')
+    expect(address('1:2:3:4:5:6:7:8').toString('hex')).toEqual('00010002000300040005000600070008')
+  })
+
+  it('should keep the last packets in its ring', () => {
+    const capture = new Capture({ size: 3 })
+    for (let i = 0; i < 5; i ++) capture.sent(Buffer.alloc(64, i), 1000 + i)
+    expect(capture.count).toEqual(3)
+
+    const [ shb, idb, ...epbs ] = blocks(capture.pcapng(undefined, '10.0.0.1'))
+    expect(shb![0]).toEqual(0x0a0d0d0a)
+    expect(shb![1].readUInt32LE(0)).toEqual(0x1a2b3c4d)
+    expect(idb![0]).toEqual(1)
+    expect(idb![1].readUInt16LE(0)).toEqual(228) // LINKTYPE_IPV4
+
+    // oldest first, 20 bytes IPv4 header + 64 bytes of packet
+    expect(epbs.length).toEqual(3)
+    epbs.forEach(([ type, body ], i) => {
+      expect(type).toEqual(6)
+      expect(body.readUInt32LE(8)).toEqual((1002 + i) * 1000) // timestamp (low)
+      expect(body.readUInt32LE(12)).toEqual(84) // captured length
+      expect(body.readUInt32LE(16)).toEqual(84) // original length
+      expect(body.readUInt8(20)).toEqual(0x45) // IPv4 header
+      expect(body.subarray(32, 36).toString('hex')).toEqual('00000000') // source
+      expect(body.subarray(36, 40).toString('hex')).toEqual('0a000001') // destination
+      expect(body.readUInt8(40)).toEqual(2 + i) // packet contents
+      expect(body.readUInt16LE(104)).toEqual(2) // epb_flags
+      expect(body.readUInt32LE(108)).toEqual(2) // outbound
+    })
+  })
+
+  it('should shrink its ring keeping the last packets', () => {
+    const capture = new Capture({ size: 5 })
+    for (let i = 0; i < 7; i ++) capture.sent(Buffer.alloc(64, i), 1000 + i)
+    const bytes = capture.bytes
+
+    expect(capture.shrink()).toBeTrue()
+    expect(capture.bytes).toBeLessThan(bytes)
+    expect(capture.count).toEqual(2)
+    capture.sent(Buffer.alloc(64, 7), 1007)
+
+    const [ , , ...epbs ] = blocks(capture.pcapng(undefined, '10.0.0.1'))
+    expect(epbs.map(([ , body ]) => body.readUInt8(40))).toEqual([ 6, 7 ])
+
+    expect(capture.shrink()).toBeTrue()
+    expect(capture.count).toEqual(1)
+    expect(capture.shrink()).toBeFalse()
+  })
+
+  it('should capture received and rejected packets', () => {
+    const capture = new Capture()
+    capture.received(Buffer.alloc(64), 1, 1000n)
+    capture.received(Buffer.alloc(SNAPLEN * 2), 2, ERR_WRONG_CORRELATION)
+
+    const [ , idb, accepted, rejected ] = blocks(capture.pcapng('::1', '::2'))
+    expect(idb![1].readUInt16LE(0)).toEqual(229) // LINKTYPE_IPV6
+
+    // accepted, 40 bytes IPv6 header from target to us, inbound, no comment
+    expect(accepted![1].readUInt32LE(12)).toEqual(104)
+    expect(accepted![1].readUInt8(20) >> 4).toEqual(6)
+    expect(accepted![1].subarray(28, 44).toString('hex')).toEqual('00000000000000000000000000000002')
+    expect(accepted![1].subarray(44, 60).toString('hex')).toEqual('00000000000000000000000000000001')
+    expect(accepted![1].readUInt32LE(128)).toEqual(1) // inbound
+    expect(accepted![1].readUInt16LE(132)).toEqual(0) // end of options
+
+    // rejected, truncated to SNAPLEN and commented
+    expect(rejected![1].readUInt32LE(12)).toEqual(40 + SNAPLEN)
+    expect(rejected![1].readUInt32LE(16)).toEqual(40 + SNAPLEN * 2)
+    expect(rejected![1].toString('utf8')).toContain('ERR_WRONG_CORRELATION')
+  })
+
+  it('should detect warning storms', () => {
+    const capture = new Capture({ warnings: 3, window: 100 })
+    expect(capture.warning(0)).toBeFalse()
+    expect(capture.warning(50)).toBeFalse()
+    expect(capture.warning(200)).toBeFalse() // 0 ... 200 is outside our window
+    expect(capture.warning(210)).toBeFalse() // 50 ... 210 is outside our window
+    expect(capture.warning(220)).toBeTrue() // 200 ... 220 is a storm
+  })
+
+  it('should rearm only after the ring was refreshed', () => {
+    const capture = new Capture({ size: 2 })
+    expect(capture.armed).toBeTrue()
+    capture.disarm()
+    capture.sent(Buffer.alloc(64), 1)
+    expect(capture.armed).toBeFalse()
+    capture.pcapng(undefined, '10.0.0.1') // on demand, does not rearm
+    capture.sent(Buffer.alloc(64), 2)
+    expect(capture.armed).toBeTrue()
+  })
+
+  it('should capture pings to localhost and dump on warning storms', async () => {
+    const directory = await mkdtemp(join(tmpdir(), 'ping-capture-'))
+    const pinger = await createPinger('127.0.0.1', { capture: { warnings: 1, directory } })
+    try {
+      expect(pinger.capture()!.length).toEqual(48) // SHB + IDB
+      await pinger.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+      expect(blocks(pinger.capture()!).length).toEqual(4) // request + reply
+
+      const captures: PingerCapture[] = []
+      pinger.on('capture', (capture) => captures.push(capture))
+      pinger.on('warning', () => void 0)
+
+      // mess up whe sequence number to get a warning
+      ;((<any> pinger).__handler.__seq_out --)
+      await pinger.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      expect(captures.length).toEqual(1)
+      expect(captures[0]!.reason).toEqual('storm')
+      expect(captures[0]!.file).toContain(directory)
+      expect(await readFile(captures[0]!.file!)).toEqual(captures[0]!.data)
+      expect(blocks(captures[0]!.data).length).toEqual(6)
+    } finally {
+      await pinger.close()
+      await rm(directory, { recursive: true })
+    }
+  })
+
+  it('should capture packets from other sources, without accepting them', async () => {
+    const pinger = await createPinger('127.0.0.1', { capture: {} })
+    try {
+      const warnings: string[] = []
+      pinger.on('warning', (code) => warnings.push(code))
+
+      // a reply from somewhere else, as delivered by the socket
+      const reply = Buffer.alloc(64)
+      ;(<any> pinger).__socket.emit('message', reply, { address: '127.0.0.9', family: 'IPv4', port: 0, size: 64 })
+
+      expect(warnings).toEqual([])
+      expect(pinger.stats()).toEqual({ sent: 0, received: 0, latency: NaN })
+
+      const [ , , stray ] = blocks(pinger.capture()!)
+      expect(stray![1].readUInt32LE(12)).toEqual(84) // 20 bytes IPv4 header + 64 bytes of packet
+      expect(stray![1].subarray(32, 36).toString('hex')).toEqual('7f000009') // real source
+      expect(stray![1].readUInt32LE(108)).toEqual(1) // inbound
+      expect(stray![1].toString('utf8')).toContain('ERR_WRONG_SOURCE')
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should not capture by default', async () => {
+    const pinger = await createPinger('127.0.0.1')
+    try {
+      expect(pinger.capture()).toBeUndefined()
+    } finally {
+      await pinger.close()
+    }
+  })
+})
@@ -0,0 +1,91 @@
+import native from '../native/ping.cjs'
+import { address, Capture } from '../src/capture'
+import { replay } from '../src/index'
+import { ProtocolHandler } from '../src/protocol'
+
+describe('Offline replay', () => {
+  it('should replay a pcapng capture', async () => {
+    const handler = new ProtocolHandler(false)
+    const capture = new Capture({ size: 100 })
+    const start = 1677628800000
+
+    for (let i = 0; i < 10; i ++) {
+      const request = handler.outgoing()
+      const reply = Buffer.from(request)
+      reply.writeUInt8(0x00, 0) // ECHO Reply
+      reply.writeUInt16BE(0x00, 2) // checksum
+      reply.writeUInt16BE(native.checksum(reply), 2)
+
+      capture.sent(request, start + i * 1000)
+      if (i === 4) continue // lost
+      capture.received(reply, start + i * 1000 + 5, 0n)
+      if (i === 2) capture.received(reply, start + i * 1000 + 6, 0n) // duplicate
+      if (i === 7) capture.received(Buffer.from(reply).fill(0xff, 8, 9), start + i * 1000 + 7, 0n) // corrupted
+    }
+
+    const result = await replay(capture.pcapng('10.0.0.2', '10.0.0.1'))
+    expect(result).toEqual({
+      packets: 21,
+      elapsed: jasmine.any(Number),
+      rate: jasmine.any(Number),
+      stats: { '10.0.0.1': { sent: 10, received: 9, latency: 5 } },
+      warnings: { ERR_SEQUENCE_TOO_SMALL: 1, ERR_WRONG_CHECKSUM: 1 },
+    })
+    expect(result.rate).toBeGreaterThan(0)
+  })
+
+  it('should replay a big endian pcap capture of ethernet frames', async () => {
+    const handler = new ProtocolHandler(true)
+    const request = handler.outgoing()
+    const reply = Buffer.from(request)
+    reply.writeUInt8(0x81, 0) // ECHO Reply
+    reply.writeUInt16BE(0x00, 2) // checksum, with the pseudo header
+    reply.writeUInt16BE(native.checksum(reply, address('2001:db8::1'), address('2001:db8::2')), 2)
+
+    // ethernet + ipv6 header
+    function frame(icmp: Buffer, source: string, destination: string): Buffer {
+      const header = Buffer.alloc(54)
+      header.writeUInt16BE(0x86dd, 12)
+      header.writeUInt32BE(0x60000000, 14)
+      header.writeUInt16BE(icmp.length, 18)
+      header.writeUInt8(58, 20)
+      address(source).copy(header, 22)
+      address(destination).copy(header, 38)
+      return Buffer.concat([ header, icmp ])
+    }
+
+    // record, with nanosecond resolution
+    function record(data: Buffer, seconds: number, nanos: number): Buffer {
+      const header = Buffer.alloc(16)
+      header.writeUInt32BE(seconds, 0)
+      header.writeUInt32BE(nanos, 4)
+      header.writeUInt32BE(data.length, 8)
+      header.writeUInt32BE(data.length, 12)
+      return Buffer.concat([ header, data ])
+    }
+
+    const header = Buffer.alloc(24)
+    header.writeUInt32BE(0xa1b23c4d, 0) // nanoseconds magic
+    header.writeUInt16BE(2, 4)
+    header.writeUInt16BE(4, 6)
+    header.writeUInt32BE(65535, 16)
+    header.writeUInt32BE(1, 20) // ethernet
+
+    const pcap = Buffer.concat([
+      header,
+      record(frame(request, '2001:db8::2', '2001:db8::1'), 1000, 999999000),
+      record(frame(reply, '2001:db8::1', '2001:db8::2'), 1001, 2001234), // 2.002234 ms later
+    ])
+
+    expect(await replay(pcap)).toEqual(jasmine.objectContaining({
+      packets: 2,
+      stats: { '2001:db8::1': { sent: 1, received: 1, latency: 2.002234 } },
+      warnings: {},
+    }))
+  })
+
+  it('should fail on invalid files', async () => {
+    await expectAsync(replay(Buffer.alloc(10))).toBeRejectedWithError(Error, 'Invalid capture file (too short)')
+    await expectAsync(replay(Buffer.alloc(32))).toBeRejectedWithError(Error, 'Invalid capture file (magic=0x0)')
+  })
+})
@@ -0,0 +1,200 @@
+import { existsSync, statSync } from 'node:fs'
+import { tmpdir } from 'node:os'
+import { join } from 'node:path'
+
+import { createPingerGroup, handoff, receiveHandoff } from '../src/index'
+import { ProtocolHandler } from '../src/protocol'
+import { decodeStates, encodeStates, StateWriter } from '../src/state'
+
+import type { PingerState } from '../src/state'
+
+describe('Socket handoff', () => {
+  let count = 0
+  function path(): string {
+    return join(tmpdir(), `ping-handoff-${process.pid}-${++ count}.sock`)
+  }
+
+  it('should encode and decode pinger states', () => {
+    const handler = new ProtocolHandler(true)
+    handler.outgoing()
+    handler.outgoing()
+
+    const state: PingerState = {
+      to: 'localhost',
+      target: '::1',
+      protocol: 'ipv6',
+      from: '::1',
+      source: undefined,
+      timeout: 5000,
+      interval: 100,
+      fd: 3,
+      handler: handler.save(),
+      stats: { sent: 2, received: 1, latency: 123456789n },
+    }
+
+    expect(state.handler.inflight.length).toEqual(2)
+    expect(decodeStates(encodeStates([ state, state ]))).toEqual([ state, state ])
+
+    // kernels truncating sequences are remembered as well
+    const truncated = { ...state, handler: { ...state.handler, truncated: true } }
+    expect(decodeStates(encodeStates([ truncated ]))).toEqual([ truncated ])
+
+    // creation options are remembered, including those not set
+    const options = { ...state, options: { detector: { threshold: 7 }, hibernate: 500, heatmap: undefined } }
+    const decoded = decodeStates(encodeStates([ options ]))
+    expect(decoded).toEqual([ options ])
+    expect(Object.keys(decoded[0]!.options!)).toEqual([ 'detector', 'hibernate', 'heatmap' ])
+  })
+
+  it('should skip unknown sections when decoding', () => {
+    const writer = new StateWriter()
+        .u32(0x4a505354).u16(1).u32(1) // magic, version, count
+        .string('to').string('127.0.0.1').u8(4).string('').string('').u32(1).u32(2).i32(-1)
+        .section(99, (writer) => writer.string('unknown'))
+        .section(1, (writer) => writer.bytes(Buffer.alloc(64, 8)).u32(5).u32(4).u32(0))
+        .u8(0)
+
+    expect(decodeStates(writer.finish())).toEqual([ jasmine.objectContaining({
+      to: 'to',
+      target: '127.0.0.1',
+      protocol: 'ipv4',
+      from: undefined,
+      source: undefined,
+      handler: { packet: Buffer.alloc(64, 8), sent: 5, received: 4, inflight: [] },
+      stats: { sent: 0, received: 0, latency: 0n },
+    }) ])
+  })
+
+  it('should not decode invalid states', () => {
+    expect(() => decodeStates(Buffer.from('nope nope nope')))
+        .toThrowError('Invalid pinger state (wrong magic)')
+    expect(() => decodeStates(new StateWriter().u32(0x4a505354).u16(99).u32(0).finish()))
+        .toThrowError('Unsupported pinger state version 99')
+    expect(() => decodeStates(new StateWriter().u32(0x4a505354).u16(1).u32(1).string('to').finish()))
+        .toThrowError('Invalid pinger state (truncated)')
+  })
+
+  it('should hand off sockets and in-flight requests', async () => {
+    const socket = path()
+    const group = createPingerGroup({ interval: 100 })
+    const received = receiveHandoff(socket, { interval: 100 })
+
+    try {
+      const pinger4 = await group.add('127.0.0.1')
+      const pinger6 = await group.add('::1')
+
+      await pinger4.ping()
+      await pinger6.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      // ping again, and hand off right after sending, before the reply is processed
+      await pinger4.ping()
+      await handoff(socket, group)
+
+      expect(group.size).toEqual(0)
+      expect(pinger4.closed).toBeTrue()
+      expect(pinger6.closed).toBeTrue()
+      expect(existsSync(socket)).toBeFalse()
+
+      const adopted = await received
+      try {
+        expect([ ...adopted.entries() ].map(([ to ]) => to)).toEqual([ '127.0.0.1', '::1' ])
+
+        // the reply to our last request is processed by the adopted pinger
+        const pongs: number[] = []
+        adopted.on('pong', (_, latency) => pongs.push(latency))
+        await new Promise((resolve) => setTimeout(resolve, 100))
+        expect(pongs.length).toEqual(1)
+
+        // probing continues with the same sockets and sequences
+        await adopted.get('127.0.0.1')!.ping()
+        await new Promise((resolve) => setTimeout(resolve, 100))
+        expect(pongs.length).toEqual(2)
+
+        const stats = adopted.stats()
+        expect(stats['127.0.0.1']).toEqual({ sent: 3, received: 3, latency: jasmine.any(Number) })
+        expect(stats['::1']).toEqual({ sent: 1, received: 1, latency: jasmine.any(Number) })
+      } finally {
+        await adopted.close()
+      }
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should keep the options pingers were created with', async () => {
+    const socket = path()
+    const group = createPingerGroup({ interval: 100, heatmap: {} })
+    const received = receiveHandoff(socket, { interval: 100, hibernate: 1000 })
+
+    try {
+      await group.add('127.0.0.1', { hibernate: 5000 })
+      await group.add('::1', { heatmap: undefined })
+      await handoff(socket, group)
+
+      const adopted = await received
+      try {
+        // the sender's defaults and per-target options win over the receiver's defaults
+        expect(adopted.get('127.0.0.1')!.heatmap()).toBeInstanceOf(Buffer)
+        expect(adopted.get('::1')!.heatmap()).toBeUndefined()
+
+        // reconciling with what the sender had changes nothing
+        expect(await adopted.reconcile({
+          '127.0.0.1': { heatmap: {}, hibernate: 5000 },
+          '::1': { heatmap: undefined, hibernate: undefined },
+        })).toEqual({ added: [], removed: [], retuned: [], replaced: [] })
+
+        // while the receiver's defaults alone replace the pingers
+        expect(await adopted.reconcile([ '127.0.0.1', '::1' ]))
+            .toEqual({ added: [], removed: [], retuned: [], replaced: [ '127.0.0.1', '::1' ] })
+      } finally {
+        await adopted.close()
+      }
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should not touch the group when nobody is listening', async () => {
+    const group = createPingerGroup({ interval: 100 })
+    try {
+      const pinger = await group.add('127.0.0.1')
+      group.start()
+
+      await expectAsync(handoff(path(), group))
+          .toBeRejectedWith(jasmine.objectContaining({ syscall: 'connect', code: 'ENOENT' }))
+
+      expect(group.running).toBeTrue()
+      expect(pinger.closed).toBeFalse()
+      expect(pinger.running).toBeTrue()
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should only let our own user connect', async () => {
+    const socket = path()
+    const received = receiveHandoff(socket, {}, 5000)
+    const group = createPingerGroup()
+
+    try {
+      expect(statSync(socket).mode & 0o777).toEqual(0o600)
+
+      await group.add('127.0.0.1')
+      await handoff(socket, group)
+
+      const adopted = await received
+      expect([ ...adopted.entries() ].map(([ to ]) => to)).toEqual([ '127.0.0.1' ])
+      await adopted.close()
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should time out when nobody hands off', async () => {
+    const socket = path()
+    await expectAsync(receiveHandoff(socket, {}, 100))
+        .toBeRejectedWith(jasmine.objectContaining({ syscall: 'accept', code: 'ETIMEDOUT' }))
+    expect(existsSync(socket)).toBeFalse()
+  })
+})
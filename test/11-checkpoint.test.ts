@@ -0,0 +1,214 @@
+import { mkdtemp, readdir, rm, writeFile } from 'node:fs/promises'
+import { tmpdir } from 'node:os'
+import { join } from 'node:path'
+
+import { ChangeDetector } from '../src/detector'
+import { checkpoint, createPingerGroup, restoreCheckpoint } from '../src/index'
+import { LossTracker } from '../src/loss'
+import { ProtocolHandler } from '../src/protocol'
+import { RollupAccumulator } from '../src/rollup'
+import { decodeStates, encodeStates } from '../src/state'
+
+import type { PingerState } from '../src/state'
+
+describe('Checkpoints', () => {
+  let directory: string
+
+  beforeEach(async () => {
+    directory = await mkdtemp(join(tmpdir(), 'ping-checkpoint-'))
+  })
+
+  afterEach(async () => {
+    await rm(directory, { recursive: true })
+  })
+
+  it('should save and restore detectors, losses and rollups', () => {
+    const detector = new ChangeDetector({ warmup: 10 })
+    const losses = new LossTracker()
+    const rollups = new RollupAccumulator()
+
+    for (let i = 0; i < 20; i ++) {
+      detector.latency(10 + (i % 3))
+      detector.loss(i === 5)
+      if (i % 7) losses.received()
+      else losses.lost(2)
+      rollups.received(10 + (i % 3))
+    }
+
+    const detector2 = new ChangeDetector({ warmup: 10 })
+    const losses2 = new LossTracker()
+    const rollups2 = new RollupAccumulator()
+
+    detector2.restore(detector.save())
+    losses2.restore(losses.save())
+    rollups2.restore(rollups.save())
+
+    // no warmup: both detectors see the same jump at the same time
+    const changes: [ any, any ][] = []
+    for (let i = 0; i < 10; i ++) changes.push([ detector.latency(50), detector2.latency(50) ])
+    expect(changes.some(([ change ]) => change)).toBeTrue()
+    for (const [ change, change2 ] of changes) expect(change2).toEqual(change)
+
+    expect(losses2.losses()).toEqual(losses.losses())
+    expect(rollups2.rollup('x', 1, 2)).toEqual(rollups.rollup('x', 1, 2))
+  })
+
+  it('should not restore invalid states', () => {
+    expect(() => new ChangeDetector().restore([ 1, 2, 3 ]))
+        .toThrowError('Invalid detector state (length=3)')
+    expect(() => new LossTracker().restore([ 1, 2, 3 ]))
+        .toThrowError('Invalid losses state (length=3)')
+    expect(() => new RollupAccumulator().restore({ values: [], histogram: new RollupAccumulator().histogram.save() }))
+        .toThrowError('Invalid rollup state (length=0)')
+    expect(() => new RollupAccumulator().histogram.restore({ resolution: 3, buckets: new Uint32Array(78) }))
+        .toThrowError('Invalid histogram state (resolution=3, buckets=78)')
+  })
+
+  it('should encode and decode the optional sections', () => {
+    const rollups = new RollupAccumulator()
+    rollups.received(1.5)
+    rollups.received(2.5)
+
+    const state: PingerState = {
+      to: 'localhost',
+      target: '127.0.0.1',
+      protocol: 'ipv4',
+      from: undefined,
+      source: undefined,
+      timeout: 1000,
+      interval: 100,
+      fd: -1,
+      handler: new ProtocolHandler(false).save(),
+      stats: { sent: 0, received: 0, latency: 0n },
+      detector: new ChangeDetector().save(),
+      losses: new LossTracker().save(),
+      rollup: rollups.save(),
+    }
+
+    expect(decodeStates(encodeStates([ state ]))).toEqual([ state ])
+  })
+
+  it('should checkpoint and restore a group', async () => {
+    const file = join(directory, 'checkpoint.bin')
+    const group = createPingerGroup({ interval: 100 })
+
+    try {
+      const pinger = await group.add('127.0.0.1')
+      await group.add('::1')
+
+      for (let i = 0; i < 3; i ++) {
+        await pinger.ping()
+        await new Promise((resolve) => setTimeout(resolve, 20))
+      }
+
+      await checkpoint(file, group)
+      expect(await readdir(directory)).toEqual([ 'checkpoint.bin' ])
+    } finally {
+      await group.close()
+    }
+
+    const restored = await restoreCheckpoint(file, { interval: 100 })
+    try {
+      expect(restored.running).toBeFalse()
+      expect([ ...restored.entries() ].map(([ to ]) => to)).toEqual([ '127.0.0.1', '::1' ])
+
+      // sequences carry on, and statistics accumulated before are kept
+      const pinger = restored.get('127.0.0.1')!
+      const pongs: number[] = []
+      restored.on('pong', (_, latency) => pongs.push(latency))
+      restored.on('warning', (_, code) => fail(`Unexpected warning ${code}`))
+
+      await pinger.ping()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+
+      expect(pongs.length).toEqual(1)
+      expect(pinger.stats()).toEqual({ sent: 4, received: 4, latency: jasmine.any(Number) })
+      expect(restored.get('::1')!.stats()).toEqual({ sent: 0, received: 0, latency: NaN })
+    } finally {
+      await restored.close()
+    }
+  })
+
+  it('should restore without resolving host names', async () => {
+    const file = join(directory, 'checkpoint.bin')
+    const state: PingerState = {
+      to: 'unresolvable.invalid',
+      target: '127.0.0.1',
+      protocol: 'ipv4',
+      from: undefined,
+      source: undefined,
+      timeout: 1000,
+      interval: 100,
+      fd: -1,
+      handler: new ProtocolHandler(false).save(),
+      stats: { sent: 0, received: 0, latency: 0n },
+    }
+    await writeFile(file, encodeStates([ state ]))
+
+    const restored = await restoreCheckpoint(file)
+    try {
+      expect(restored.get('unresolvable.invalid')).toEqual(jasmine.objectContaining({
+        target: '127.0.0.1',
+        timeout: 1000,
+        interval: 100,
+      }))
+    } finally {
+      await restored.close()
+    }
+  })
+
+  it('should restore many pingers in order, opening sockets concurrently', async () => {
+    const file = join(directory, 'checkpoint.bin')
+    const states: PingerState[] = []
+    for (let i = 1; i <= 200; i ++) {
+      states.push({
+        to: `target-${i}`,
+        target: `127.0.2.${i}`,
+        protocol: 'ipv4',
+        from: undefined,
+        source: undefined,
+        timeout: 1000,
+        interval: 100,
+        fd: -1,
+        handler: new ProtocolHandler(false).save(),
+        stats: { sent: i, received: 0, latency: 0n },
+      })
+    }
+    await writeFile(file, encodeStates(states))
+
+    const restored = await restoreCheckpoint(file)
+    try {
+      const entries = [ ...restored.entries() ]
+      expect(entries.map(([ to ]) => to)).toEqual(states.map(({ to }) => to))
+      expect(entries.map(([ , pinger ]) => pinger.stats().sent)).toEqual(states.map(({ stats }) => stats.sent))
+    } finally {
+      await restored.close()
+    }
+  })
+
+  it('should close all pingers opened when restoring fails', async () => {
+    const file = join(directory, 'checkpoint.bin')
+    const state = (to: string, source?: string): PingerState => ({
+      to,
+      target: '127.0.0.1',
+      protocol: 'ipv4',
+      from: undefined,
+      source,
+      timeout: 1000,
+      interval: 100,
+      fd: -1,
+      handler: new ProtocolHandler(false).save(),
+      stats: { sent: 0, received: 0, latency: 0n },
+    })
+    await writeFile(file, encodeStates([ state('a'), state('b', 'no-such-interface'), state('c') ]))
+
+    await expectAsync(restoreCheckpoint(file))
+        .toBeRejectedWithError(Error, 'Invalid source interface name "no-such-interface"')
+  })
+
+  it('should fail restoring invalid checkpoints', async () => {
+    const file = join(directory, 'checkpoint.bin')
+    await writeFile(file, 'nope nope nope')
+    await expectAsync(restoreCheckpoint(file)).toBeRejectedWithError(Error, 'Invalid pinger state (wrong magic)')
+  })
+})
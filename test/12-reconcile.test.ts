@@ -0,0 +1,161 @@
+import { createPingerGroup } from '../src/index'
+
+describe('Group reconciliation', () => {
+  it('should add, remove, retune and replace only what changed', async () => {
+    const group = createPingerGroup({ interval: 100 })
+    try {
+      await group.reconcile([ '127.0.0.1', '::1', '127.0.0.2' ])
+      group.start()
+
+      const kept = group.get('127.0.0.1')!
+      const retuned = group.get('::1')!
+      const replaced = group.get('127.0.0.2')!
+
+      await kept.ping()
+      await new Promise((resolve) => setTimeout(resolve, 50))
+
+      const result = await group.reconcile({
+        '127.0.0.1': {},
+        '::1': { timeout: 1000, interval: 200 },
+        '127.0.0.2': { from: '127.0.0.1' },
+        '127.0.0.3': {},
+      })
+
+      expect(result).toEqual({
+        added: [ '127.0.0.3' ],
+        removed: [],
+        retuned: [ '::1' ],
+        replaced: [ '127.0.0.2' ],
+      })
+
+      // unchanged and retuned pingers are the very same instances
+      expect(group.get('127.0.0.1')).toBe(kept)
+      expect(kept.closed).toBeFalse()
+      expect(group.get('::1')).toBe(retuned)
+      expect(retuned).toEqual(jasmine.objectContaining({ timeout: 1000, interval: 200, running: true }))
+
+      // replaced pingers are new, started, and the old ones closed
+      expect(group.get('127.0.0.2')).not.toBe(replaced)
+      expect(group.get('127.0.0.2')!.from).toEqual('127.0.0.1')
+      expect(group.get('127.0.0.2')!.running).toBeTrue()
+      expect(replaced.closed).toBeTrue()
+
+      const removed = group.get('127.0.0.3')!
+      expect(removed.running).toBeTrue()
+
+      // removing, and nothing to do
+      expect(await group.reconcile({
+        '127.0.0.1': {},
+        '::1': { timeout: 1000, interval: 200 },
+        '127.0.0.2': { from: '127.0.0.1' },
+      })).toEqual({
+        added: [],
+        removed: [ '127.0.0.3' ],
+        retuned: [],
+        replaced: [],
+      })
+      expect(removed.closed).toBeTrue()
+      expect(group.size).toEqual(3)
+
+      expect(await group.reconcile({
+        '127.0.0.1': {},
+        '::1': { timeout: 1000, interval: 200 },
+        '127.0.0.2': { from: '127.0.0.1' },
+      })).toEqual({ added: [], removed: [], retuned: [], replaced: [] })
+
+      // the kept pinger keeps its stats and sequence
+      expect(kept.stats().received).toBeGreaterThanOrEqual(1)
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should replace pingers whose creation-only options changed', async () => {
+    const group = createPingerGroup({ interval: 100, detector: { threshold: 5 } })
+    try {
+      await group.reconcile({ '127.0.0.1': {}, '127.0.0.2': { trace: {} } })
+      const kept = group.get('127.0.0.1')!
+      const traced = group.get('127.0.0.2')!
+
+      // the same options (merged with the group's defaults) change nothing
+      expect(await group.reconcile({
+        '127.0.0.1': { detector: { threshold: 5 } },
+        '127.0.0.2': { trace: {} },
+      })).toEqual({ added: [], removed: [], retuned: [], replaced: [] })
+
+      const result = await group.reconcile({
+        '127.0.0.1': { heatmap: {} },
+        '127.0.0.2': { trace: {}, detector: { threshold: 8 } },
+      })
+
+      expect(result).toEqual({
+        added: [],
+        removed: [],
+        retuned: [],
+        replaced: [ '127.0.0.1', '127.0.0.2' ],
+      })
+
+      expect(kept.closed).toBeTrue()
+      expect(traced.closed).toBeTrue()
+      expect(group.get('127.0.0.1')!.heatmap()).toBeInstanceOf(Buffer)
+
+      // replacements remember the options they were created with
+      expect(await group.reconcile({
+        '127.0.0.1': { heatmap: {} },
+        '127.0.0.2': { trace: {}, detector: { threshold: 8 } },
+      })).toEqual({ added: [], removed: [], retuned: [], replaced: [] })
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should replace pingers whose identifier or hibernation changed', async () => {
+    const group = createPingerGroup({ interval: 100 })
+    try {
+      await group.reconcile({
+        '127.0.0.1': { identifier: 4331 },
+        '127.0.0.2': { hibernate: 1000 },
+      })
+      const identified = group.get('127.0.0.1')!
+      const hibernating = group.get('127.0.0.2')!
+      expect(identified.identifier).toEqual(4331)
+
+      const result = await group.reconcile({
+        '127.0.0.1': { identifier: 4332 },
+        '127.0.0.2': { hibernate: 2000 },
+      })
+
+      expect(result).toEqual({
+        added: [],
+        removed: [],
+        retuned: [],
+        replaced: [ '127.0.0.1', '127.0.0.2' ],
+      })
+
+      expect(identified.closed).toBeTrue()
+      expect(hibernating.closed).toBeTrue()
+      expect(group.get('127.0.0.1')!.identifier).toEqual(4332)
+
+      // dropping them replaces the pingers again, keeping them is a no-op
+      expect(await group.reconcile({ '127.0.0.1': {}, '127.0.0.2': {} }))
+          .toEqual({ added: [], removed: [], retuned: [], replaced: [ '127.0.0.1', '127.0.0.2' ] })
+      expect(await group.reconcile({ '127.0.0.1': {}, '127.0.0.2': {} }))
+          .toEqual({ added: [], removed: [], retuned: [], replaced: [] })
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should apply all changes before reporting a failure', async () => {
+    const group = createPingerGroup()
+    try {
+      await group.add('127.0.0.1')
+      await expectAsync(group.reconcile({ '::1': {}, '127.0.0.2': { source: 'not-an-interface' } }))
+          .toBeRejectedWithError(Error, 'Invalid source interface name "not-an-interface"')
+
+      expect([ ...group.entries() ].map(([ to ]) => to)).toEqual([ '::1' ])
+    } finally {
+      await group.close()
+    }
+  })
+})
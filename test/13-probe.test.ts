@@ -0,0 +1,94 @@
+import { VirtualClock } from '../src/clock'
+import { createPinger } from '../src/index'
+import { ProbeTable } from '../src/probe'
+
+describe('Awaitable probes', () => {
+  it('should resolve probes in order, rejecting the ones overtaken', async () => {
+    const table = new ProbeTable(() => 1000000000n, () => {})
+    const results: any[] = []
+    const probe = (sequence: number): Promise<void> => new Promise<any>((resolve, reject) => {
+      table.add(sequence, process.hrtime.bigint(), resolve, reject)
+    }).then((result) => results.push(result), (error) => results.push(error.message))
+
+    const probes = [ probe(0xfffffffe), probe(0xffffffff), probe(0), probe(1) ]
+    expect(table.size).toEqual(4)
+
+    table.settle(0xffffffff, 1.5) // wraps around
+    table.settle(1, 2.5) // skips zero
+    table.settle(1, 3.5) // duplicate, ignored
+    await Promise.all(probes)
+
+    expect(table.size).toEqual(0)
+    expect(results).toEqual([
+      'Probe lost (seq=4294967294, overtaken by seq=4294967295)',
+      { seq: 0xffffffff, rtt: 1.5 },
+      'Probe lost (seq=0, overtaken by seq=1)',
+      { seq: 1, rtt: 2.5 },
+    ])
+  })
+
+  it('should time out probes on a single timer', async () => {
+    let expired = 0
+    const table = new ProbeTable(() => 50000000n, () => expired ++)
+    const errors: string[] = []
+
+    const probes: Promise<void>[] = []
+    const start = process.hrtime.bigint()
+    for (let i = 0; i < 1000; i ++) {
+      probes.push(new Promise<any>((resolve, reject) => table.add(i, start + (i < 500 ? 0n : 20000000n), resolve, reject))
+          .catch((error) => void errors.push(error.message)))
+    }
+
+    await Promise.all(probes)
+
+    // two deadlines 20ms apart: a few firings (some early), not one per probe
+    expect(expired).toBeGreaterThanOrEqual(2)
+    expect(expired).toBeLessThan(10)
+    expect(errors.length).toEqual(1000)
+    expect(errors[0]).toEqual('Probe timed out (seq=0, timeout=50ms)')
+    expect(Number(process.hrtime.bigint() - start) / 1000000).toBeGreaterThanOrEqual(69)
+  })
+
+  it('should time out probes on its own clock', async () => {
+    const clock = new VirtualClock()
+    const table = new ProbeTable(() => 50000000n, () => {}, clock)
+    const rejected = new Promise((resolve, reject) => table.add(1, clock.now(), resolve, reject))
+
+    clock.run(49000000)
+    expect(table.size).toEqual(1)
+    clock.run(50000000)
+    expect(table.size).toEqual(0)
+    await expectAsync(rejected).toBeRejectedWithError(Error, 'Probe timed out (seq=1, timeout=50ms)')
+  })
+
+  it('should reject probes when cleared', async () => {
+    const table = new ProbeTable(() => 1000000000n, () => fail('Expired'))
+    const probe = new Promise((resolve, reject) => table.add(1, process.hrtime.bigint(), resolve, reject))
+
+    table.clear(new Error('Foo!'))
+    await expectAsync(probe).toBeRejectedWithError(Error, 'Foo!')
+    expect(table.size).toEqual(0)
+  })
+
+  it('should probe localhost', async () => {
+    const pinger = await createPinger('127.0.0.1')
+    try {
+      const probes = await Promise.all(new Array(100).fill(0).map(() => pinger.probe()))
+
+      expect(probes.map(({ seq }) => seq)).toEqual(probes.map((_, i) => probes[0]!.seq + i))
+      for (const { rtt } of probes) expect(rtt).toBeGreaterThan(0)
+      expect(pinger.stats()).toEqual({ sent: 100, received: 100, latency: jasmine.any(Number) })
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should reject probes when closed', async () => {
+    const pinger = await createPinger('127.0.0.1')
+
+    const probe = pinger.probe()
+    await pinger.close()
+    await expectAsync(probe).toBeRejectedWithError(Error, 'Socket closed')
+    await expectAsync(pinger.probe()).toBeRejectedWithError(Error, 'Socket closed')
+  })
+})
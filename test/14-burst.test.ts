@@ -0,0 +1,90 @@
+import { burst } from '../src/burst'
+import { createPinger } from '../src/index'
+import { ProbeError } from '../src/probe'
+
+import type { PingerProbe } from '../src/probe'
+
+describe('Bursts', () => {
+  it('should validate its parameters', async () => {
+    const probe = (): Promise<PingerProbe> => Promise.resolve({ seq: 0, rtt: 1 })
+
+    await expectAsync(burst(probe, 0, 0))
+        .toBeRejectedWithError(Error, 'Invalid burst count 0 (must be an integer >= 1)')
+    await expectAsync(burst(probe, 1.5, 0))
+        .toBeRejectedWithError(Error, 'Invalid burst count 1.5 (must be an integer >= 1)')
+    await expectAsync(burst(probe, 1, -1))
+        .toBeRejectedWithError(Error, 'Invalid burst spacing -1 (must be a number >= 0 ms)')
+    await expectAsync(burst(probe, 1, Infinity))
+        .toBeRejectedWithError(Error, 'Invalid burst spacing Infinity (must be a number >= 0 ms)')
+  })
+
+  it('should summarize received, lost and overtaken probes', async () => {
+    let seq = 0
+    const probe = (): Promise<PingerProbe> => {
+      seq ++
+      if (seq === 3) return Promise.reject(new ProbeError('Timed out', 'ERR_PROBE_TIMEOUT'))
+      if (seq === 7) return Promise.reject(new ProbeError('Overtaken', 'ERR_PROBE_OVERTAKEN'))
+      return Promise.resolve({ seq, rtt: seq })
+    }
+
+    expect(await burst(probe, 10, 0)).toEqual({
+      sent: 10,
+      received: 8,
+      lost: 2,
+      loss: 0.2,
+      overtaken: 1,
+      min: 1,
+      max: 10,
+      avg: 5.625,
+      p50: jasmine.any(Number),
+      p90: jasmine.any(Number),
+      p95: jasmine.any(Number),
+      p99: jasmine.any(Number),
+      jitter: jasmine.any(Number),
+      elapsed: jasmine.any(Number),
+    })
+  })
+
+  it('should fail on errors other than lost probes', async () => {
+    let sent = 0
+    const probe = (): Promise<PingerProbe> => {
+      if (++ sent === 2) return Promise.reject(new Error('Foo!'))
+      return new Promise((resolve) => setTimeout(() => resolve({ seq: sent, rtt: 1 }), 10))
+    }
+
+    await expectAsync(burst(probe, 10, 1)).toBeRejectedWithError(Error, 'Foo!')
+    expect(sent).toBeLessThan(10) // stopped sending
+  })
+
+  it('should keep sub-millisecond spacing', async () => {
+    const times: bigint[] = []
+    const probe = (): Promise<PingerProbe> => {
+      times.push(process.hrtime.bigint())
+      return Promise.resolve({ seq: times.length, rtt: 1 })
+    }
+
+    const begin = process.hrtime.bigint()
+    const result = await burst(probe, 21, 0.25)
+    expect(result.elapsed).toBeGreaterThanOrEqual(5)
+
+    // no probe is sent before its time
+    expect(times.length).toEqual(21)
+    for (let i = 0; i < times.length; i ++) {
+      expect(Number(times[i]! - begin) / 1000000).toBeGreaterThanOrEqual(i * 0.25)
+    }
+  })
+
+  it('should burst to localhost', async () => {
+    const pinger = await createPinger('127.0.0.1')
+    try {
+      const result = await pinger.burst(50)
+      expect(result).toEqual(jasmine.objectContaining({ sent: 50, received: 50, lost: 0, loss: 0, overtaken: 0 }))
+      expect(result.min).toBeLessThanOrEqual(result.p50)
+      expect(result.p50).toBeLessThanOrEqual(result.max)
+    } finally {
+      await pinger.close()
+    }
+
+    await expectAsync(pinger.burst(10)).toBeRejectedWithError(Error, 'Socket closed')
+  })
+})
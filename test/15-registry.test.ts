@@ -0,0 +1,117 @@
+import { createPingerRegistry } from '../src/index'
+
+import type { PingerRegistryImpl } from '../src/registry'
+
+describe('Target registry', () => {
+  it('should add, remove and reuse ids', async () => {
+    const registry = await createPingerRegistry()
+    try {
+      expect(registry.add('127.0.0.1')).toEqual(0)
+      expect(registry.add('127.0.0.2')).toEqual(1)
+      expect(registry.add('127.0.0.3')).toEqual(2)
+      expect(registry.size).toEqual(3)
+
+      expect(() => registry.add('127.0.0.1')).toThrowError('Target "127.0.0.1" already in registry')
+      expect(() => registry.add('::1')).toThrowError('Invalid ipv4 target "::1"')
+      expect(() => registry.add('localhost')).toThrowError('Invalid ipv4 target "localhost"')
+
+      expect(registry.id('127.0.0.2')).toEqual(1)
+      expect(registry.get(1)).toEqual({ id: 1, target: '127.0.0.2', stats: jasmine.any(Function) })
+      expect(registry.remove(1)).toBeTrue()
+      expect(registry.remove(1)).toBeFalse()
+      expect(registry.id('127.0.0.2')).toBeUndefined()
+      expect(registry.get(1)).toBeUndefined()
+      expect(registry.stats(1)).toBeUndefined()
+      expect(registry.size).toEqual(2)
+
+      // removed ids are reused, with a new generation
+      const generations = (<any> registry).__generations as Uint32Array
+      const generation = generations[1]
+      expect(registry.add('127.0.0.4')).toEqual(1)
+      expect(generations[1]).toBeGreaterThan(generation!)
+    } finally {
+      await registry.close()
+    }
+  })
+
+  it('should validate its options', async () => {
+    await expectAsync(createPingerRegistry({ protocol: 'foo' as any }))
+        .toBeRejectedWithError(Error, 'Invalid protocol "foo" specified')
+    await expectAsync(createPingerRegistry({ from: '::1' }))
+        .toBeRejectedWithError(Error, 'Invalid IPv4 address to ping from "::1"')
+    await expectAsync(createPingerRegistry({ source: 'not-an-interface' }))
+        .toBeRejectedWithError(Error, 'Invalid source interface name "not-an-interface"')
+    await expectAsync(createPingerRegistry({ identifier: 65536 }))
+        .toBeRejectedWithError(Error, 'Invalid ICMP identifier 65536')
+  })
+
+  it('should keep each target in less than 200 bytes', async () => {
+    const registry = await createPingerRegistry()
+    try {
+      for (let i = 0; i < 100000; i ++) registry.add(`10.${(i >> 16) & 0xff}.${(i >> 8) & 0xff}.${i & 0xff}`)
+      expect(registry.size).toEqual(100000)
+      expect(registry.bytes / registry.size).toBeLessThan(200)
+    } finally {
+      await registry.close()
+    }
+  })
+
+  it('should not account replies to a removed target to its replacement', async () => {
+    const registry = await createPingerRegistry() as PingerRegistryImpl
+    const replies: Buffer[] = []
+    const send = (<any> registry).__transport.send
+    ;(<any> registry).__transport.send = (buffer: Buffer): void => void replies.push(buffer)
+
+    try {
+      const id = registry.add('127.0.0.1')
+      registry.__ping(id)
+      registry.remove(id)
+      expect(registry.add('127.0.0.1')).toEqual(id)
+
+      const reply = Buffer.from(replies[0]!)
+      reply.writeUInt8(0x00, 0)
+      const now = reply.readBigInt64BE(8)
+
+      expect(registry.__incoming(reply, '127.0.0.1', now)).toEqual(-2n) // ERR_WRONG_CORRELATION
+
+      registry.__ping(id)
+      const valid = Buffer.from(replies[1]!)
+      valid.writeUInt8(0x00, 0)
+      expect(registry.__incoming(valid, '127.0.0.2', now)).toEqual(-2n) // wrong address
+      expect(registry.__incoming(valid, '127.0.0.1', valid.readBigInt64BE(8) + 1000n)).toEqual(1000n)
+      expect(registry.__incoming(valid, '127.0.0.1', valid.readBigInt64BE(8) + 1000n)).toEqual(-7n) // duplicate
+      expect(registry.stats(id)).toEqual({ sent: 1, received: 1, latency: 0.001 })
+    } finally {
+      (<any> registry).__transport.send = send
+      await registry.close()
+    }
+  })
+
+  it('should ping localhost', async () => {
+    const registry = await createPingerRegistry({ interval: 50 })
+    try {
+      const ids = [ '127.0.0.1', '127.0.0.2', '127.0.0.3' ].map((target) => registry.add(target))
+      const pongs: number[] = []
+      registry.on('pong', (id) => pongs.push(id))
+      registry.on('warning', (_, code) => fail(`Unexpected warning ${code}`))
+
+      registry.start()
+      expect(registry.running).toBeTrue()
+      await new Promise((resolve) => setTimeout(resolve, 220))
+      registry.stop()
+      expect(registry.running).toBeFalse()
+      await new Promise((resolve) => setTimeout(resolve, 20))
+
+      for (const id of ids) {
+        expect(pongs.filter((pong) => pong === id).length).toBeGreaterThanOrEqual(3)
+        const stats = registry.get(id)!.stats()
+        expect(stats.received).toEqual(stats.sent)
+        expect(stats.latency).toBeGreaterThan(0)
+      }
+    } finally {
+      await registry.close()
+    }
+    expect(registry.closed).toBeTrue()
+    expect(() => registry.start()).toThrowError('Socket closed')
+  })
+})
@@ -0,0 +1,134 @@
+import { createPinger, createPingerGroup, memoryUsage, setMemoryBudget } from '../src/index'
+import { InFlight } from '../src/inflight'
+
+import type { PingerImpl } from '../src/pinger'
+
+describe('Memory budget', () => {
+  afterEach(() => setMemoryBudget(undefined))
+
+  it('should cap and shrink an in-flight table', () => {
+    const inflight = new InFlight()
+    for (let i = 1; i <= 1000; i ++) inflight.add(i, BigInt(i))
+    const bytes = inflight.bytes
+    expect(inflight.limit).toEqual(Infinity)
+
+    inflight.cap(100)
+    expect(inflight.size).toEqual(1000) // only enforced when expiring
+    expect(inflight.expire(0n)).toEqual(900)
+    expect(inflight.size).toEqual(100)
+    expect(inflight.bytes).toBeLessThan(bytes / 4)
+    expect(inflight.entries()[0]).toEqual([ 901, 901n ])
+
+    // still working after shrinking
+    inflight.add(1001, 1001n)
+    expect(inflight.expire(0n)).toEqual(1) // 901, over the limit again
+    expect(inflight.remove(950)).toEqual(950n)
+    expect(inflight.entries().length).toEqual(99)
+    expect(inflight.entries()[0]).toEqual([ 902, 902n ])
+  })
+
+  it('should halve an in-flight table, never below its initial capacity', () => {
+    const inflight = new InFlight()
+    for (let i = 1; i <= 31; i ++) inflight.add(i, BigInt(i))
+
+    // a table this small (or empty) is never capped
+    expect(inflight.halve()).toBeFalse()
+    expect(inflight.limit).toEqual(Infinity)
+    expect(new InFlight().halve()).toBeFalse()
+
+    for (let i = 32; i <= 200; i ++) inflight.add(i, BigInt(i))
+    expect(inflight.halve()).toBeTrue()
+    expect(inflight.limit).toEqual(100)
+    expect(inflight.halve()).toBeTrue()
+    expect(inflight.limit).toEqual(50)
+    expect(inflight.halve()).toBeTrue()
+    expect(inflight.limit).toEqual(31)
+    expect(inflight.halve()).toBeFalse()
+    expect(inflight.limit).toEqual(31)
+
+    expect(inflight.expire(0n)).toEqual(169)
+    expect(inflight.size).toEqual(31)
+    expect(inflight.bytes).toEqual(32 * 12)
+  })
+
+  it('should report the memory used by pingers and groups', async () => {
+    const usage = memoryUsage() // other tests might have left pingers open
+    const group = createPingerGroup({ trace: { size: 16 }, capture: { size: 16 } })
+    try {
+      await group.add('127.0.0.1')
+      await new Promise((resolve) => setTimeout(resolve, 50)) // bound
+
+      const memory = group.memory()['127.0.0.1']!
+      expect(memory).toEqual({
+        inflight: 32 * 12,
+        histogram: 26 * 16 * 4,
+        history: jasmine.any(Number),
+        socket: jasmine.any(Number),
+        total: jasmine.any(Number),
+      })
+      expect(memory.history).toBeGreaterThan(16 * 64)
+      expect(memory.socket).toBeGreaterThan(0)
+      expect(memory.total).toEqual(memory.inflight + memory.histogram + memory.history)
+      expect(memoryUsage()).toEqual({
+        pingers: usage.pingers + 1,
+        bytes: usage.bytes + memory.total,
+        budget: undefined,
+      })
+    } finally {
+      await group.close()
+    }
+
+    expect(memoryUsage().pingers).toEqual(usage.pingers)
+  })
+
+  it('should degrade pingers when over budget', async () => {
+    expect(() => setMemoryBudget(-1)).toThrowError('Invalid memory budget -1')
+
+    const pinger = await createPinger('127.0.0.1', { trace: { size: 64 }, capture: { size: 64 } }) as PingerImpl
+    const warnings: string[] = []
+    pinger.on('warning', (code, message) => warnings.push(`${code}: ${message}`))
+
+    try {
+      // requests in flight (never sent)
+      for (let i = 0; i < 500; i ++) (<any> pinger).__handler.outgoing()
+      const before = pinger.memory()
+
+      // budget for everything but (most of) the history: only history is degraded
+      setMemoryBudget(memoryUsage().bytes - before.history + 1024)
+      const history = pinger.memory()
+      expect(history.history).toBeLessThan(before.history)
+      expect(history.histogram).toEqual(before.histogram)
+      expect(history.inflight).toEqual(before.inflight)
+      expect(warnings).toEqual([ 'ERR_MEMORY_BUDGET: Memory budget exceeded, degrading history' ])
+
+      // nothing left but in-flight requests to degrade
+      setMemoryBudget(0)
+      const after = pinger.memory()
+      expect(after.history).toBeLessThan(history.history)
+      expect(after.histogram).toEqual(26 * 4)
+      expect(after.inflight).toEqual(32 * 12)
+      expect(warnings).toEqual([
+        'ERR_MEMORY_BUDGET: Memory budget exceeded, degrading history',
+        'ERR_MEMORY_BUDGET: Memory budget exceeded, degrading histogram',
+        'ERR_MEMORY_BUDGET: Memory budget exceeded, degrading inflight',
+      ])
+      // in-flight requests are capped to the ring's initial capacity, not below
+      expect((<any> pinger).__handler.inflight.limit).toEqual(31)
+      expect(pinger.losses()).toEqual(jasmine.objectContaining({ lost: true, length: 469 }))
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should not cap pingers with few requests in flight', async () => {
+    const pinger = await createPinger('127.0.0.1') as PingerImpl
+    try {
+      for (let i = 0; i < 10; i ++) (<any> pinger).__handler.outgoing()
+      expect(pinger.__degrade('inflight')).toBeFalse()
+      expect((<any> pinger).__handler.inflight.limit).toEqual(Infinity)
+      expect((<any> pinger).__handler.inflight.size).toEqual(10)
+    } finally {
+      await pinger.close()
+    }
+  })
+})
@@ -0,0 +1,145 @@
+import { randomUUID } from 'node:crypto'
+import { createServer } from 'node:net'
+import { tmpdir } from 'node:os'
+import { join } from 'node:path'
+
+import { createPinger, createResultSink, decodeFrames } from '../src/index'
+
+import type { Server, Socket } from 'node:net'
+import type { ResultFrame } from '../src/index'
+
+describe('Result Sink', () => {
+  let path: string
+  let server: Server
+  let connection: Promise<Socket>
+  let sockets: Socket[]
+
+  beforeEach(async () => {
+    path = join(tmpdir(), `ping-sink-${randomUUID()}.sock`)
+    server = createServer()
+    sockets = []
+    server.on('connection', (socket) => sockets.push(socket))
+    connection = new Promise((resolve) => server.once('connection', resolve))
+    await new Promise<void>((resolve) => server.listen(path, resolve))
+  })
+
+  afterEach(async () => {
+    for (const socket of sockets) socket.destroy()
+    await new Promise((resolve) => server.close(resolve))
+  })
+
+  /* Read and decode all frames until the socket is closed */
+  async function frames(socket: Socket): Promise<{ frames: ResultFrame[], chunks: number }> {
+    const chunks: Buffer[] = []
+    socket.on('data', (chunk) => chunks.push(chunk))
+    await new Promise((resolve) => socket.once('end', resolve))
+
+    const buffer = Buffer.concat(chunks)
+    const { frames, consumed } = decodeFrames(buffer)
+    expect(consumed).toEqual(buffer.length)
+    return { frames, chunks: chunks.length }
+  }
+
+  it('should validate its options', async () => {
+    expect(() => createResultSink(path, { batch: 12 })).toThrowError('Invalid sink batch size 12')
+    expect(() => createResultSink(path, { batch: 1024, limit: 512 })).toThrowError('Invalid sink limit 512')
+    await expectAsync(createResultSink(`${path}.missing`)).toBeRejectedWithError(Error, /ENOENT/)
+  })
+
+  it('should stream pongs and rollups as binary frames', async () => {
+    const sink = await createResultSink(path) as any
+    const received = frames(await connection)
+
+    for (let i = 0; i < 100; i ++) sink.pong(i % 2 ? '127.0.0.1' : '::1', i / 10, 1000 + i)
+    sink.rollup({
+      target: '::1', start: 1000, end: 2000, sent: 50, received: 49, lost: 1, loss: 0.02,
+      min: 0, max: 9.8, avg: 4.9, p50: 4.8, p90: 8.8, p95: 9.4, p99: 9.8, jitter: NaN,
+    })
+    await sink.close()
+
+    const { frames: decoded, chunks } = await received
+    expect(chunks).toBeLessThanOrEqual(2) // all in one batch
+    expect(decoded.length).toEqual(103)
+
+    expect(decoded[0]).toEqual({ type: 'target', id: 0, target: '::1' })
+    expect(decoded[1]).toEqual({ type: 'pong', id: 0, time: 1000, latency: 0 })
+    expect(decoded[2]).toEqual({ type: 'target', id: 1, target: '127.0.0.1' })
+    expect(decoded[3]).toEqual({ type: 'pong', id: 1, time: 1001, latency: 0.1 })
+    expect(decoded[101]).toEqual({ type: 'pong', id: 1, time: 1099, latency: 9.9 })
+    expect(decoded[102]).toEqual({ type: 'rollup', id: 0, rollup: {
+      start: 1000, end: 2000, sent: 50, received: 49, lost: 1, loss: 0.02,
+      min: 0, max: 9.8, avg: 4.9, p50: 4.8, p90: 8.8, p95: 9.4, p99: 9.8, jitter: NaN,
+    } })
+  })
+
+  it('should encode frames with the lengths of their documented layout', async () => {
+    const sink = await createResultSink(path) as any
+    const socket = await connection
+    const chunks: Buffer[] = []
+    socket.on('data', (chunk) => chunks.push(chunk))
+    const ended = new Promise((resolve) => socket.once('end', resolve))
+
+    sink.pong('::1', 1, 1000)
+    sink.rollup({
+      target: '::1', start: 1000, end: 2000, sent: 1, received: 1, lost: 0, loss: 0,
+      min: 1, max: 1, avg: 1, p50: 1, p90: 1, p95: 1, p99: 1, jitter: 0,
+    })
+    await sink.close()
+    await ended
+
+    // walk the raw frames, collecting the payload length of each type
+    const buffer = Buffer.concat(chunks)
+    const lengths: [ number, number ][] = []
+    for (let offset = 0; offset < buffer.length; offset += 4 + buffer.readUInt32BE(offset)) {
+      lengths.push([ buffer.readUInt8(offset + 4), buffer.readUInt32BE(offset) - 1 ])
+    }
+
+    expect(lengths).toEqual([
+      [ 1, 4 + 2 + 3 ], // TARGET: id, length and "::1"
+      [ 2, 4 + 8 + 8 ], // PONG: id, time and latency
+      [ 3, 4 + 8 * 2 + 4 * 3 + 8 * 9 ], // ROLLUP: id, start/end, 3 counters, 9 values
+    ])
+    expect(buffer.length).toEqual(lengths.reduce((total, [ , length ]) => total + 5 + length, 0))
+  })
+
+  it('should drop frames when the consumer can not keep up', async () => {
+    const sink = await createResultSink(path, { batch: 4096, limit: 65536 }) as any
+    const socket = await connection
+    socket.pause()
+
+    // the kernel buffers some, then we buffer up to our limit, then drop
+    for (let i = 0; i < 100000; i ++) sink.pong('127.0.0.1', i)
+    expect(sink.dropped).toBeGreaterThan(0)
+    expect(sink.pending).toBeLessThanOrEqual(65536)
+
+    const received = frames(socket)
+    socket.resume()
+    await sink.close()
+
+    const pongs = (await received).frames.filter(({ type }) => type === 'pong')
+    expect(pongs.length + sink.dropped).toEqual(100000)
+    expect(pongs.map(({ latency }: any) => latency)).toEqual(pongs.map(({ latency }: any) => latency).sort((a, b) => a - b))
+  })
+
+  it('should stream the results of a pinger', async () => {
+    const sink = await createResultSink(path)
+    const received = frames(await connection)
+    const pinger = await createPinger('127.0.0.1', { interval: 10 })
+
+    try {
+      sink.attach(pinger)
+      pinger.start()
+      await new Promise((resolve) => setTimeout(resolve, 100))
+    } finally {
+      await pinger.close()
+      await sink.close()
+    }
+
+    const { frames: decoded } = await received
+    expect(decoded[0]).toEqual({ type: 'target', id: 0, target: '127.0.0.1' })
+    expect(decoded.length).toBeGreaterThan(5)
+    for (const frame of decoded.slice(1)) {
+      expect(frame).toEqual({ type: 'pong', id: 0, time: jasmine.any(Number), latency: jasmine.any(Number) })
+    }
+  })
+})
@@ -0,0 +1,87 @@
+import { createPinger, decodeHeatmap } from '../src/index'
+import { Heatmap } from '../src/heatmap'
+
+describe('Heatmap', () => {
+  it('should validate its options', () => {
+    expect(() => new Heatmap({ slot: 0 })).toThrowError('Invalid heatmap slot 0')
+    expect(() => new Heatmap({ slots: 0 })).toThrowError('Invalid heatmap slots 0')
+    expect(() => new Heatmap({ slots: 65536 })).toThrowError('Invalid heatmap slots 65536')
+    expect(() => new Heatmap({ resolution: 3 })).toThrowError('Invalid heatmap resolution 3')
+  })
+
+  it('should count latencies per slot and bucket', () => {
+    const heatmap = new Heatmap({ slot: 1000, slots: 4, resolution: 1 })
+    expect(heatmap.bytes).toEqual((4 * 22 + 4) * 4)
+
+    heatmap.record(0.001, 10000) // below the first bucket
+    heatmap.record(0.015, 10500) // bucket 0 (0.01 ... 0.02)
+    heatmap.record(1, 11000) // bucket 6 (0.64 ... 1.28)
+    heatmap.record(1.2, 11999) // bucket 6 (0.64 ... 1.28)
+    heatmap.record(100000, 12000) // above the last bucket
+    heatmap.lost(3, 12500)
+
+    const decoded = decodeHeatmap(heatmap.export(13000))
+    expect(decoded.start).toEqual(10000)
+    expect(decoded.slot).toEqual(1000)
+    expect(decoded.buckets.length).toEqual(22)
+    expect(decoded.buckets[0]).toEqual(0.01)
+    expect(decoded.buckets[6]).toBeCloseTo(0.64, 10)
+    expect(decoded.lost).toEqual([ 0, 0, 3, 0 ])
+    expect(decoded.counts.map((row) => row.reduce((a, b) => a + b))).toEqual([ 2, 2, 1, 0 ])
+    expect(decoded.counts[0]![0]).toEqual(2)
+    expect(decoded.counts[1]![6]).toEqual(2)
+    expect(decoded.counts[2]![21]).toEqual(1)
+  })
+
+  it('should overwrite old slots, ignoring samples older than them', () => {
+    const heatmap = new Heatmap({ slot: 1000, slots: 4, resolution: 1 })
+
+    for (let time = 0; time < 10000; time += 100) heatmap.record(1, time)
+    heatmap.record(1, 5000) // too old, ignored
+    heatmap.record(1, 7500) // still in the ring
+
+    let decoded = decodeHeatmap(heatmap.export(9999))
+    expect(decoded.start).toEqual(6000)
+    expect(decoded.counts.map((row) => row[6])).toEqual([ 10, 11, 10, 10 ])
+
+    // jumping far ahead clears everything
+    decoded = decodeHeatmap(heatmap.export(100000))
+    expect(decoded.start).toEqual(97000)
+    expect(decoded.counts.map((row) => row[6])).toEqual([ 0, 0, 0, 0 ])
+  })
+
+  it('should export sparsely', () => {
+    const heatmap = new Heatmap() // 60 slots of 1 minute, 44 buckets
+
+    const empty = heatmap.export(0)
+    expect(empty.length).toEqual(29 + 60 * 5)
+
+    for (let i = 0; i < 1000; i ++) heatmap.record(10 + (i % 3) / 10, i * 60)
+    expect(heatmap.export(59999).length).toEqual(empty.length + 5) // all in one cell
+
+    expect(() => decodeHeatmap(Buffer.from('no'))).toThrowError('Invalid pinger state (truncated)')
+    expect(() => decodeHeatmap(Buffer.alloc(32))).toThrowError('Invalid heatmap')
+  })
+
+  it('should keep a heatmap for a pinger', async () => {
+    const pinger = await createPinger('127.0.0.1', { heatmap: { slot: 1000, slots: 2 } })
+    try {
+      expect(pinger.memory().histogram).toEqual(26 * 16 * 4 + (2 * 44 + 2) * 4)
+
+      for (let i = 0; i < 10; i ++) await pinger.probe()
+
+      const { counts, lost } = decodeHeatmap(pinger.heatmap()!)
+      expect(counts.flat().reduce((a, b) => a + b)).toEqual(10)
+      expect(lost).toEqual([ 0, 0 ])
+    } finally {
+      await pinger.close()
+    }
+
+    const plain = await createPinger('127.0.0.1')
+    try {
+      expect(plain.heatmap()).toBeUndefined()
+    } finally {
+      await plain.close()
+    }
+  })
+})
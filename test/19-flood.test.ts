@@ -0,0 +1,72 @@
+import { flood } from '../src/flood'
+import { createPinger } from '../src/index'
+import { ProbeError } from '../src/probe'
+
+import type { PingerProbe } from '../src/probe'
+
+describe('Floods', () => {
+  it('should validate its parameters', async () => {
+    const probe = (): Promise<PingerProbe> => Promise.resolve({ seq: 0, rtt: 1 })
+
+    await expectAsync(flood(probe, 0, 10))
+        .toBeRejectedWithError(Error, 'Invalid flood window 0 (must be an integer between 1 and 32768)')
+    await expectAsync(flood(probe, 32769, 10))
+        .toBeRejectedWithError(Error, 'Invalid flood window 32769 (must be an integer between 1 and 32768)')
+    await expectAsync(flood(probe, 1, 0))
+        .toBeRejectedWithError(Error, 'Invalid flood duration 0 (must be a number > 0 ms)')
+    await expectAsync(flood(probe, 1, NaN))
+        .toBeRejectedWithError(Error, 'Invalid flood duration NaN (must be a number > 0 ms)')
+  })
+
+  it('should keep exactly a window of probes in flight', async () => {
+    let inflight = 0
+    let highest = 0
+    let seq = 0
+    const probe = (): Promise<PingerProbe> => {
+      highest = Math.max(highest, ++ inflight)
+      const current = ++ seq
+      return new Promise((resolve, reject) => setTimeout(() => {
+        inflight --
+        if (current % 10 === 0) reject(new ProbeError('Timed out', 'ERR_PROBE_TIMEOUT'))
+        else resolve({ seq: current, rtt: 1 })
+      }, 1))
+    }
+
+    const summary = await flood(probe, 8, 50)
+    expect(highest).toEqual(8)
+    expect(inflight).toEqual(0)
+    expect(summary.window).toEqual(8)
+    expect(summary.sent).toEqual(seq)
+    expect(summary.lost).toEqual(Math.floor(seq / 10))
+    expect(summary.received).toEqual(seq - summary.lost)
+    expect(summary.avg).toEqual(1)
+    expect(summary.elapsed).toBeGreaterThanOrEqual(50)
+    expect(summary.pps).toBeCloseTo(summary.sent / summary.elapsed * 1000, 6)
+  })
+
+  it('should fail on errors other than lost probes', async () => {
+    let sent = 0
+    const probe = (): Promise<PingerProbe> => {
+      if (++ sent === 20) return Promise.reject(new Error('Foo!'))
+      return new Promise((resolve) => setTimeout(() => resolve({ seq: sent, rtt: 1 }), 1))
+    }
+
+    await expectAsync(flood(probe, 4, 10000)).toBeRejectedWithError(Error, 'Foo!')
+    expect(sent).toBeLessThan(30) // stopped sending
+  })
+
+  it('should flood localhost', async () => {
+    const pinger = await createPinger('127.0.0.1', { timeout: 1000 })
+    try {
+      const summary = await pinger.flood(16, 100)
+
+      expect(summary.sent).toBeGreaterThan(100)
+      expect(summary.received + summary.lost).toEqual(summary.sent)
+      expect(summary.pps).toBeGreaterThan(1000)
+      expect(summary.min).toBeGreaterThan(0)
+      expect(pinger.stats().sent).toEqual(summary.sent)
+    } finally {
+      await pinger.close()
+    }
+  })
+})
@@ -0,0 +1,104 @@
+import { VirtualClock } from '../src/clock'
+import { simulate } from '../src/index'
+
+describe('Simulation', () => {
+  it('should run virtual events in order', () => {
+    const clock = new VirtualClock()
+    const events: string[] = []
+
+    const timer = clock.setInterval(() => events.push(`tick@${clock.time}`), 1)
+    clock.schedule(1500000, () => events.push(`once@${clock.time}`))
+    clock.schedule(1000000, () => events.push(`first@${clock.time}`)) // after the tick at the same time
+
+    expect(clock.run(3000000)).toEqual(5)
+    expect(events).toEqual([
+      'tick@1000000',
+      'first@1000000',
+      'once@1500000',
+      'tick@2000000',
+      'tick@3000000',
+    ])
+    expect(clock.now()).toEqual(3000000n)
+
+    clock.clearInterval(timer)
+    clock.clearTimeout(clock.setTimeout(() => events.push('cancelled'), 1))
+    expect(clock.run(10000000)).toEqual(0)
+    expect(clock.time).toEqual(10000000)
+    expect(clock.pending).toEqual(0)
+  })
+
+  it('should validate its options', async () => {
+    await expectAsync(simulate({ targets: 0 })).toBeRejectedWithError(Error, 'Invalid simulation targets 0')
+    await expectAsync(simulate({ duration: -1 })).toBeRejectedWithError(Error, 'Invalid simulation duration -1')
+    await expectAsync(simulate({ loss: 2 })).toBeRejectedWithError(Error, 'Invalid simulation loss 2')
+  })
+
+  it('should simulate a registry deterministically', async () => {
+    const options = { targets: 1000, duration: 10000, loss: 0.1, seed: 42 }
+    const simulation = await simulate(options)
+
+    expect(simulation).toEqual({
+      targets: 1000,
+      sent: 10000,
+      received: jasmine.any(Number),
+      lost: jasmine.any(Number),
+      latency: jasmine.any(Number),
+      warnings: {},
+      burst: 10, // 1000 targets over 100 slots of 10 ms
+      events: 1000 + simulation.received,
+      elapsed: jasmine.any(Number),
+      speedup: jasmine.any(Number),
+    })
+    expect(simulation.received + simulation.lost).toEqual(10000)
+    expect(simulation.lost / simulation.sent).toBeCloseTo(0.1, 1)
+    expect(simulation.latency).toBeCloseTo(11, 0) // 10 ms, plus 1 ms of jitter on average
+
+    const again = await simulate(options)
+    expect({ ...again, elapsed: 0, speedup: 0 }).toEqual({ ...simulation, elapsed: 0, speedup: 0 })
+  })
+
+  it('should simulate pingers deterministically', async () => {
+    const options = { targets: 100, duration: 10000, loss: 0.1, seed: 42, pingers: true }
+    const simulation = await simulate(options)
+
+    expect(simulation).toEqual({
+      targets: 100,
+      sent: 1000,
+      received: jasmine.any(Number),
+      lost: jasmine.any(Number),
+      latency: jasmine.any(Number),
+      warnings: {},
+      burst: 100, // all pingers tick at the same instant
+      events: 2000 + simulation.received, // ticks, send callbacks and replies
+      elapsed: jasmine.any(Number),
+      speedup: jasmine.any(Number),
+    })
+    expect(simulation.received + simulation.lost).toEqual(1000)
+    expect(simulation.lost / simulation.sent).toBeCloseTo(0.1, 1)
+    expect(simulation.latency).toBeCloseTo(11, 0)
+
+    const again = await simulate(options)
+    expect({ ...again, elapsed: 0, speedup: 0 }).toEqual({ ...simulation, elapsed: 0, speedup: 0 })
+
+    await expectAsync(simulate({ targets: 65537, pingers: true }))
+        .toBeRejectedWithError(Error, 'Invalid simulation targets 65537')
+  })
+
+  it('should reject replies after the timeout', async () => {
+    const simulation = await simulate({ targets: 100, duration: 10000, timeout: 100, latency: 50, jitter: 50 })
+
+    // exponential jitter: exp(-1) of the replies are later than 100 ms
+    const late = simulation.warnings.ERR_SEQUENCE_TOO_SMALL!
+    expect(late / simulation.sent).toBeCloseTo(Math.exp(-1), 1)
+    expect(simulation.received + late).toEqual(simulation.sent)
+  })
+
+  it('should simulate many targets faster than real time', async () => {
+    const simulation = await simulate({ targets: 10000, duration: 10000 })
+
+    expect(simulation.sent).toEqual(100000)
+    expect(simulation.received).toEqual(100000)
+    expect(simulation.burst).toEqual(100)
+    expect(simulation.speedup).toBeGreaterThan(1)
+  })
+})
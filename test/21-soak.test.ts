@@ -0,0 +1,65 @@
+import { soak } from '../src/index'
+import { drift } from '../src/soak'
+
+describe('Soak benchmark', () => {
+  const times = new Array(100).fill(0).map((_, i) => i * 1000)
+
+  it('should flag a growing baseline', () => {
+    // a sawtooth (allocations and collections) over a growing baseline
+    const leaking = times.map((time, i) => 1000000 + time * 10 + (i % 10) * 50000)
+    const result = drift(times, leaking)
+
+    expect(result.growing).toBeTrue()
+    // 10 bytes per ms (36 MB per hour) plus the bias of the sawtooth
+    expect(result.slope).toBeGreaterThan(36000000)
+    expect(result.slope).toBeLessThan(40000000)
+    expect(result.baselines.length).toEqual(4)
+  })
+
+  it('should not flag a stable (or noisy) baseline', () => {
+    const stable = times.map((_, i) => 1000000 + (i % 10) * 50000)
+    expect(drift(times, stable).growing).toBeFalse()
+
+    // growing, but by less than the threshold
+    const slow = times.map((time, i) => 1000000 + time / 100 + (i % 10) * 50000)
+    expect(drift(times, slow).growing).toBeFalse()
+    expect(drift(times, slow, 0.0001).growing).toBeTrue()
+
+    // a single spike is not a leak
+    const spike = stable.map((value, i) => i === 90 ? value * 10 : value)
+    expect(drift(times, spike).growing).toBeFalse()
+
+    expect(drift(times.slice(0, 3), stable.slice(0, 3))).toEqual({ slope: NaN, baselines: [], growing: false })
+  })
+
+  it('should validate its options', async () => {
+    await expectAsync(soak({ pingers: 0 })).toBeRejectedWithError(Error, 'Invalid soak pingers 0')
+    await expectAsync(soak({ duration: 0 })).toBeRejectedWithError(Error, 'Invalid soak duration 0')
+    await expectAsync(soak({ sample: -1 })).toBeRejectedWithError(Error, 'Invalid soak sample -1')
+  })
+
+  it('should soak a fleet of pingers', async () => {
+    const samples: number[] = []
+    const result = await soak({
+      pingers: 10,
+      interval: 10,
+      duration: 500,
+      sample: 100,
+      onSample: ({ time }) => samples.push(time),
+    })
+
+    expect(result.samples.map(({ time }) => time)).toEqual(samples)
+    expect(samples.length).toBeGreaterThanOrEqual(5)
+    expect(result.sent).toBeGreaterThan(100)
+    expect(result.received).toBeGreaterThan(100)
+
+    for (const sample of result.samples) {
+      expect(sample.heap).toBeGreaterThan(0)
+      expect(sample.rss).toBeGreaterThan(sample.heap)
+      expect(sample.delay).toBeGreaterThanOrEqual(0)
+    }
+
+    expect(result.gc.count).toBeGreaterThanOrEqual(0)
+    expect(Object.keys(result.drift)).toEqual([ 'heap', 'rss', 'external' ])
+  })
+})
@@ -0,0 +1,133 @@
+import { readdirSync } from 'node:fs'
+import { tmpdir } from 'node:os'
+import { join } from 'node:path'
+
+import { createPinger, createPingerGroup, handoff, pendingOpens, receiveHandoff } from '../src/index'
+
+/** Count the file descriptors open by this process (Linux only) */
+function descriptors(): number {
+  return readdirSync('/proc/self/fd').length
+}
+
+describe('Lazy opens', () => {
+  const linux = process.platform === 'linux'
+
+  it('should open the socket when first pinged', async () => {
+    const pinger = await createPinger('127.0.0.1', { lazy: true })
+    try {
+      expect(pinger.opened).toBeFalse()
+      expect(pinger.closed).toBeFalse()
+      expect(pinger.memory().socket).toEqual(0)
+
+      // concurrent pings share the same open
+      await Promise.all([ pinger.ping(), pinger.ping() ])
+      expect(pinger.opened).toBeTrue()
+
+      const { seq, rtt } = await pinger.probe()
+      expect(seq).toEqual(3)
+      expect(rtt).toBeGreaterThan(0)
+      expect(pinger.stats()).toEqual({ sent: 3, received: jasmine.any(Number), latency: jasmine.any(Number) })
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should open the socket when started', async () => {
+    const pinger = await createPinger('127.0.0.1', { lazy: true, interval: 10 })
+    try {
+      const pongs: number[] = []
+      pinger.on('pong', (latency) => pongs.push(latency))
+
+      pinger.start()
+      expect(pinger.running).toBeTrue()
+      expect(pinger.opened).toBeFalse()
+
+      await new Promise((resolve) => setTimeout(resolve, 100))
+      expect(pinger.opened).toBeTrue()
+      expect(pongs.length).toBeGreaterThan(0)
+      if (linux) expect(pinger.identifier).toBeGreaterThan(0)
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should close without ever opening', async () => {
+    const pinger = await createPinger('127.0.0.1', { lazy: true })
+    await pinger.close()
+
+    expect(pinger.closed).toBeTrue()
+    expect(pinger.opened).toBeFalse()
+    expect(() => pinger.start()).toThrowError('Socket closed')
+    await expectAsync(pinger.ping()).toBeRejectedWithError(Error, 'Socket closed')
+    await expectAsync(pinger.probe()).toBeRejectedWithError(Error, 'Socket closed')
+  })
+
+  it('should close the socket opened after being closed', async () => {
+    const before = linux ? descriptors() : 0
+    const pinger = await createPinger('127.0.0.1', { lazy: true })
+
+    const pinged = pinger.ping()
+    await pinger.close()
+    await expectAsync(pinged).toBeRejectedWithError(Error, 'Socket closed')
+
+    expect(pinger.opened).toBeFalse()
+    if (linux) expect(descriptors()).toEqual(before)
+  })
+
+  it('should hold no descriptors until a group is started', async () => {
+    const before = linux ? descriptors() : 0
+    const group = createPingerGroup({ lazy: true, interval: 50 })
+    try {
+      for (let i = 1; i <= 200; i ++) await group.add(`127.0.0.${i}`)
+      if (linux) expect(descriptors()).toEqual(before)
+
+      // all opens are queued together, and issued on the next tick
+      group.start()
+      expect(pendingOpens()).toEqual(200)
+
+      await new Promise((resolve) => setTimeout(resolve, 200))
+      expect(pendingOpens()).toEqual(0)
+      expect([ ...group.entries() ].every(([ , pinger ]) => pinger.opened)).toBeTrue()
+      if (linux) expect(descriptors()).toEqual(before + 200)
+    } finally {
+      await group.close()
+    }
+  })
+
+  it('should hand off lazy pingers never opened', async () => {
+    const socket = join(tmpdir(), `ping-lazy-${process.pid}.sock`)
+    const group = createPingerGroup({ lazy: true })
+    const received = receiveHandoff(socket, { lazy: true })
+
+    try {
+      await (await group.add('127.0.0.1')).ping()
+      await group.add('127.0.0.2')
+      await group.add('127.0.0.3', { identifier: 4322 })
+      await handoff(socket, group)
+
+      const adopted = await received
+      try {
+        expect(adopted.get('127.0.0.1')!.opened).toBeTrue()
+        expect(adopted.get('127.0.0.2')!.opened).toBeFalse()
+
+        await adopted.get('127.0.0.2')!.ping()
+        expect(adopted.get('127.0.0.2')!.opened).toBeTrue()
+
+        // explicit identifiers are kept when opening after the handoff
+        const explicit = adopted.get('127.0.0.3')!
+        expect(explicit.opened).toBeFalse()
+        expect(explicit.identifier).toEqual(4322)
+        let pongs = 0
+        explicit.on('pong', () => pongs ++)
+        await explicit.ping()
+        await new Promise((resolve) => setTimeout(resolve, 100))
+        expect(explicit.identifier).toEqual(4322)
+        expect(pongs).toEqual(1)
+      } finally {
+        await adopted.close()
+      }
+    } finally {
+      await group.close()
+    }
+  })
+})
@@ -0,0 +1,123 @@
+import { readdirSync } from 'node:fs'
+
+import { createPinger, createPingerGroup } from '../src/index'
+
+/** Count the file descriptors open by this process (Linux only) */
+function descriptors(): number {
+  return readdirSync('/proc/self/fd').length
+}
+
+/** Wait for the specified number of milliseconds */
+function sleep(ms: number): Promise<void> {
+  return new Promise((resolve) => setTimeout(resolve, ms))
+}
+
+describe('Hibernation', () => {
+  const linux = process.platform === 'linux'
+
+  it('should validate the idle time', async () => {
+    await expectAsync(createPinger('127.0.0.1', { hibernate: -1 }))
+        .toBeRejectedWithError(Error, 'Invalid hibernation idle time -1')
+    await expectAsync(createPinger('127.0.0.1', { hibernate: NaN }))
+        .toBeRejectedWithError(Error, 'Invalid hibernation idle time NaN')
+  })
+
+  it('should release the socket of an idle pinger, and reopen it when started', async () => {
+    const before = linux ? descriptors() : 0
+    const pinger = await createPinger('127.0.0.1', { interval: 10, timeout: 100, hibernate: 50 })
+    try {
+      const pongs: number[] = []
+      pinger.on('pong', (latency) => pongs.push(latency))
+
+      pinger.start()
+      await sleep(100)
+      pinger.stop()
+      await sleep(30) // replies still in flight are received
+
+      const stats = pinger.stats()
+      expect(stats.sent).toBeGreaterThan(0)
+      expect(stats.received).toEqual(stats.sent)
+      expect(pinger.opened).toBeTrue()
+
+      // not before the idle time elapsed
+      await sleep(100)
+      expect(pinger.opened).toBeFalse()
+      expect(pinger.closed).toBeFalse()
+      expect(pinger.memory().socket).toEqual(0)
+      if (linux) expect(descriptors()).toEqual(before)
+
+      // starting again reopens the socket, and sequences keep going
+      const count = pongs.length
+      pinger.start()
+      await sleep(100)
+      expect(pinger.opened).toBeTrue()
+      expect(pongs.length).toBeGreaterThan(count)
+
+      const { seq } = await pinger.probe()
+      expect(seq).toBeGreaterThan(count + 1)
+      expect(pinger.losses().bursts.every((count) => count === 0)).toBeTrue()
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should not hibernate while running, or with requests in flight', async () => {
+    const pinger = await createPinger('127.0.0.1', { interval: 10, timeout: 1000, hibernate: 20 })
+    try {
+      pinger.start()
+      await sleep(100)
+      expect(pinger.opened).toBeTrue()
+
+      // a request in flight (a reply will never come) keeps the socket open
+      const handler = (pinger as any).__handler
+      pinger.stop()
+      handler.outgoing()
+      await sleep(100)
+      expect(pinger.opened).toBeTrue()
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should reopen the socket when pinged, and hibernate again', async () => {
+    const pinger = await createPinger('127.0.0.1', { hibernate: 20 })
+    try {
+      await sleep(60)
+      expect(pinger.opened).toBeFalse()
+
+      await pinger.ping()
+      expect(pinger.opened).toBeTrue()
+
+      await sleep(100)
+      expect(pinger.opened).toBeFalse()
+      expect(pinger.stats()).toEqual({ sent: 1, received: 1, latency: jasmine.any(Number) })
+    } finally {
+      await pinger.close()
+    }
+  })
+
+  it('should toggle a group of pingers', async () => {
+    const before = linux ? descriptors() : 0
+    const group = createPingerGroup({ lazy: true, interval: 20, timeout: 100, hibernate: 50 })
+    try {
+      for (let i = 1; i <= 100; i ++) await group.add(`127.0.1.${i}`)
+
+      for (let round = 0; round < 2; round ++) {
+        group.start()
+        await sleep(100)
+        if (linux) expect(descriptors()).toEqual(before + 100)
+
+        group.stop()
+        await sleep(200)
+        if (linux) expect(descriptors()).toEqual(before)
+      }
+
+      for (const stats of Object.values(group.stats())) {
+        expect(stats.sent).toBeGreaterThan(0)
+        expect(stats.received).toEqual(stats.sent)
+      }
+    } finally {
+      await group.close()
+    }
+  })
+})